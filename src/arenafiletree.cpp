@@ -0,0 +1,223 @@
+#include "arenafiletree.h"
+
+#include <algorithm>
+#include <new>
+
+namespace MOBase
+{
+
+std::shared_ptr<FileTreeArena> FileTreeArena::create(std::size_t chunkSize)
+{
+  return (new FileTreeArena(chunkSize))->handle();
+}
+
+FileTreeArena::FileTreeArena(std::size_t chunkSize)
+    : m_ChunkSize(std::max<std::size_t>(chunkSize, 1024))
+{}
+
+FileTreeArena::~FileTreeArena() = default;
+
+std::shared_ptr<FileTreeArena> FileTreeArena::handle()
+{
+  m_References.fetch_add(1, std::memory_order_relaxed);
+  return std::shared_ptr<FileTreeArena>(this, [](FileTreeArena* arena) {
+    arena->release();
+  });
+}
+
+void FileTreeArena::release() noexcept
+{
+  if (m_References.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    delete this;
+  }
+}
+
+void* FileTreeArena::allocate(std::size_t size, std::size_t alignment)
+{
+  void* p = allocateBlock(size, alignment);
+  m_References.fetch_add(1, std::memory_order_relaxed);
+  return p;
+}
+
+void* FileTreeArena::allocateBlock(std::size_t size, std::size_t alignment)
+{
+  if (size > MAX_REUSED_SIZE || alignment > GRANULARITY) {
+    std::scoped_lock lock(m_Mutex);
+    return allocateSlow(nullptr, size, alignment);
+  }
+
+  // Rounded up to the size class, so the memory can be reused by any allocation of
+  // the same class:
+  const std::size_t cls = (std::max<std::size_t>(size, 1) - 1) / GRANULARITY;
+  size                  = (cls + 1) * GRANULARITY;
+
+  if (auto& list = m_Free[cls]; list.load(std::memory_order_relaxed) != nullptr) {
+    std::scoped_lock lock(m_Mutex);
+
+    FreeBlock* block = list.load(std::memory_order_acquire);
+    while (block != nullptr &&
+           !list.compare_exchange_weak(block, block->next, std::memory_order_acquire)) {
+    }
+
+    if (block != nullptr) {
+      return block;
+    }
+  }
+
+  for (;;) {
+    Chunk* chunk = m_Current.load(std::memory_order_acquire);
+    if (chunk != nullptr) {
+      const std::size_t offset =
+          chunk->offset.fetch_add(size, std::memory_order_relaxed);
+      if (offset + size <= chunk->size) {
+        return chunk->data.get() + offset;
+      }
+    }
+
+    std::scoped_lock lock(m_Mutex);
+    if (m_Current.load(std::memory_order_relaxed) == chunk) {
+      return allocateSlow(chunk, size, alignment);
+    }
+  }
+}
+
+void* FileTreeArena::allocateSlow(Chunk* full, std::size_t size, std::size_t alignment)
+{
+  // Oversized allocations get their own chunk, which is also fine for the alignment
+  // since new[] aligns to the maximum fundamental alignment, and the current chunk
+  // is kept:
+  const bool dedicated = full == nullptr && m_Current.load() != nullptr;
+
+  auto chunk = std::make_unique<Chunk>();
+  chunk->size = dedicated ? size + alignment : std::max(m_ChunkSize, size + alignment);
+  chunk->data.reset(new std::byte[chunk->size]);
+  m_Reserved += chunk->size;
+
+  void* p          = chunk->data.get();
+  std::size_t left = chunk->size;
+  std::align(alignment, size, p, left);
+  chunk->offset.store(chunk->size - left + size, std::memory_order_relaxed);
+
+  if (!dedicated) {
+    m_Current.store(chunk.get(), std::memory_order_release);
+  }
+  m_Chunks.push_back(std::move(chunk));
+
+  return p;
+}
+
+void FileTreeArena::deallocate(void* p, std::size_t size,
+                               std::size_t alignment) noexcept
+{
+  if (size <= MAX_REUSED_SIZE && alignment <= GRANULARITY) {
+    auto& list = m_Free[(std::max<std::size_t>(size, 1) - 1) / GRANULARITY];
+
+    auto* block = new (p) FreeBlock;
+    block->next = list.load(std::memory_order_relaxed);
+    while (!list.compare_exchange_weak(block->next, block, std::memory_order_release,
+                                       std::memory_order_relaxed)) {
+    }
+  }
+
+  release();
+}
+
+std::size_t FileTreeArena::bytesUsed() const
+{
+  std::scoped_lock lock(m_Mutex);
+
+  std::size_t used = 0;
+  for (auto& chunk : m_Chunks) {
+    used += std::min(chunk->offset.load(std::memory_order_relaxed), chunk->size);
+  }
+  return used;
+}
+
+std::size_t FileTreeArena::bytesReserved() const
+{
+  std::scoped_lock lock(m_Mutex);
+  return m_Reserved;
+}
+
+namespace
+{
+
+/**
+ * @brief File entry of an arena tree, only needed to clone files in the same arena.
+ */
+class ArenaFileEntry : public FileTreeEntry
+{
+  struct Token
+  {};
+
+public:
+  static std::shared_ptr<FileTreeEntry>
+  create(std::shared_ptr<const IFileTree> parent, QString const& name,
+         FileTreeArena* arena)
+  {
+    return std::allocate_shared<ArenaFileEntry>(
+        FileTreeArena::Allocator<ArenaFileEntry>(arena), Token{}, parent, name, arena);
+  }
+
+  ArenaFileEntry(Token, std::shared_ptr<const IFileTree> parent, QString name,
+                 FileTreeArena* arena)
+      : FileTreeEntry(parent, name), m_Arena(arena)
+  {}
+
+protected:
+  std::shared_ptr<FileTreeEntry> clone() const override
+  {
+    return create(nullptr, name(), m_Arena);
+  }
+
+private:
+  FileTreeArena* m_Arena;
+};
+
+}  // namespace
+
+std::shared_ptr<ArenaFileTree>
+ArenaFileTree::create(QString name, std::shared_ptr<FileTreeArena> arena)
+{
+  if (arena == nullptr) {
+    arena = FileTreeArena::create();
+  }
+
+  // The handle can be dropped, the tree keeps the arena alive:
+  return std::allocate_shared<ArenaFileTree>(
+      FileTreeArena::Allocator<ArenaFileTree>(arena.get()), Token{}, nullptr, name,
+      arena.get());
+}
+
+ArenaFileTree::ArenaFileTree(Token, std::shared_ptr<const IFileTree> parent,
+                             QString name, FileTreeArena* arena)
+    : FileTreeEntry(parent, name), IFileTree(), m_Arena(arena)
+{}
+
+std::shared_ptr<FileTreeEntry>
+ArenaFileTree::makeFile(std::shared_ptr<const IFileTree> parent, QString name) const
+{
+  return ArenaFileEntry::create(parent, name, m_Arena);
+}
+
+std::shared_ptr<IFileTree>
+ArenaFileTree::makeDirectory(std::shared_ptr<const IFileTree> parent,
+                             QString name) const
+{
+  return std::allocate_shared<ArenaFileTree>(
+      FileTreeArena::Allocator<ArenaFileTree>(m_Arena), Token{}, parent, name, m_Arena);
+}
+
+bool ArenaFileTree::doPopulate(std::shared_ptr<const IFileTree>,
+                               std::vector<std::shared_ptr<FileTreeEntry>>&) const
+{
+  // Arena trees only exist in memory, so there is nothing to populate:
+  return true;
+}
+
+std::shared_ptr<IFileTree> ArenaFileTree::doClone() const
+{
+  return makeDirectory(nullptr, name());
+}
+
+}  // namespace MOBase
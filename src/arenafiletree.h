@@ -0,0 +1,258 @@
+/*
+Mod Organizer shared UI functionality
+
+Copyright (C) 2026 MO2 Team. All rights reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef ARENAFILETREE_H
+#define ARENAFILETREE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <QString>
+
+#include "dllimport.h"
+#include "ifiletree.h"
+
+namespace MOBase
+{
+
+/**
+ * @brief Bump allocator used to store the nodes of an ArenaFileTree.
+ *
+ * Memory is carved out of large chunks, which are only released all at once when the
+ * arena is destroyed. Allocations are lock-free, except when a chunk is full.
+ *
+ * Freed memory is not given back to the chunks, but is kept in free lists and reused
+ * by allocations of the same size class, so erasing and adding entries does not
+ * grow the arena. Only allocations of at most MAX_REUSED_SIZE bytes are reused, which
+ * is the case of all the nodes of a tree.
+ *
+ * The arena counts its live allocations and the handles returned by create() and
+ * ArenaFileTree::arena(), and destroys itself once both are gone.
+ *
+ * All the methods of the arena are thread-safe.
+ */
+class QDLLEXPORT FileTreeArena
+{
+public:
+  /**
+   * @brief Standard allocator allocating from an arena.
+   *
+   * The allocator does not keep the arena alive by itself, each allocation does, so
+   * nodes allocated with std::allocate_shared() can outlive the tree they were created
+   * in without storing a handle on the arena in their control block.
+   */
+  template <class T>
+  struct Allocator
+  {
+    using value_type = T;
+
+    explicit Allocator(FileTreeArena* arena) : m_Arena(arena) {}
+
+    template <class U>
+    Allocator(Allocator<U> const& other) : m_Arena(other.m_Arena)
+    {}
+
+    T* allocate(std::size_t n)
+    {
+      return static_cast<T*>(m_Arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+      m_Arena->deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    template <class U>
+    friend bool operator==(Allocator const& a, Allocator<U> const& b)
+    {
+      return a.m_Arena == b.m_Arena;
+    }
+
+  private:
+    FileTreeArena* m_Arena;
+
+    template <class U>
+    friend struct Allocator;
+  };
+
+  // Largest allocation whose memory is reused once freed:
+  static constexpr std::size_t MAX_REUSED_SIZE = 1024;
+
+  /**
+   * @brief Create a new empty arena.
+   *
+   * @param chunkSize Size of the chunks allocated by the arena, in bytes.
+   */
+  static std::shared_ptr<FileTreeArena> create(std::size_t chunkSize = 256 * 1024);
+
+  /**
+   * @return a new handle on this arena, keeping it alive.
+   */
+  std::shared_ptr<FileTreeArena> handle();
+
+  /**
+   * @brief Allocate the given number of bytes from the arena.
+   *
+   * @param size Number of bytes to allocate.
+   * @param alignment Alignment of the allocation.
+   *
+   * @return a pointer to the allocated memory, never null.
+   */
+  void* allocate(std::size_t size, std::size_t alignment);
+
+  /**
+   * @brief Give back memory returned by allocate() with the same size and alignment.
+   */
+  void deallocate(void* p, std::size_t size, std::size_t alignment) noexcept;
+
+  /**
+   * @return the number of bytes carved out of the chunks of this arena, including
+   *     freed memory waiting to be reused.
+   */
+  std::size_t bytesUsed() const;
+
+  /**
+   * @return the number of bytes reserved by this arena, including unused space at the
+   *     end of the chunks.
+   */
+  std::size_t bytesReserved() const;
+
+  FileTreeArena(FileTreeArena const&)            = delete;
+  FileTreeArena& operator=(FileTreeArena const&) = delete;
+
+private:
+  struct Chunk
+  {
+    std::unique_ptr<std::byte[]> data;
+    std::size_t size;
+
+    // Bumped by allocations, may go past the size when the chunk is full:
+    std::atomic<std::size_t> offset;
+  };
+
+  struct FreeBlock
+  {
+    FreeBlock* next;
+  };
+
+  // Sizes are rounded up to this, which is also the alignment of chunks, so all
+  // allocations are aligned without padding:
+  static constexpr std::size_t GRANULARITY = alignof(std::max_align_t);
+
+  explicit FileTreeArena(std::size_t chunkSize);
+  ~FileTreeArena();
+
+  void release() noexcept;
+
+  // Allocate without counting the allocation:
+  void* allocateBlock(std::size_t size, std::size_t alignment);
+
+  // Allocate from a new chunk, or from a dedicated one for large or over-aligned
+  // allocations:
+  void* allocateSlow(Chunk* full, std::size_t size, std::size_t alignment);
+
+  std::size_t m_ChunkSize;
+
+  // Number of live allocations and handles:
+  std::atomic<std::size_t> m_References{0};
+
+  std::atomic<Chunk*> m_Current{nullptr};
+
+  // Free lists by size class; blocks are pushed without locking but only popped
+  // under the mutex, so a block cannot be popped and pushed back while another thread
+  // is popping it:
+  std::array<std::atomic<FreeBlock*>, MAX_REUSED_SIZE / GRANULARITY> m_Free{};
+
+  // Protects m_Chunks and the pops from the free lists:
+  mutable std::mutex m_Mutex;
+  std::vector<std::unique_ptr<Chunk>> m_Chunks;
+  std::size_t m_Reserved = 0;
+};
+
+/**
+ * @brief In-memory implementation of IFileTree whose entries are allocated from a
+ *     FileTreeArena.
+ *
+ * The entries of the tree are created with std::allocate_shared() from the arena, so
+ * each entry and its shared pointer control block are a single bump allocation
+ * instead of separate heap allocations, and the whole tree memory is released at
+ * once when the last entry is destroyed. Names of the entries are interned in the
+ * FileNamePool like for any other tree.
+ *
+ * Since the entries are shared pointers, they are still destroyed one by one, but
+ * their memory goes back to the free lists of the arena instead of the heap. Any
+ * entry that is still referenced, e.g., a pointer returned by find(), keeps the
+ * chunks of the whole arena alive, not only its own memory.
+ *
+ * Directories created by this tree are always populated (empty), so this tree is
+ * meant to be built with addFile(), addDirectory(), insert(), etc.
+ *
+ * Entries copied or moved from another tree into an arena tree are kept as-is, and
+ * entries cloned from an arena tree are allocated in the same arena.
+ */
+class QDLLEXPORT ArenaFileTree : public IFileTree
+{
+  // Only used to make the constructor inaccessible while still allowing
+  // std::allocate_shared() to call it:
+  struct Token
+  {};
+
+public:
+  /**
+   * @brief Create a new empty tree with its own arena.
+   *
+   * @param name Name of the root of the tree.
+   * @param arena Arena to use, or a null pointer to create a new one.
+   *
+   * @return the root of the tree.
+   */
+  static std::shared_ptr<ArenaFileTree>
+  create(QString name = "", std::shared_ptr<FileTreeArena> arena = nullptr);
+
+  /**
+   * @return the arena containing this tree.
+   */
+  std::shared_ptr<FileTreeArena> arena() const { return m_Arena->handle(); }
+
+  ArenaFileTree(Token, std::shared_ptr<const IFileTree> parent, QString name,
+                FileTreeArena* arena);
+
+protected:
+  std::shared_ptr<FileTreeEntry> makeFile(std::shared_ptr<const IFileTree> parent,
+                                          QString name) const override;
+  std::shared_ptr<IFileTree> makeDirectory(std::shared_ptr<const IFileTree> parent,
+                                           QString name) const override;
+  bool doPopulate(std::shared_ptr<const IFileTree> parent,
+                  std::vector<std::shared_ptr<FileTreeEntry>>& entries) const override;
+  std::shared_ptr<IFileTree> doClone() const override;
+
+private:
+  // The arena is kept alive by the allocation of this tree, so a raw pointer is
+  // enough here:
+  FileTreeArena* m_Arena;
+};
+
+}  // namespace MOBase
+
+#endif
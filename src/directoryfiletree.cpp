@@ -0,0 +1,178 @@
+#include "directoryfiletree.h"
+
+#include <algorithm>
+
+#include "log.h"
+
+namespace MOBase
+{
+
+namespace
+{
+
+/**
+ * @brief File entry read from a directory on the disk, which remembers where it was
+ *     read from so that it can be found on the disk as long as it is not renamed or
+ *     moved.
+ */
+class DirectoryFileEntry : public FileTreeEntry
+{
+public:
+  DirectoryFileEntry(std::shared_ptr<const IFileTree> parent, QString name,
+                     QString directory, QString diskName)
+      : FileTreeEntry(parent, name), m_Directory(std::move(directory)),
+        m_DiskName(std::move(diskName))
+  {}
+
+  // Path of the directory the file was read from, relative to the root directory:
+  QString const& directory() const { return m_Directory; }
+
+  // Name of the file on the disk:
+  QString const& diskName() const { return m_DiskName; }
+
+protected:
+  std::shared_ptr<FileTreeEntry> clone() const override
+  {
+    return std::shared_ptr<FileTreeEntry>(
+        new DirectoryFileEntry(nullptr, name(), m_Directory, m_DiskName));
+  }
+
+private:
+  // Both strings share their data with the directory and the name of the file:
+  QString m_Directory;
+  QString m_DiskName;
+};
+
+}  // namespace
+
+DirectoryFileTree::DirectoryFileTree(std::shared_ptr<const IFileTree> parent,
+                                     QString name, std::shared_ptr<const Root> root,
+                                     QString path)
+    : FileTreeEntry(parent, name), IFileTree(), m_Root(std::move(root)),
+      m_Path(std::move(path))
+{}
+
+std::shared_ptr<IFileTree>
+DirectoryFileTree::makeDirectory(std::shared_ptr<const IFileTree> parent,
+                                 QString name) const
+{
+  // Directories created in the tree are not on the disk:
+  return std::shared_ptr<DirectoryFileTree>(
+      new DirectoryFileTree(parent, name, m_Root, QString()));
+}
+
+std::shared_ptr<IFileTree> DirectoryFileTree::doClone() const
+{
+  // The clone is only on the disk as long as it is where this tree was read from,
+  // e.g., when cloning the root:
+  return std::shared_ptr<DirectoryFileTree>(
+      new DirectoryFileTree(nullptr, name(), m_Root, m_Path));
+}
+
+QString DirectoryFileTree::diskPath(FileTreeEntry const& entry,
+                                    std::shared_ptr<const DirectoryFileTree>& tree)
+{
+  if (entry.isDir()) {
+    tree = std::dynamic_pointer_cast<const DirectoryFileTree>(entry.astree());
+    return tree != nullptr && tree->isOnDisk() ? tree->m_Path : QString();
+  }
+
+  // Files must still be in the directory they were read from, with the same name:
+  auto const* file = dynamic_cast<DirectoryFileEntry const*>(&entry);
+  tree             = std::dynamic_pointer_cast<const DirectoryFileTree>(entry.parent());
+  if (file == nullptr || tree == nullptr || tree->m_Path != file->directory() ||
+      entry.name() != file->diskName() || !tree->isOnDisk()) {
+    return QString();
+  }
+  return tree->m_Path.isEmpty() ? entry.name() : tree->m_Path + "/" + entry.name();
+}
+
+bool DirectoryFileTree::isOnDisk() const
+{
+  if (m_Path.isNull()) {
+    return false;
+  }
+
+  const auto parent = this->parent();
+  if (m_Path.isEmpty()) {
+    return parent == nullptr;
+  }
+
+  // The path ends with the name the directory was read with, and starts with the
+  // path of the parent it was read from:
+  const qsizetype slash = m_Path.lastIndexOf('/');
+  if (QStringView(m_Path).mid(slash + 1) != name()) {
+    return false;
+  }
+
+  auto const* tree = dynamic_cast<DirectoryFileTree const*>(parent.get());
+  return tree != nullptr && tree->m_Root == m_Root &&
+         tree->m_Path == QStringView(m_Path).left(std::max<qsizetype>(slash, 0)) &&
+         tree->isOnDisk();
+}
+
+std::shared_ptr<FileTreeEntry>
+DirectoryFileTree::makeDiskFile(std::shared_ptr<const IFileTree> parent,
+                                QString name) const
+{
+  return std::shared_ptr<FileTreeEntry>(
+      new DirectoryFileEntry(parent, name, m_Path, name));
+}
+
+void DirectoryFileTree::sortEntries(
+    std::vector<std::shared_ptr<FileTreeEntry>>& entries) const
+{
+  // Directories first and then by name, as in the tree, so the tree does not have to
+  // sort the entries again:
+  std::sort(entries.begin(), entries.end(), [](auto const& a, auto const& b) {
+    if (a->isDir() != b->isDir()) {
+      return a->isDir();
+    }
+    if (const int c = FileNameComparator::compare(a->name(), b->name()); c != 0) {
+      return c < 0;
+    }
+    return a->name() < b->name();
+  });
+
+  // Duplicates among directories, or among files, are now next to each other, and
+  // since both are in the same order, files are matched against directories with a
+  // single cursor:
+  std::size_t kept = 0, directories = 0, next = 0;
+  for (std::size_t i = 0; i < entries.size(); ++i) {
+    auto const& entry = entries[i];
+
+    FileTreeEntry const* same = nullptr;
+    if (kept > 0 && entries[kept - 1]->isDir() == entry->isDir() &&
+        FileNameComparator::compare(entries[kept - 1]->name(), entry->name()) == 0) {
+      same = entries[kept - 1].get();
+    } else if (entry->isFile()) {
+      int c = 1;
+      while (next < directories && (c = FileNameComparator::compare(
+                                        entries[next]->name(), entry->name())) < 0) {
+        ++next;
+      }
+      if (next < directories && c == 0) {
+        same = entries[next].get();
+      }
+    }
+
+    if (same != nullptr) {
+      log::warn("ignoring '{}/{}', which has the same name as '{}' in a tree",
+                rootPath(),
+                m_Path.isEmpty() ? entry->name() : m_Path + "/" + entry->name(),
+                same->name());
+      continue;
+    }
+
+    if (entry->isDir()) {
+      ++directories;
+    }
+    if (kept != i) {
+      entries[kept] = std::move(entries[i]);
+    }
+    ++kept;
+  }
+  entries.erase(entries.begin() + kept, entries.end());
+}
+
+}  // namespace MOBase
@@ -0,0 +1,151 @@
+/*
+Mod Organizer shared UI functionality
+
+Copyright (C) 2026 MO2 Team. All rights reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef DIRECTORYFILETREE_H
+#define DIRECTORYFILETREE_H
+
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <QDateTime>
+#include <QString>
+
+#include "dllimport.h"
+#include "ifiletree.h"
+
+namespace MOBase
+{
+
+/**
+ * @brief Implementation of IFileTree for a directory on the disk.
+ *
+ * Directories are read lazily, when they are populated, with the native directory
+ * listing of the platform (getdents64() relative to a descriptor of the root
+ * directory on Linux, FindFirstFileEx() on Windows). Files are never stat'ed while
+ * listing directories, except to resolve the type of symbolic links, so metadata
+ * are only read when requested with metadata().
+ *
+ * Use populateAll() or prefetch() to scan the whole directory, or a part of it, with
+ * multiple threads.
+ *
+ * The tree is a snapshot of the directory: changes made to the tree are not applied
+ * to the disk, and changes made to the disk after a directory has been populated are
+ * not visible in the tree.
+ *
+ * Symbolic links are followed, except links to a directory containing them, which
+ * are ignored since they would make the tree infinite.
+ */
+class QDLLEXPORT DirectoryFileTree : public IFileTree
+{
+  // Platform-specific handle on the root directory:
+  struct Root;
+
+public:
+  /**
+   * @brief Metadata of an entry, see metadata().
+   */
+  struct Metadata
+  {
+    // Size of the file in bytes, unspecified for directories:
+    qint64 size;
+
+    QDateTime lastModified;
+  };
+
+  /**
+   * @brief Create a tree for the given directory. The directory is opened but not
+   *     read.
+   *
+   * @param path Path to the directory.
+   *
+   * @return the root of the tree, or a null pointer if the directory cannot be
+   *     opened.
+   */
+  static std::shared_ptr<DirectoryFileTree> create(QString const& path);
+
+  /**
+   * @brief Read the metadata of the given entry from the disk.
+   *
+   * @param entry Entry of a directory tree.
+   *
+   * @return the metadata of the entry, or an empty optional if the entry is not
+   *     in a directory tree, or does not exist on the disk, e.g., because it was added
+   *     to the tree, renamed or moved.
+   */
+  static std::optional<Metadata> metadata(FileTreeEntry const& entry);
+
+  /**
+   * @return the path of the root directory of this tree on the disk.
+   */
+  QString rootPath() const;
+
+protected:
+  /**
+   * @param path Path of the directory on the disk, relative to the root directory,
+   *     or a null string if the directory is not on the disk.
+   */
+  DirectoryFileTree(std::shared_ptr<const IFileTree> parent, QString name,
+                    std::shared_ptr<const Root> root, QString path);
+
+  std::shared_ptr<IFileTree> makeDirectory(std::shared_ptr<const IFileTree> parent,
+                                           QString name) const override;
+  bool doPopulate(std::shared_ptr<const IFileTree> parent,
+                  std::vector<std::shared_ptr<FileTreeEntry>>& entries) const override;
+  std::shared_ptr<IFileTree> doClone() const override;
+
+private:
+  /**
+   * @return the path of the given entry on the disk, relative to the root directory
+   *     of the given tree, or a null string if the entry is not on the disk, or is
+   *     no longer where it was read from.
+   */
+  static QString diskPath(FileTreeEntry const& entry,
+                          std::shared_ptr<const DirectoryFileTree>& tree);
+
+  /**
+   * @return true if this directory was read from the disk and still has the name and
+   *     the parent it was read with, up to the root of the tree.
+   */
+  bool isOnDisk() const;
+
+  /**
+   * @brief Create a file read from this directory on the disk.
+   */
+  std::shared_ptr<FileTreeEntry> makeDiskFile(std::shared_ptr<const IFileTree> parent,
+                                              QString name) const;
+
+  /**
+   * @brief Sort the given entries read from this directory in the order of the tree,
+   *     removing the entries whose name only differs by case from another one.
+   *
+   * Such names can be listed on case-sensitive file systems but cannot be in a tree;
+   * directories are kept over files, and then the first name in binary order, so the
+   * result does not depend on the order of the listing.
+   */
+  void sortEntries(std::vector<std::shared_ptr<FileTreeEntry>>& entries) const;
+
+  std::shared_ptr<const Root> m_Root;
+  QString m_Path;
+};
+
+}  // namespace MOBase
+
+#endif
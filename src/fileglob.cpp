@@ -0,0 +1,159 @@
+#include "fileglob.h"
+
+namespace MOBase
+{
+
+namespace
+{
+
+bool isSeparator(QChar c)
+{
+  return c == u'/' || c == u'\\';
+}
+
+bool sameChar(QChar a, QChar b)
+{
+  return a == b || a.toCaseFolded() == b.toCaseFolded();
+}
+
+/**
+ * @brief Match a name against a segment with wildcards, backtracking only to the
+ *     last `*`, which is enough since a `*` can absorb anything a previous one could.
+ */
+bool wildcardMatch(QStringView pattern, QStringView name)
+{
+  qsizetype p = 0, n = 0;
+  qsizetype starP = -1, starN = 0;
+
+  while (n < name.size()) {
+    if (p < pattern.size() && pattern[p] == u'*') {
+      starP = p++;
+      starN = n;
+    } else if (p < pattern.size() &&
+               (pattern[p] == u'?' || sameChar(pattern[p], name[n]))) {
+      ++p;
+      ++n;
+    } else if (starP != -1) {
+      p = starP + 1;
+      n = ++starN;
+    } else {
+      return false;
+    }
+  }
+
+  while (p < pattern.size() && pattern[p] == u'*') {
+    ++p;
+  }
+
+  return p == pattern.size();
+}
+
+/**
+ * @brief Match the names of the given path, from the given segment.
+ */
+bool matchPath(std::vector<FileGlob::Segment> const& segments, std::size_t segment,
+               std::vector<QStringView> const& names, std::size_t name)
+{
+  if (segment == segments.size()) {
+    return name == names.size();
+  }
+
+  if (segments[segment].kind == FileGlob::SegmentKind::RECURSIVE) {
+    for (std::size_t i = name; i <= names.size(); ++i) {
+      if (matchPath(segments, segment + 1, names, i)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  return name < names.size() && FileGlob::matches(segments[segment], names[name]) &&
+         matchPath(segments, segment + 1, names, name + 1);
+}
+
+}  // namespace
+
+FileGlob::FileGlob(QStringView pattern)
+{
+  qsizetype start = 0;
+  while (start <= pattern.size()) {
+    qsizetype end = start;
+    while (end < pattern.size() && !isSeparator(pattern[end])) {
+      ++end;
+    }
+
+    const QStringView segment = pattern.mid(start, end - start);
+    start                     = end + 1;
+
+    if (segment.isEmpty()) {
+      continue;
+    }
+
+    if (segment == u"**") {
+      // Consecutive ** are the same as a single one:
+      if (m_Segments.empty() || m_Segments.back().kind != SegmentKind::RECURSIVE) {
+        m_Segments.push_back({SegmentKind::RECURSIVE, {}});
+      }
+      continue;
+    }
+
+    const QStringView rest = segment.mid(1);
+    if (!segment.contains(u'*') && !segment.contains(u'?')) {
+      m_Segments.push_back({SegmentKind::LITERAL, segment.toString()});
+    } else if (segment.startsWith(u'*') && !rest.contains(u'*') &&
+               !rest.contains(u'?')) {
+      m_Segments.push_back({SegmentKind::SUFFIX, rest.toString()});
+    } else {
+      m_Segments.push_back({SegmentKind::WILDCARD, segment.toString()});
+    }
+  }
+}
+
+bool FileGlob::isSuffixOnly() const
+{
+  return m_Segments.size() == 2 && m_Segments[0].kind == SegmentKind::RECURSIVE &&
+         m_Segments[1].kind == SegmentKind::SUFFIX;
+}
+
+QString FileGlob::suffix() const
+{
+  if (m_Segments.empty() || m_Segments.back().kind != SegmentKind::SUFFIX) {
+    return {};
+  }
+  return m_Segments.back().text;
+}
+
+bool FileGlob::matches(Segment const& segment, QStringView name)
+{
+  switch (segment.kind) {
+  case SegmentKind::LITERAL:
+    return name.compare(segment.text, Qt::CaseInsensitive) == 0;
+  case SegmentKind::SUFFIX:
+    return name.endsWith(segment.text, Qt::CaseInsensitive);
+  case SegmentKind::WILDCARD:
+    return wildcardMatch(segment.text, name);
+  case SegmentKind::RECURSIVE:
+    break;
+  }
+  return false;
+}
+
+bool FileGlob::matches(QStringView path) const
+{
+  std::vector<QStringView> names;
+  qsizetype start = 0;
+  while (start <= path.size()) {
+    qsizetype end = start;
+    while (end < path.size() && !isSeparator(path[end])) {
+      ++end;
+    }
+    if (end > start) {
+      names.push_back(path.mid(start, end - start));
+    }
+    start = end + 1;
+  }
+
+  return matchPath(m_Segments, 0, names, 0);
+}
+
+}  // namespace MOBase
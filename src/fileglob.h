@@ -0,0 +1,127 @@
+/*
+Mod Organizer shared UI functionality
+
+Copyright (C) 2026 MO2 Team. All rights reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef FILEGLOB_H
+#define FILEGLOB_H
+
+#include <cstddef>
+#include <vector>
+
+#include <QString>
+#include <QStringView>
+
+#include "dllimport.h"
+
+namespace MOBase
+{
+
+/**
+ * @brief Compiled glob pattern over relative paths, used by IFileTree::findAll().
+ *
+ * Patterns are made of segments separated by / or \. Inside a segment, `*` matches
+ * any sequence of characters and `?` matches a single character. A segment made only
+ * of `**` matches any number of directories, including none, e.g., `**` followed by
+ * `*.esp` matches all the plugins in a tree, and `meshes`, `**`, `*.nif` matches all
+ * the meshes under `meshes`. Matching is case-insensitive, like filenames.
+ *
+ * The pattern is parsed once, so a FileGlob can be reused for multiple queries.
+ */
+class QDLLEXPORT FileGlob
+{
+public:
+  /**
+   * @brief Kind of a segment of the pattern.
+   */
+  enum class SegmentKind
+  {
+    // No wildcard, matched by looking up the name:
+    LITERAL,
+
+    // `*` followed by a literal, matched by checking the end of the name:
+    SUFFIX,
+
+    // Any other segment with wildcards:
+    WILDCARD,
+
+    // `**`, matching any number of directories:
+    RECURSIVE
+  };
+
+  struct Segment
+  {
+    SegmentKind kind;
+
+    // The segment, or its literal part for SUFFIX segments:
+    QString text;
+  };
+
+  /**
+   * @brief Compile the given pattern.
+   *
+   * Empty segments, e.g., leading, trailing or doubled separators, are ignored.
+   *
+   * @param pattern The pattern to compile.
+   */
+  explicit FileGlob(QStringView pattern);
+  explicit FileGlob(QString const& pattern) : FileGlob(QStringView(pattern)) {}
+
+  /**
+   * @return the segments of this pattern.
+   */
+  std::vector<Segment> const& segments() const { return m_Segments; }
+
+  /**
+   * @return true if this pattern only checks the suffix of entries at any depth,
+   *     e.g., `**` followed by `*.esp`, in which case suffix() is the suffix.
+   */
+  bool isSuffixOnly() const;
+
+  /**
+   * @return the literal suffix of the last segment if it is a SUFFIX segment, or an
+   *     empty string.
+   */
+  QString suffix() const;
+
+  /**
+   * @brief Check if the given name matches the given segment.
+   *
+   * @param segment Segment to match, must not be RECURSIVE.
+   * @param name Name to check.
+   *
+   * @return true if the name matches.
+   */
+  static bool matches(Segment const& segment, QStringView name);
+
+  /**
+   * @brief Check if the given relative path matches this pattern.
+   *
+   * @param path Path to check, with / or \ as separators.
+   *
+   * @return true if the path matches.
+   */
+  bool matches(QStringView path) const;
+
+private:
+  std::vector<Segment> m_Segments;
+};
+
+}  // namespace MOBase
+
+#endif
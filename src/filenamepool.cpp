@@ -0,0 +1,180 @@
+#include "filenamepool.h"
+
+#include <unordered_set>
+#include <utility>
+
+#include "ifiletree.h"
+
+namespace MOBase
+{
+
+FileNamePool& FileNamePool::instance()
+{
+  // The pool is never destroyed since names may be released by static objects
+  // destroyed after it:
+  static FileNamePool* pool = new FileNamePool;
+  return *pool;
+}
+
+FileNamePool::NameRecord* FileNamePool::acquire(QString const& name)
+{
+  const std::size_t hash = FileNameComparator::hash(name);
+  const std::size_t idx  = hash % SHARDS;
+  Shard& shard           = m_Shards[idx];
+
+  std::scoped_lock lock(shard.mutex);
+
+  if (auto it = shard.names.find(name); it != shard.names.end()) {
+    it->second->references.fetch_add(1, std::memory_order_relaxed);
+    return it->second;
+  }
+
+  const QString folded = FileNameComparator::caseFold(name);
+  KeyRecord* key       = nullptr;
+  if (auto it = shard.keys.find(folded); it != shard.keys.end()) {
+    key = it->second;
+  } else {
+    key = new KeyRecord{folded, hash, 0};
+    shard.keys.emplace(key->key, key);
+  }
+  key->references++;
+
+  auto* record = new NameRecord{name, key, idx, 1};
+  shard.names.emplace(record->name, record);
+
+  return record;
+}
+
+void FileNamePool::release(NameRecord* record)
+{
+  // Only the transition from one reference to zero needs the lock, since acquire()
+  // can only resurrect a name under the lock:
+  std::size_t count = record->references.load(std::memory_order_relaxed);
+  while (count > 1) {
+    if (record->references.compare_exchange_weak(count, count - 1,
+                                                 std::memory_order_release,
+                                                 std::memory_order_relaxed)) {
+      return;
+    }
+  }
+
+  Shard& shard = m_Shards[record->shard];
+  std::scoped_lock lock(shard.mutex);
+
+  if (record->references.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+    return;
+  }
+
+  KeyRecord* key = record->key;
+  shard.names.erase(record->name);
+  delete record;
+
+  if (--key->references == 0) {
+    shard.keys.erase(key->key);
+    delete key;
+  }
+}
+
+FileNamePool::Statistics FileNamePool::statistics() const
+{
+  // Approximate size of a string: header of the shared data, content and null
+  // terminator:
+  const auto stringBytes = [](QString const& s) {
+    return 16 + static_cast<std::size_t>(s.size() + 1) * sizeof(char16_t);
+  };
+
+  Statistics stats;
+  for (auto& shard : m_Shards) {
+    std::scoped_lock lock(shard.mutex);
+
+    stats.names += shard.names.size();
+    stats.keys += shard.keys.size();
+
+    // Keys folded from a name that was already folded share its data:
+    std::unordered_set<KeyRecord const*> shared;
+
+    for (auto& [name, record] : shard.names) {
+      const std::size_t references = record->references.load();
+      QString const& key           = record->key->key;
+
+      if (name.constData() == key.constData()) {
+        shared.insert(record->key);
+      }
+
+      // Without the pool, each reference has its own name and its own key, unless
+      // the name is already folded:
+      std::size_t bytes = stringBytes(name);
+      if (name != key) {
+        bytes += stringBytes(key);
+      }
+
+      stats.references += references;
+      stats.bytesUninterned += references * bytes;
+      stats.bytes += stringBytes(name);
+    }
+
+    for (auto& [key, record] : shard.keys) {
+      if (!shared.contains(record)) {
+        stats.bytes += stringBytes(key);
+      }
+    }
+  }
+
+  return stats;
+}
+
+FileNamePool::Name::Name(QString const& name)
+    : m_Record(FileNamePool::instance().acquire(name))
+{}
+
+FileNamePool::Name::Name(Name const& other) noexcept : m_Record(other.m_Record)
+{
+  m_Record->references.fetch_add(1, std::memory_order_relaxed);
+}
+
+FileNamePool::Name::Name(Name&& other) noexcept
+    : m_Record(std::exchange(other.m_Record, nullptr))
+{}
+
+FileNamePool::Name& FileNamePool::Name::operator=(Name const& other) noexcept
+{
+  Name tmp(other);
+  std::swap(m_Record, tmp.m_Record);
+  return *this;
+}
+
+FileNamePool::Name& FileNamePool::Name::operator=(Name&& other) noexcept
+{
+  std::swap(m_Record, other.m_Record);
+  return *this;
+}
+
+FileNamePool::Name::~Name()
+{
+  // Null if moved from:
+  if (m_Record != nullptr) {
+    FileNamePool::instance().release(m_Record);
+  }
+}
+
+QString const& FileNamePool::Name::str() const
+{
+  return m_Record->name;
+}
+
+QString const& FileNamePool::Name::key() const
+{
+  return m_Record->key->key;
+}
+
+std::size_t FileNamePool::Name::hash() const
+{
+  return m_Record->key->hash;
+}
+
+FileNamePool::KeyRecord const* FileNamePool::Name::key_() const
+{
+  return m_Record->key;
+}
+
+}  // namespace MOBase
@@ -0,0 +1,186 @@
+/*
+Mod Organizer shared UI functionality
+
+Copyright (C) 2026 MO2 Team. All rights reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef FILENAMEPOOL_H
+#define FILENAMEPOOL_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+
+#include <QString>
+
+#include "dllimport.h"
+
+namespace MOBase
+{
+
+/**
+ * @brief Process-wide pool of interned filenames, used by FileTreeEntry.
+ *
+ * Mod archives repeat the same names over and over (textures, meshes, ...), so each
+ * distinct name is stored once in the pool and entries only hold a reference to it.
+ * The pool also interns the case-folded version of each name, which is shared by all
+ * the names that only differ by case, so that checking if two names are equal
+ * case-insensitively is a pointer comparison.
+ *
+ * Names are reference-counted and removed from the pool when they are not used
+ * anymore. The pool is thread-safe.
+ */
+class QDLLEXPORT FileNamePool
+{
+  struct KeyRecord;
+  struct NameRecord;
+
+public:
+  /**
+   * @brief Statistics about the content of the pool.
+   */
+  struct Statistics
+  {
+    // Number of distinct names and case-folded keys in the pool:
+    std::size_t names = 0;
+    std::size_t keys  = 0;
+
+    // Number of references to the names of the pool, e.g., number of entries:
+    std::size_t references = 0;
+
+    // Approximate memory used by the strings of the pool, and memory that would
+    // have been used if each reference had its own copy of the name:
+    std::size_t bytes           = 0;
+    std::size_t bytesUninterned = 0;
+  };
+
+  /**
+   * @brief Reference to an interned name.
+   */
+  class QDLLEXPORT Name
+  {
+  public:
+    /**
+     * @brief Intern the given name in the global pool.
+     */
+    explicit Name(QString const& name);
+
+    Name(Name const& other) noexcept;
+    Name(Name&& other) noexcept;
+    Name& operator=(Name const& other) noexcept;
+    Name& operator=(Name&& other) noexcept;
+    ~Name();
+
+    /**
+     * @return the name.
+     */
+    QString const& str() const;
+
+    /**
+     * @return the case-folded name, see FileNameComparator::caseFold().
+     */
+    QString const& key() const;
+
+    /**
+     * @return the hash of the name, see FileNameComparator::hash().
+     */
+    std::size_t hash() const;
+
+    /**
+     * @brief Check if the two names are equal case-insensitively. This is a pointer
+     *     comparison.
+     */
+    friend bool sameKey(Name const& a, Name const& b) { return a.key_() == b.key_(); }
+
+    /**
+     * @brief Check if the two names are identical. This is a pointer comparison.
+     */
+    friend bool operator==(Name const& a, Name const& b)
+    {
+      return a.m_Record == b.m_Record;
+    }
+
+    /**
+     * @brief Compare the two names case-insensitively, consistently with
+     *     FileNameComparator::compare().
+     */
+    friend int compare(Name const& a, Name const& b)
+    {
+      return sameKey(a, b) ? 0 : a.key().compare(b.key());
+    }
+
+  private:
+    KeyRecord const* key_() const;
+
+    NameRecord* m_Record;
+  };
+
+  /**
+   * @return the process-wide pool.
+   */
+  static FileNamePool& instance();
+
+  /**
+   * @return statistics about the content of the pool.
+   */
+  Statistics statistics() const;
+
+  FileNamePool(FileNamePool const&)            = delete;
+  FileNamePool& operator=(FileNamePool const&) = delete;
+
+private:
+  struct KeyRecord
+  {
+    QString key;
+    std::size_t hash;
+
+    // Number of names using this key, only modified under the shard lock:
+    std::size_t references;
+  };
+
+  struct NameRecord
+  {
+    QString name;
+    KeyRecord* key;
+    std::size_t shard;
+    std::atomic<std::size_t> references;
+  };
+
+  // Names that only differ by case have the same hash, so they are in the same shard
+  // as their key, and a single lock protects both:
+  struct Shard
+  {
+    mutable std::mutex mutex;
+    std::unordered_map<QString, NameRecord*> names;
+    std::unordered_map<QString, KeyRecord*> keys;
+  };
+
+  static constexpr std::size_t SHARDS = 16;
+
+  FileNamePool() = default;
+
+  NameRecord* acquire(QString const& name);
+  void release(NameRecord* record);
+
+  std::array<Shard, SHARDS> m_Shards;
+};
+
+}  // namespace MOBase
+
+#endif
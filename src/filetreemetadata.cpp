@@ -0,0 +1,285 @@
+#include "filetreemetadata.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace MOBase
+{
+
+namespace
+{
+
+// Value of the time column for entries without modification time:
+constexpr qint64 UNKNOWN_TIME = std::numeric_limits<qint64>::min();
+
+// Check if the given entry is in the given tree, recursively:
+bool isInTree(FileTreeEntry const& entry, IFileTree const* tree)
+{
+  for (auto parent = entry.parent(); parent != nullptr; parent = parent->parent()) {
+    if (parent.get() == tree) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+void FileTreeMetadata::reserve(std::size_t count)
+{
+  std::scoped_lock lock(m_Mutex);
+  m_Rows.reserve(count);
+  m_Keys.reserve(count);
+  m_Entries.reserve(count);
+  m_Sizes.reserve(count);
+  m_Times.reserve(count);
+  m_Hashes.reserve(count);
+}
+
+void FileTreeMetadata::set(std::shared_ptr<const FileTreeEntry> const& entry,
+                           Values values)
+{
+  std::scoped_lock lock(m_Mutex);
+  setValues(entry, std::move(values));
+}
+
+void FileTreeMetadata::set(
+    std::vector<std::pair<std::shared_ptr<const FileTreeEntry>, Values>> values)
+{
+  std::scoped_lock lock(m_Mutex);
+  m_Rows.reserve(m_Rows.size() + values.size());
+  for (auto& [entry, entryValues] : values) {
+    setValues(entry, std::move(entryValues));
+  }
+}
+
+bool FileTreeMetadata::erase(FileTreeEntry const& entry)
+{
+  std::scoped_lock lock(m_Mutex);
+  auto it = m_Rows.find(&entry);
+  if (it == m_Rows.end()) {
+    return false;
+  }
+  invalidateTotals(entry);
+  eraseRow(it->second);
+  return true;
+}
+
+std::size_t FileTreeMetadata::prune()
+{
+  std::scoped_lock lock(m_Mutex);
+
+  // Rows are removed from the end, so the rows moved by eraseRow() have already been
+  // checked:
+  std::size_t count = 0;
+  for (std::size_t row = m_Entries.size(); row-- > 0;) {
+    if (m_Entries[row].expired()) {
+      eraseRow(row);
+      ++count;
+    }
+  }
+
+  for (auto it = m_Totals.begin(); it != m_Totals.end();) {
+    if (it->second.tree.expired()) {
+      it = m_Totals.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  return count;
+}
+
+std::size_t FileTreeMetadata::count() const
+{
+  std::scoped_lock lock(m_Mutex);
+  return m_Keys.size();
+}
+
+std::optional<FileTreeMetadata::Values>
+FileTreeMetadata::get(FileTreeEntry const& entry) const
+{
+  std::scoped_lock lock(m_Mutex);
+  const auto row = findRow(entry);
+  if (!row) {
+    return {};
+  }
+
+  Values values;
+  values.size = m_Sizes[*row];
+  if (m_Times[*row] != UNKNOWN_TIME) {
+    values.lastModified = QDateTime::fromMSecsSinceEpoch(m_Times[*row]);
+  }
+  values.hash = m_Hashes[*row];
+  return values;
+}
+
+qint64 FileTreeMetadata::size(FileTreeEntry const& entry) const
+{
+  std::scoped_lock lock(m_Mutex);
+  const auto row = findRow(entry);
+  return row ? m_Sizes[*row] : -1;
+}
+
+QDateTime FileTreeMetadata::lastModified(FileTreeEntry const& entry) const
+{
+  std::scoped_lock lock(m_Mutex);
+  const auto row = findRow(entry);
+  if (!row || m_Times[*row] == UNKNOWN_TIME) {
+    return QDateTime();
+  }
+  return QDateTime::fromMSecsSinceEpoch(m_Times[*row]);
+}
+
+QByteArray FileTreeMetadata::hash(FileTreeEntry const& entry) const
+{
+  std::scoped_lock lock(m_Mutex);
+  const auto row = findRow(entry);
+  return row ? m_Hashes[*row] : QByteArray();
+}
+
+qint64 FileTreeMetadata::totalSize(std::shared_ptr<const IFileTree> const& tree) const
+{
+  std::scoped_lock lock(m_Mutex);
+  return subtreeSize(*tree);
+}
+
+std::vector<std::shared_ptr<const FileTreeEntry>>
+FileTreeMetadata::largestFiles(std::shared_ptr<const IFileTree> const& tree,
+                               std::size_t count) const
+{
+  if (count == 0) {
+    return {};
+  }
+
+  std::scoped_lock lock(m_Mutex);
+
+  // Min-heap of the largest files found so far. The size column is scanned and the
+  // position of an entry in the tree is only checked for entries that are larger
+  // than the smallest file in the heap:
+  using Candidate = std::pair<qint64, std::shared_ptr<const FileTreeEntry>>;
+  auto greater    = [](Candidate const& lhs, Candidate const& rhs) {
+    return lhs.first > rhs.first;
+  };
+  std::vector<Candidate> heap;
+  heap.reserve(count + 1);
+
+  for (std::size_t row = 0; row < m_Sizes.size(); ++row) {
+    const qint64 size = m_Sizes[row];
+    if (size < 0 || (heap.size() == count && size <= heap.front().first)) {
+      continue;
+    }
+
+    auto entry = m_Entries[row].lock();
+    if (entry == nullptr || !entry->isFile() || !isInTree(*entry, tree.get())) {
+      continue;
+    }
+
+    heap.emplace_back(size, std::move(entry));
+    std::push_heap(heap.begin(), heap.end(), greater);
+    if (heap.size() > count) {
+      std::pop_heap(heap.begin(), heap.end(), greater);
+      heap.pop_back();
+    }
+  }
+
+  std::sort_heap(heap.begin(), heap.end(), greater);
+
+  std::vector<std::shared_ptr<const FileTreeEntry>> files;
+  files.reserve(heap.size());
+  for (auto& candidate : heap) {
+    files.push_back(std::move(candidate.second));
+  }
+  return files;
+}
+
+std::optional<std::size_t> FileTreeMetadata::findRow(FileTreeEntry const& entry) const
+{
+  auto it = m_Rows.find(&entry);
+
+  // An expired row belongs to a destroyed entry whose address has been reused:
+  if (it == m_Rows.end() || m_Entries[it->second].expired()) {
+    return {};
+  }
+  return it->second;
+}
+
+void FileTreeMetadata::setValues(std::shared_ptr<const FileTreeEntry> const& entry,
+                                 Values&& values)
+{
+  const qint64 time = values.lastModified.isValid()
+                          ? values.lastModified.toMSecsSinceEpoch()
+                          : UNKNOWN_TIME;
+
+  auto [it, inserted] = m_Rows.try_emplace(entry.get(), m_Keys.size());
+  if (inserted) {
+    m_Keys.push_back(entry.get());
+    m_Entries.push_back(entry);
+    m_Sizes.push_back(values.size);
+    m_Times.push_back(time);
+    m_Hashes.push_back(std::move(values.hash));
+  } else {
+    const std::size_t row = it->second;
+    m_Entries[row]        = entry;
+    m_Sizes[row]          = values.size;
+    m_Times[row]          = time;
+    m_Hashes[row]         = std::move(values.hash);
+  }
+
+  invalidateTotals(*entry);
+}
+
+void FileTreeMetadata::eraseRow(std::size_t row)
+{
+  const std::size_t last = m_Keys.size() - 1;
+  m_Rows.erase(m_Keys[row]);
+  if (row != last) {
+    m_Keys[row]         = m_Keys[last];
+    m_Entries[row]      = std::move(m_Entries[last]);
+    m_Sizes[row]        = m_Sizes[last];
+    m_Times[row]        = m_Times[last];
+    m_Hashes[row]       = std::move(m_Hashes[last]);
+    m_Rows[m_Keys[row]] = row;
+  }
+  m_Keys.pop_back();
+  m_Entries.pop_back();
+  m_Sizes.pop_back();
+  m_Times.pop_back();
+  m_Hashes.pop_back();
+}
+
+void FileTreeMetadata::invalidateTotals(FileTreeEntry const& entry) const
+{
+  if (m_Totals.empty()) {
+    return;
+  }
+  for (auto parent = entry.parent(); parent != nullptr; parent = parent->parent()) {
+    m_Totals.erase(parent.get());
+  }
+}
+
+qint64 FileTreeMetadata::subtreeSize(IFileTree const& tree) const
+{
+  // The revision of a tree changes when one of its subtrees is modified, so a cached
+  // total is valid as long as the revision did not change and no metadata of an entry
+  // in the tree was set since:
+  auto it = m_Totals.find(&tree);
+  if (it != m_Totals.end() && it->second.revision == tree.revision() &&
+      it->second.tree.lock().get() == &tree) {
+    return it->second.size;
+  }
+
+  qint64 total = 0;
+  for (auto const& entry : tree) {
+    if (entry->isDir()) {
+      total += subtreeSize(*entry->astree());
+    } else if (const auto row = findRow(*entry); row && m_Sizes[*row] > 0) {
+      total += m_Sizes[*row];
+    }
+  }
+
+  m_Totals[&tree] = Total{tree.astree(), tree.revision(), total};
+  return total;
+}
+
+}  // namespace MOBase
@@ -0,0 +1,202 @@
+/*
+Mod Organizer shared UI functionality
+
+Copyright (C) 2026 MO2 Team. All rights reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef FILETREEMETADATA_H
+#define FILETREEMETADATA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <QByteArray>
+#include <QDateTime>
+
+#include "dllimport.h"
+#include "ifiletree.h"
+
+namespace MOBase
+{
+
+/**
+ * @brief Store of metadata (size, modification time and content hash) for the entries
+ *     of file trees, kept out of the entries themselves.
+ *
+ * Metadata are stored in columns, i.e., one contiguous array per kind of metadata, so
+ * that queries over many entries, like largestFiles(), scan compact arrays. Totals
+ * of directories are cached and only recomputed for directories that were modified,
+ * see IFileTree::revision(), or that contain entries whose metadata changed.
+ *
+ * The store only references entries weakly: metadata of destroyed entries are ignored,
+ * and can be released with prune().
+ *
+ * All the methods of the store are thread-safe.
+ */
+class QDLLEXPORT FileTreeMetadata
+{
+public:
+  /**
+   * @brief Metadata of an entry.
+   */
+  struct Values
+  {
+    // Size in bytes, or -1 if unknown:
+    qint64 size = -1;
+
+    // Time of the last modification, invalid if unknown:
+    QDateTime lastModified;
+
+    // Hash of the content, empty if unknown:
+    QByteArray hash;
+  };
+
+  /**
+   * @brief Reserve space for the given number of entries, e.g., before filling the
+   *     store with many entries.
+   */
+  void reserve(std::size_t count);
+
+  /**
+   * @brief Set the metadata of the given entry.
+   *
+   * @param entry The entry.
+   * @param values Metadata of the entry.
+   */
+  void set(std::shared_ptr<const FileTreeEntry> const& entry, Values values);
+
+  /**
+   * @brief Set the metadata of the given entries, taking the lock of the store only
+   *     once, e.g., when populating a tree.
+   *
+   * @param values Entries and their metadata.
+   */
+  void set(std::vector<std::pair<std::shared_ptr<const FileTreeEntry>, Values>> values);
+
+  /**
+   * @brief Remove the metadata of the given entry.
+   *
+   * @return true if the entry had metadata, false otherwise.
+   */
+  bool erase(FileTreeEntry const& entry);
+
+  /**
+   * @brief Remove the metadata of the entries that have been destroyed.
+   *
+   * @return the number of removed entries.
+   */
+  std::size_t prune();
+
+  /**
+   * @return the number of entries in the store, including destroyed entries that have
+   *     not been pruned yet.
+   */
+  std::size_t count() const;
+
+  /**
+   * @return the metadata of the given entry, or an empty optional if the entry has
+   *     none.
+   */
+  std::optional<Values> get(FileTreeEntry const& entry) const;
+
+  /**
+   * @return the size of the given entry, or -1 if unknown.
+   */
+  qint64 size(FileTreeEntry const& entry) const;
+
+  /**
+   * @return the modification time of the given entry, invalid if unknown.
+   */
+  QDateTime lastModified(FileTreeEntry const& entry) const;
+
+  /**
+   * @return the content hash of the given entry, empty if unknown.
+   */
+  QByteArray hash(FileTreeEntry const& entry) const;
+
+  /**
+   * @brief Compute the total size of the files in the given tree, recursively. Files
+   *     whose size is unknown are ignored.
+   *
+   * The totals of the subtrees are cached, so calling this again after a few changes
+   * only recomputes the totals of the modified directories.
+   *
+   * @param tree The tree.
+   *
+   * @return the total size of the files in the tree, in bytes.
+   */
+  qint64 totalSize(std::shared_ptr<const IFileTree> const& tree) const;
+
+  /**
+   * @brief Find the largest files in the given tree, recursively.
+   *
+   * @param tree The tree.
+   * @param count Maximum number of files to return.
+   *
+   * @return the largest files, from the largest to the smallest.
+   */
+  std::vector<std::shared_ptr<const FileTreeEntry>>
+  largestFiles(std::shared_ptr<const IFileTree> const& tree, std::size_t count) const;
+
+private:
+  // Cached total of a directory:
+  struct Total
+  {
+    std::weak_ptr<const IFileTree> tree;
+    std::uint64_t revision;
+    qint64 size;
+  };
+
+  // Retrieve the row of the given entry, if the entry has one and is alive:
+  std::optional<std::size_t> findRow(FileTreeEntry const& entry) const;
+
+  // Set the values of the given entry, without locking:
+  void setValues(std::shared_ptr<const FileTreeEntry> const& entry, Values&& values);
+
+  // Remove the given row, moving the last row in its place, without locking:
+  void eraseRow(std::size_t row);
+
+  // Drop the cached totals of the parents of the given entry, without locking:
+  void invalidateTotals(FileTreeEntry const& entry) const;
+
+  // Compute the total size of the given tree, without locking:
+  qint64 subtreeSize(IFileTree const& tree) const;
+
+  mutable std::mutex m_Mutex;
+
+  // Row of each entry in the columns:
+  std::unordered_map<FileTreeEntry const*, std::size_t> m_Rows;
+
+  // Columns, where rows at the same index belong to the same entry:
+  std::vector<FileTreeEntry const*> m_Keys;
+  std::vector<std::weak_ptr<const FileTreeEntry>> m_Entries;
+  std::vector<qint64> m_Sizes;
+  std::vector<qint64> m_Times;
+  std::vector<QByteArray> m_Hashes;
+
+  mutable std::unordered_map<IFileTree const*, Total> m_Totals;
+};
+
+}  // namespace MOBase
+
+#endif
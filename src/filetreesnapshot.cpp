@@ -0,0 +1,401 @@
+#include "filetreesnapshot.h"
+
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+#include <QFile>
+#include <QObject>
+
+#include "safewritefile.h"
+
+namespace MOBase
+{
+
+// Layout of a snapshot, all integers are in native byte order and every part of the
+// snapshot is aligned on 4 bytes:
+//
+// - the header,
+// - the node table, containing header.nodeCount nodes, the first one being the root,
+// - the string table, containing header.stringsSize bytes, where each string is
+//   stored as its length followed by its UTF-16 code units.
+//
+// The children of a node are contiguous in the node table, with the directories
+// first, and both directories and files are sorted by case-folded name, i.e., the
+// same order as the entries of an IFileTree.
+struct FileTreeSnapshot::Header
+{
+  static constexpr quint32 MAGIC   = 0x54464f4d;  // MOFT
+  static constexpr quint32 VERSION = 1;
+
+  quint32 magic;
+  quint32 version;
+  quint32 nodeCount;
+  quint32 nodesOffset;
+  quint32 stringsOffset;
+  quint32 stringsSize;
+};
+
+struct FileTreeSnapshot::NodeRecord
+{
+  static constexpr quint32 DIRECTORY = 0x1;
+
+  // Offsets of the name and case-folded name in the string table:
+  quint32 name;
+  quint32 key;
+
+  quint32 flags;
+
+  // Index of the first child in the node table, number of children and number of
+  // directories among them:
+  quint32 first;
+  quint32 count;
+  quint32 directories;
+};
+
+QStringView FileTreeSnapshot::Node::name() const
+{
+  return m_Snapshot->string(record().name);
+}
+
+bool FileTreeSnapshot::Node::isDir() const
+{
+  return (record().flags & NodeRecord::DIRECTORY) != 0;
+}
+
+std::size_t FileTreeSnapshot::Node::size() const
+{
+  return record().count;
+}
+
+FileTreeSnapshot::Node FileTreeSnapshot::Node::at(std::size_t i) const
+{
+  return Node(m_Snapshot, record().first + static_cast<quint32>(i));
+}
+
+FileTreeSnapshot::Node FileTreeSnapshot::Node::find(QStringView path,
+                                                    IFileTree::FileTypes type) const
+{
+  Node current = *this;
+  qsizetype start = 0;
+  while (current && start < path.size()) {
+    qsizetype end = start;
+    while (end < path.size() && path[end] != '/' && path[end] != '\\') {
+      ++end;
+    }
+
+    if (end > start) {
+      // Only the last part of the path may be a file:
+      const bool last = end == path.size();
+      current         = current.child(
+          FileNameComparator::caseFold(path.mid(start, end - start).toString()),
+          last ? type : IFileTree::DIRECTORY);
+    }
+
+    start = end + 1;
+  }
+  return current;
+}
+
+FileTreeSnapshot::NodeRecord const& FileTreeSnapshot::Node::record() const
+{
+  return m_Snapshot->node(m_Index);
+}
+
+FileTreeSnapshot::Node FileTreeSnapshot::Node::child(QString const& key,
+                                                     IFileTree::FileTypes type) const
+{
+  NodeRecord const& parent = record();
+
+  // Binary search in [first, last):
+  const auto search = [this, &key](quint32 first, quint32 last) {
+    while (first < last) {
+      const quint32 middle = first + (last - first) / 2;
+      const int c = m_Snapshot->string(m_Snapshot->node(middle).key).compare(key);
+      if (c == 0) {
+        return Node(m_Snapshot, middle);
+      } else if (c < 0) {
+        first = middle + 1;
+      } else {
+        last = middle;
+      }
+    }
+    return Node();
+  };
+
+  const quint32 files = parent.first + parent.directories;
+  if (type.testFlag(IFileTree::DIRECTORY)) {
+    if (auto node = search(parent.first, files)) {
+      return node;
+    }
+  }
+  if (type.testFlag(IFileTree::FILE)) {
+    return search(files, parent.first + parent.count);
+  }
+  return Node();
+}
+
+QByteArray FileTreeSnapshot::serialize(std::shared_ptr<const IFileTree> tree)
+{
+  std::vector<NodeRecord> nodes;
+  QByteArray strings;
+
+  // Offsets of the strings already in the table:
+  std::unordered_map<QString, std::size_t> offsets;
+  const auto intern = [&](QString const& string) {
+    auto [it, inserted] = offsets.try_emplace(string, strings.size());
+    if (inserted) {
+      const quint32 length = static_cast<quint32>(string.size());
+      strings.append(reinterpret_cast<const char*>(&length), sizeof(length));
+      strings.append(reinterpret_cast<const char*>(string.utf16()),
+                     string.size() * sizeof(char16_t));
+      strings.append((4 - strings.size() % 4) % 4, '\0');
+    }
+    return static_cast<quint32>(it->second);
+  };
+
+  const auto makeRecord = [&intern](FileTreeEntry const& entry) {
+    return NodeRecord{intern(entry.name()),
+                      intern(FileNameComparator::caseFold(entry.name())),
+                      entry.isDir() ? NodeRecord::DIRECTORY : 0, 0, 0, 0};
+  };
+
+  // Nodes are added in breadth-first order, so that the children of a directory are
+  // contiguous, and trees[i] is the tree of the i-th node if it is a directory:
+  std::vector<IFileTree const*> trees{tree.get()};
+  nodes.push_back(makeRecord(*tree));
+
+  for (std::size_t i = 0; i < nodes.size(); ++i) {
+    if (trees[i] == nullptr) {
+      continue;
+    }
+
+    nodes[i].first = static_cast<quint32>(nodes.size());
+    for (auto entry : *trees[i]) {
+      nodes.push_back(makeRecord(*entry));
+      trees.push_back(entry->isDir() ? entry->astree().get() : nullptr);
+      nodes[i].count++;
+      nodes[i].directories += entry->isDir() ? 1 : 0;
+    }
+  }
+
+  const std::size_t nodesSize = nodes.size() * sizeof(NodeRecord);
+  if (sizeof(Header) + nodesSize + strings.size() >
+      std::numeric_limits<quint32>::max()) {
+    throw Exception(QObject::tr("The file tree '%1' is too large for a snapshot.")
+                        .arg(tree->path()));
+  }
+
+  Header header;
+  header.magic         = Header::MAGIC;
+  header.version       = Header::VERSION;
+  header.nodeCount     = static_cast<quint32>(nodes.size());
+  header.nodesOffset   = sizeof(Header);
+  header.stringsOffset = static_cast<quint32>(sizeof(Header) + nodesSize);
+  header.stringsSize   = static_cast<quint32>(strings.size());
+
+  QByteArray data;
+  data.reserve(header.stringsOffset + header.stringsSize);
+  data.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  data.append(reinterpret_cast<const char*>(nodes.data()), nodesSize);
+  data.append(strings);
+  return data;
+}
+
+void FileTreeSnapshot::save(std::shared_ptr<const IFileTree> tree, QString const& path)
+{
+  const QByteArray data = serialize(tree);
+
+  SafeWriteFile file(path);
+  if (file->write(data) != data.size()) {
+    throw Exception(QObject::tr("Failed to write the file tree snapshot '%1': %2")
+                        .arg(path)
+                        .arg(file->errorString()));
+  }
+  file.commit();
+}
+
+std::shared_ptr<const FileTreeSnapshot> FileTreeSnapshot::open(QString const& path)
+{
+  auto file = std::make_unique<QFile>(path);
+  if (!file->open(QIODevice::ReadOnly)) {
+    return nullptr;
+  }
+
+  const qint64 size = file->size();
+  uchar* data       = size > 0 ? file->map(0, size) : nullptr;
+  if (data == nullptr) {
+    return nullptr;
+  }
+
+  std::shared_ptr<const FileTreeSnapshot> snapshot(
+      new FileTreeSnapshot(std::move(file), {}, data, static_cast<std::size_t>(size)));
+  return snapshot->validate() ? snapshot : nullptr;
+}
+
+std::shared_ptr<const FileTreeSnapshot> FileTreeSnapshot::fromData(QByteArray data)
+{
+  std::shared_ptr<const FileTreeSnapshot> snapshot(
+      new FileTreeSnapshot(nullptr, std::move(data), nullptr, 0));
+  return snapshot->validate() ? snapshot : nullptr;
+}
+
+std::size_t FileTreeSnapshot::size() const
+{
+  return header().nodeCount;
+}
+
+FileTreeSnapshot::FileTreeSnapshot(std::unique_ptr<QFile> file, QByteArray buffer,
+                                   uchar const* data, std::size_t size)
+    : m_File(std::move(file)), m_Buffer(std::move(buffer)), m_Data(data), m_Size(size)
+{
+  if (m_File == nullptr) {
+    m_Data = reinterpret_cast<uchar const*>(m_Buffer.constData());
+    m_Size = static_cast<std::size_t>(m_Buffer.size());
+  }
+}
+
+FileTreeSnapshot::~FileTreeSnapshot() = default;
+
+bool FileTreeSnapshot::validate() const
+{
+  // Offsets are checked with 64-bit arithmetic so that they cannot overflow:
+  const auto aligned = [](quint64 offset) {
+    return offset % alignof(quint32) == 0;
+  };
+
+  if (m_Size < sizeof(Header) || !aligned(reinterpret_cast<quintptr>(m_Data))) {
+    return false;
+  }
+
+  Header const& h = header();
+  if (h.magic != Header::MAGIC || h.version != Header::VERSION || h.nodeCount == 0 ||
+      !aligned(h.nodesOffset) || !aligned(h.stringsOffset) ||
+      h.nodesOffset < sizeof(Header) ||
+      quint64{h.nodesOffset} + quint64{h.nodeCount} * sizeof(NodeRecord) > m_Size ||
+      quint64{h.stringsOffset} + h.stringsSize > m_Size) {
+    return false;
+  }
+
+  const auto validString = [this, &h, &aligned](quint32 offset) {
+    if (!aligned(offset) || quint64{offset} + sizeof(quint32) > h.stringsSize) {
+      return false;
+    }
+    quint32 length;
+    std::memcpy(&length, m_Data + h.stringsOffset + offset, sizeof(length));
+    return quint64{offset} + sizeof(quint32) + quint64{length} * sizeof(char16_t) <=
+           h.stringsSize;
+  };
+
+  for (quint32 i = 0; i < h.nodeCount; ++i) {
+    NodeRecord const& n = node(i);
+    const bool isDir    = n.flags == NodeRecord::DIRECTORY;
+
+    if (!validString(n.name) || !validString(n.key) ||
+        (n.flags & ~NodeRecord::DIRECTORY) != 0 || (i == 0 && !isDir) ||
+        (!isDir && n.count != 0) || n.directories > n.count) {
+      return false;
+    }
+
+    // Children must be after their parent, which guarantees that the snapshot has no
+    // cycle:
+    if (n.count > 0 &&
+        (n.first <= i || quint64{n.first} + n.count > quint64{h.nodeCount})) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+FileTreeSnapshot::Header const& FileTreeSnapshot::header() const
+{
+  return *reinterpret_cast<Header const*>(m_Data);
+}
+
+FileTreeSnapshot::NodeRecord const& FileTreeSnapshot::node(quint32 index) const
+{
+  return reinterpret_cast<NodeRecord const*>(m_Data + header().nodesOffset)[index];
+}
+
+QStringView FileTreeSnapshot::string(quint32 offset) const
+{
+  uchar const* p = m_Data + header().stringsOffset + offset;
+
+  quint32 length;
+  std::memcpy(&length, p, sizeof(length));
+  return QStringView(reinterpret_cast<char16_t const*>(p + sizeof(length)),
+                     static_cast<qsizetype>(length));
+}
+
+std::shared_ptr<SnapshotFileTree>
+SnapshotFileTree::create(std::shared_ptr<const FileTreeSnapshot> snapshot)
+{
+  auto root = snapshot->root();
+  return std::shared_ptr<SnapshotFileTree>(
+      new SnapshotFileTree(nullptr, std::move(snapshot), root));
+}
+
+SnapshotFileTree::SnapshotFileTree(std::shared_ptr<const IFileTree> parent,
+                                   std::shared_ptr<const FileTreeSnapshot> snapshot,
+                                   FileTreeSnapshot::Node node)
+    : FileTreeEntry(parent, node.name().toString()), IFileTree(),
+      m_Snapshot(std::move(snapshot)), m_Node(node)
+{}
+
+bool SnapshotFileTree::beforeReplace(IFileTree const*, FileTreeEntry const*,
+                                     FileTreeEntry const*)
+{
+  return false;
+}
+
+bool SnapshotFileTree::beforeInsert(IFileTree const*, FileTreeEntry const*)
+{
+  return false;
+}
+
+bool SnapshotFileTree::beforeRemove(IFileTree const*, FileTreeEntry const*)
+{
+  return false;
+}
+
+std::shared_ptr<FileTreeEntry>
+SnapshotFileTree::makeFile(std::shared_ptr<const IFileTree>, QString) const
+{
+  throw UnsupportedOperationException(
+      QObject::tr("Cannot create a file in a read-only snapshot tree."));
+}
+
+std::shared_ptr<IFileTree>
+SnapshotFileTree::makeDirectory(std::shared_ptr<const IFileTree>, QString) const
+{
+  throw UnsupportedOperationException(
+      QObject::tr("Cannot create a directory in a read-only snapshot tree."));
+}
+
+bool SnapshotFileTree::doPopulate(
+    std::shared_ptr<const IFileTree> parent,
+    std::vector<std::shared_ptr<FileTreeEntry>>& entries) const
+{
+  entries.reserve(m_Node.size());
+  for (std::size_t i = 0; i < m_Node.size(); ++i) {
+    const auto node = m_Node.at(i);
+    if (node.isDir()) {
+      entries.push_back(std::shared_ptr<SnapshotFileTree>(
+          new SnapshotFileTree(parent, m_Snapshot, node)));
+    } else {
+      entries.push_back(createFileEntry(parent, node.name().toString()));
+    }
+  }
+
+  // Snapshots are already sorted:
+  return true;
+}
+
+std::shared_ptr<IFileTree> SnapshotFileTree::doClone() const
+{
+  return std::shared_ptr<SnapshotFileTree>(
+      new SnapshotFileTree(nullptr, m_Snapshot, m_Node));
+}
+
+}  // namespace MOBase
@@ -0,0 +1,258 @@
+/*
+Mod Organizer shared UI functionality
+
+Copyright (C) 2026 MO2 Team. All rights reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef FILETREESNAPSHOT_H
+#define FILETREESNAPSHOT_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <QByteArray>
+#include <QString>
+#include <QStringView>
+
+#include "dllimport.h"
+#include "ifiletree.h"
+
+class QFile;
+
+namespace MOBase
+{
+
+/**
+ * @brief Immutable binary image of a file tree, that can be queried in place.
+ *
+ * A snapshot is a single buffer containing a header, a table of fixed-size nodes and
+ * a table of length-prefixed names, where each distinct name is only stored once. The
+ * children of a directory are contiguous in the node table and sorted like the
+ * entries of an IFileTree, so looking up a name is a binary search over the mapped
+ * data and never allocates nodes.
+ *
+ * Snapshots are meant to be used as a cache of trees that are expensive to build,
+ * e.g., the content of a mod on the disk: they are stored in native byte order and
+ * a snapshot written by an incompatible version or machine is simply rejected when
+ * opened.
+ *
+ * Snapshots are immutable, so they are thread-safe.
+ */
+class QDLLEXPORT FileTreeSnapshot
+{
+  struct Header;
+  struct NodeRecord;
+
+public:
+  /**
+   * @brief Lightweight reference to an entry of a snapshot.
+   *
+   * Nodes do not keep the snapshot alive, so they must not be used after the
+   * snapshot is destroyed.
+   */
+  class QDLLEXPORT Node
+  {
+  public:
+    /**
+     * @brief Create an invalid node.
+     */
+    Node() = default;
+
+    /**
+     * @return true if this node references an entry, false otherwise, e.g., if it
+     *     was returned by a lookup that failed.
+     */
+    bool isValid() const { return m_Snapshot != nullptr; }
+    explicit operator bool() const { return isValid(); }
+
+    /**
+     * @return the name of the entry, valid as long as the snapshot is.
+     */
+    QStringView name() const;
+
+    /**
+     * @return true if the entry is a directory, false if it is a file.
+     */
+    bool isDir() const;
+    bool isFile() const { return !isDir(); }
+
+    /**
+     * @return the number of children of the entry, which is 0 for files.
+     */
+    std::size_t size() const;
+
+    /**
+     * @return the child at the given index, where directories are before files and
+     *     both are sorted by name.
+     */
+    Node at(std::size_t i) const;
+
+    /**
+     * @brief Find the entry at the given path, relative to this entry.
+     *
+     * @param path Path to the entry, using / or \ as separators.
+     * @param type Types of entry to look for.
+     *
+     * @return the entry, or an invalid node if there is no such entry.
+     */
+    Node find(QStringView path,
+              IFileTree::FileTypes type = IFileTree::FILE_OR_DIRECTORY) const;
+
+  private:
+    friend class FileTreeSnapshot;
+
+    Node(FileTreeSnapshot const* snapshot, quint32 index)
+        : m_Snapshot(snapshot), m_Index(index)
+    {}
+
+    NodeRecord const& record() const;
+
+    // Find the child with the given name among the children of the given types:
+    Node child(QString const& key, IFileTree::FileTypes type) const;
+
+    FileTreeSnapshot const* m_Snapshot = nullptr;
+    quint32 m_Index                    = 0;
+  };
+
+  /**
+   * @brief Serialize the given tree. The whole tree is populated.
+   *
+   * @param tree Tree to serialize.
+   *
+   * @return the snapshot data.
+   *
+   * @throw Exception if the tree is too large to be stored in a snapshot.
+   */
+  static QByteArray serialize(std::shared_ptr<const IFileTree> tree);
+
+  /**
+   * @brief Serialize the given tree to the given file, see serialize(). The file is
+   *     only overwritten if the snapshot was written successfully.
+   *
+   * @param tree Tree to serialize.
+   * @param path Path of the file.
+   *
+   * @throw Exception if the file cannot be written.
+   */
+  static void save(std::shared_ptr<const IFileTree> tree, QString const& path);
+
+  /**
+   * @brief Open the snapshot in the given file. The file is mapped in memory and is
+   *     never read entirely.
+   *
+   * @param path Path of the file.
+   *
+   * @return the snapshot, or a null pointer if the file does not exist or is not a
+   *     valid snapshot.
+   */
+  static std::shared_ptr<const FileTreeSnapshot> open(QString const& path);
+
+  /**
+   * @brief Create a snapshot from the given data, e.g., as returned by serialize().
+   *
+   * @param data Snapshot data.
+   *
+   * @return the snapshot, or a null pointer if the data is not a valid snapshot.
+   */
+  static std::shared_ptr<const FileTreeSnapshot> fromData(QByteArray data);
+
+  /**
+   * @return the root of the snapshot, whose name is the name of the serialized tree.
+   */
+  Node root() const { return Node(this, 0); }
+
+  /**
+   * @return the number of entries in the snapshot, including the root.
+   */
+  std::size_t size() const;
+
+  ~FileTreeSnapshot();
+
+  FileTreeSnapshot(FileTreeSnapshot const&)            = delete;
+  FileTreeSnapshot& operator=(FileTreeSnapshot const&) = delete;
+
+private:
+  FileTreeSnapshot(std::unique_ptr<QFile> file, QByteArray buffer,
+                   uchar const* data, std::size_t size);
+
+  // Check that the data is a valid snapshot, such that no query can read outside of
+  // it or loop forever:
+  bool validate() const;
+
+  Header const& header() const;
+  NodeRecord const& node(quint32 index) const;
+  QStringView string(quint32 offset) const;
+
+  // Either the mapped file or the buffer holds the data:
+  std::unique_ptr<QFile> m_File;
+  QByteArray m_Buffer;
+  uchar const* m_Data;
+  std::size_t m_Size;
+};
+
+/**
+ * @brief Read-only implementation of IFileTree backed by a FileTreeSnapshot.
+ *
+ * Directories are populated lazily from the snapshot, so only the parts of the tree
+ * that are actually accessed are materialized. Creating files or directories in the
+ * tree throws UnsupportedOperationException, and inserting, replacing or removing
+ * entries fails.
+ */
+class QDLLEXPORT SnapshotFileTree : public IFileTree
+{
+public:
+  /**
+   * @brief Create a tree from the given snapshot.
+   *
+   * @param snapshot Snapshot to create the tree from.
+   *
+   * @return the root of the tree.
+   */
+  static std::shared_ptr<SnapshotFileTree>
+  create(std::shared_ptr<const FileTreeSnapshot> snapshot);
+
+  /**
+   * @return the snapshot backing this tree.
+   */
+  std::shared_ptr<const FileTreeSnapshot> snapshot() const { return m_Snapshot; }
+
+protected:
+  SnapshotFileTree(std::shared_ptr<const IFileTree> parent,
+                   std::shared_ptr<const FileTreeSnapshot> snapshot,
+                   FileTreeSnapshot::Node node);
+
+  bool beforeReplace(IFileTree const* dstTree, FileTreeEntry const* destination,
+                     FileTreeEntry const* source) override;
+  bool beforeInsert(IFileTree const* entry, FileTreeEntry const* name) override;
+  bool beforeRemove(IFileTree const* entry, FileTreeEntry const* name) override;
+  std::shared_ptr<FileTreeEntry> makeFile(std::shared_ptr<const IFileTree> parent,
+                                          QString name) const override;
+  std::shared_ptr<IFileTree> makeDirectory(std::shared_ptr<const IFileTree> parent,
+                                           QString name) const override;
+  bool doPopulate(std::shared_ptr<const IFileTree> parent,
+                  std::vector<std::shared_ptr<FileTreeEntry>>& entries) const override;
+  std::shared_ptr<IFileTree> doClone() const override;
+
+private:
+  std::shared_ptr<const FileTreeSnapshot> m_Snapshot;
+  FileTreeSnapshot::Node m_Node;
+};
+
+}  // namespace MOBase
+
+#endif
@@ -4,8 +4,10 @@
 #include <format>
 #include <string>
 #include <string_view>
+#include <type_traits>
 
 #include <QString>
+#include <QStringEncoder>
 #include <QStringView>
 
 namespace MOBase::details
@@ -34,6 +36,32 @@ inline std::basic_string<char32_t> toStdBasicString(QString const& qstring)
   return qstring.toStdU32String();
 }
 
+// appends the given string to out as UTF-8, without any intermediate string
+//
+inline void appendUtf8(std::string& out, QStringView s)
+{
+  QStringEncoder encoder(QStringConverter::Utf8, QStringConverter::Flag::Stateless);
+
+  const std::size_t size = out.size();
+  out.resize(size + static_cast<std::size_t>(encoder.requiredSpace(s.size())));
+
+  char* const begin = out.data() + size;
+  char* const end   = encoder.appendToBuffer(begin, s);
+  out.resize(size + static_cast<std::size_t>(end - begin));
+}
+
+// converts the given string to UTF-8 in a buffer owned by the calling thread, which
+// is overwritten by the next call; used by the formatters so that formatting a
+// QString doesn't allocate a new std::string every time
+//
+inline std::string const& toUtf8Buffer(QStringView s)
+{
+  thread_local std::string buffer;
+  buffer.clear();
+  appendUtf8(buffer, s);
+  return buffer;
+}
+
 inline QString fromStdBasicString(std::string const& value)
 {
   return QString::fromStdString(value);
@@ -58,8 +86,13 @@ struct std::formatter<QString, CharT> : std::formatter<std::basic_string<CharT>,
   template <class FmtContext>
   FmtContext::iterator format(QString s, FmtContext& ctx) const
   {
-    return std::formatter<std::basic_string<CharT>, CharT>::format(
-        MOBase::details::toStdBasicString<CharT>(s), ctx);
+    if constexpr (std::is_same_v<CharT, char>) {
+      return std::formatter<std::basic_string<CharT>, CharT>::format(
+          MOBase::details::toUtf8Buffer(s), ctx);
+    } else {
+      return std::formatter<std::basic_string<CharT>, CharT>::format(
+          MOBase::details::toStdBasicString<CharT>(s), ctx);
+    }
   }
 };
 
@@ -84,6 +117,11 @@ struct std::formatter<QStringView, CharT> : std::formatter<QString, CharT>
   template <class FmtContext>
   FmtContext::iterator format(QStringView s, FmtContext& ctx) const
   {
-    return std::formatter<QString, CharT>::format(s.toString(), ctx);
+    if constexpr (std::is_same_v<CharT, char>) {
+      return std::formatter<std::basic_string<CharT>, CharT>::format(
+          MOBase::details::toUtf8Buffer(s), ctx);
+    } else {
+      return std::formatter<QString, CharT>::format(s.toString(), ctx);
+    }
   }
 };
@@ -1,8 +1,13 @@
 #include "ifiletree.h"
 
 #include <algorithm>
+#include <exception>
+#include <iterator>
 #include <stack>
 
+#include <QObject>
+#include <QThreadPool>
+
 // FileTreeEntry:
 namespace MOBase
 {
@@ -10,40 +15,68 @@ FileTreeEntry::FileTreeEntry(std::shared_ptr<const IFileTree> parent, QString na
     : m_Parent(parent), m_Name(name)
 {}
 
+void FileTreeEntry::setName(QString name)
+{
+  m_Name = FileNamePool::Name(name);
+}
+
+QStringView FileTreeEntry::suffixView() const
+{
+  QString const& name = m_Name.str();
+  const qsizetype idx = name.lastIndexOf(u'.');
+  return (isDir() || idx == -1) ? QStringView() : QStringView(name).sliced(idx + 1);
+}
+
 QString FileTreeEntry::suffix() const
 {
-  const qsizetype idx = m_Name.lastIndexOf(".");
-  return (isDir() || idx == -1) ? "" : m_Name.mid(idx + 1);
+  return suffixView().toString();
 }
 
 bool FileTreeEntry::hasSuffix(QString suffix) const
 {
-  return this->suffix().compare(suffix, FileNameComparator::CaseSensitivity) == 0;
+  return suffixView().compare(suffix, FileNameComparator::CaseSensitivity) == 0;
 }
 
 bool FileTreeEntry::hasSuffix(QStringList suffixes) const
 {
-  return suffixes.contains(suffix(), FileNameComparator::CaseSensitivity);
+  const QStringView suffix = suffixView();
+  return std::any_of(suffixes.begin(), suffixes.end(), [suffix](auto const& s) {
+    return suffix.compare(s, FileNameComparator::CaseSensitivity) == 0;
+  });
 }
 
 QString FileTreeEntry::pathFrom(std::shared_ptr<const IFileTree> tree,
                                 QString sep) const
 {
+  // Collect the parents up to the given tree, without the root of the tree since its
+  // name is not part of the path, and compute the length of the path. The parents
+  // are kept alive by the topmost one:
+  std::vector<FileTreeEntry const*> parents;
+  qsizetype length = m_Name.str().size();
 
-  // We will construct the path from right to left:
-  QString path = name();
-
-  auto p = parent();
+  std::shared_ptr<const IFileTree> p = parent();
   while (p != nullptr && p != tree) {
-    // We need to check the parent, otherwize we are going to prepend the name
-    // and a / for the base, which we do not want.
-    if (p->parent() != nullptr) {
-      path = p->name() + sep + path;
+    auto next = p->parent();
+    if (next != nullptr) {
+      parents.push_back(p.get());
+      length += p->m_Name.str().size() + sep.size();
     }
-    p = p->parent();
+    p = std::move(next);
+  }
+
+  if (p != tree) {
+    return QString();
   }
 
-  return p == tree ? path : QString();
+  // Fill the path in a single allocation:
+  QString path;
+  path.reserve(length);
+  for (auto it = parents.rbegin(); it != parents.rend(); ++it) {
+    path.append((*it)->m_Name.str());
+    path.append(sep);
+  }
+  path.append(m_Name.str());
+  return path;
 }
 
 bool FileTreeEntry::detach()
@@ -76,21 +109,142 @@ FileTreeEntry::createFileEntry(std::shared_ptr<const IFileTree> parent, QString
 namespace MOBase
 {
 
+namespace
+{
+// Number of lazy clones that have not copied their entries yet, used to skip
+// IFileTree::detachClones() when there are none, which is the common case:
+std::atomic<std::size_t> g_PendingClones{0};
+
+// Number of subscriptions on all the trees, used to skip IFileTree::notifyChange()
+// when there are none, which is the common case:
+std::atomic<std::size_t> g_Subscriptions{0};
+std::atomic<std::size_t> g_NextSubscription{1};
+
+// Number of trees with a suffix index, used to skip IFileTree::updateSuffixIndexes()
+// when there are none, which is the common case:
+std::atomic<std::size_t> g_SuffixIndexes{0};
+
+// Set of tasks running on a thread pool, where tasks can start other tasks. Exceptions
+// cannot cross the thread pool, so the first one is kept and thrown by wait() once
+// all the tasks are done:
+class TaskGroup
+{
+public:
+  explicit TaskGroup(int maxThreads)
+  {
+    if (maxThreads > 0) {
+      m_Pool.setMaxThreadCount(maxThreads);
+    }
+  }
+
+  template <class Task>
+  void start(Task task)
+  {
+    m_Pool.start([this, task = std::move(task)] {
+      try {
+        task();
+      } catch (...) {
+        std::scoped_lock lock(m_ErrorMutex);
+        if (!m_Error) {
+          m_Error = std::current_exception();
+        }
+      }
+    });
+  }
+
+  void wait()
+  {
+    m_Pool.waitForDone();
+    if (m_Error) {
+      std::rethrow_exception(m_Error);
+    }
+  }
+
+private:
+  QThreadPool m_Pool;
+  std::mutex m_ErrorMutex;
+  std::exception_ptr m_Error;
+};
+}  // namespace
+
+struct IFileTree::Extras
+{
+  std::mutex mutex;
+
+  // Source of the tree if it is a lazy clone that has not been populated yet, and
+  // lazy clones of the tree, see clone():
+  std::shared_ptr<const IFileTree> cloneSource;
+  std::vector<std::weak_ptr<const IFileTree>> pendingClones;
+
+  // Callbacks registered with subscribe(), by subscription identifier:
+  std::vector<std::pair<std::size_t, ChangeCallback>> subscribers;
+
+  // Index of the files under the tree by hash of their suffix, only built on lookup,
+  // and then updated by updateSuffixIndexes(); files are counted since they can be
+  // transiently indexed twice while they are moved:
+  using SuffixIndex =
+      std::unordered_map<std::size_t, std::unordered_map<FileTreeEntry*, std::size_t>>;
+  std::unique_ptr<SuffixIndex> suffixIndex;
+
+  // Set by freeze() once the suffix index is built, before the tree is marked as
+  // frozen; the index is then never modified, and read without the lock:
+  std::atomic<bool> frozenSuffixIndex{false};
+};
+
+IFileTree::Extras& IFileTree::extras() const
+{
+  if (Extras* extras = m_Extras.load(std::memory_order_acquire)) {
+    return *extras;
+  }
+
+  // Const trees can be used from multiple threads, the first allocation wins:
+  auto extras      = std::make_unique<Extras>();
+  Extras* expected = nullptr;
+  if (m_Extras.compare_exchange_strong(expected, extras.get(),
+                                       std::memory_order_acq_rel,
+                                       std::memory_order_acquire)) {
+    return *extras.release();
+  }
+  return *expected;
+}
+
 /**
  * Comparator for file entries.
  */
 struct FileEntryComparator
 {
+  bool operator()(FileTreeEntry const& a, FileTreeEntry const& b) const
+  {
+    const bool aIsDir = a.isDir(), bIsDir = b.isDir();
+    if (aIsDir != bIsDir) {
+      return aIsDir;
+    }
+
+    return compare(a.m_Name, b.m_Name) < 0;
+  }
+
   bool operator()(std::shared_ptr<FileTreeEntry> const& a,
                   std::shared_ptr<FileTreeEntry> const& b) const
   {
-    if (a->isDir() && !b->isDir()) {
-      return true;
-    } else if (!a->isDir() && b->isDir()) {
-      return false;
-    } else {
-      return FileNameComparator::compare(a->name(), b->name()) < 0;
-    }
+    return (*this)(*a, *b);
+  }
+
+  /**
+   * @brief Check if the two given entries have the same name (regardless of
+   *     their types).
+   */
+  static bool sameName(FileTreeEntry const& a, FileTreeEntry const& b)
+  {
+    return sameKey(a.m_Name, b.m_Name);
+  }
+
+  /**
+   * @brief Compare the names of the two given entries (regardless of their types).
+   */
+  static bool nameLess(std::shared_ptr<FileTreeEntry> const& a,
+                       std::shared_ptr<FileTreeEntry> const& b)
+  {
+    return compare(a->m_Name, b->m_Name) < 0;
   }
 };
 
@@ -101,31 +255,37 @@ struct FileEntryComparator
 struct MatchEntryComparator
 {
 
-  MatchEntryComparator(QString const& name, FileTreeEntry::FileTypes matchTypes)
-      : m_Name(name), m_MatchTypes(matchTypes)
+  MatchEntryComparator(QStringView name, FileTreeEntry::FileTypes matchTypes)
+      : m_Name(name), m_Hash(FileNameComparator::hash(name)), m_MatchTypes(matchTypes)
   {}
 
-  bool operator()(const std::shared_ptr<const FileTreeEntry>& fileEntry) const
+  // The hash of the name, usable to query the index of a tree:
+  std::size_t hash() const { return m_Hash; }
+
+  bool operator()(FileTreeEntry const* fileEntry) const
   {
-    return m_MatchTypes.testFlag(fileEntry->fileType()) &&
+    // Only compare the names if the hashes match, which is cheap and discards
+    // almost all mismatches:
+    return fileEntry->m_Name.hash() == m_Hash &&
+           m_MatchTypes.testFlag(fileEntry->fileType()) &&
            fileEntry->compare(m_Name) == 0;
   }
 
-  bool operator()(const std::shared_ptr<FileTreeEntry>& fileEntry) const
+  bool operator()(const std::shared_ptr<const FileTreeEntry>& fileEntry) const
   {
-    return m_MatchTypes.testFlag(fileEntry->fileType()) &&
-           fileEntry->compare(m_Name) == 0;
+    return (*this)(fileEntry.get());
   }
 
 private:
-  QString const& m_Name;
+  QStringView m_Name;
+  std::size_t m_Hash;
   FileTreeEntry::FileTypes m_MatchTypes;
 };
 
 /**
  *
  */
-bool IFileTree::exists(QString path, FileTypes type) const
+bool IFileTree::exists(QStringView path, FileTypes type) const
 {
   return find(path, type) != nullptr;
 }
@@ -133,13 +293,14 @@ bool IFileTree::exists(QString path, FileTypes type) const
 /**
  *
  */
-std::shared_ptr<FileTreeEntry> IFileTree::find(QString path, FileTypes type)
+std::shared_ptr<FileTreeEntry> IFileTree::find(QStringView path, FileTypes type)
 {
-  return fetchEntry(splitPath(path), type);
+  return fetchEntry(path, type);
 }
-std::shared_ptr<const FileTreeEntry> IFileTree::find(QString path, FileTypes type) const
+std::shared_ptr<const FileTreeEntry> IFileTree::find(QStringView path,
+                                                     FileTypes type) const
 {
-  return fetchEntry(splitPath(path), type);
+  return fetchEntry(path, type);
 }
 
 /**
@@ -176,40 +337,630 @@ void IFileTree::walk(
   }
 }
 
+IFileTree::WalkPath::WalkPath(IFileTree const* tree, QChar sep)
+    : m_Sep(sep), m_Trees{tree}, m_Lengths{0}, m_Valid(1)
+{}
+
+QString const& IFileTree::WalkPath::str() const
+{
+  // The buffer may contain the path of trees that have been popped since the last
+  // call, so it is always truncated to the valid part first:
+  m_Buffer.truncate(m_Lengths[m_Valid - 1]);
+  m_Lengths.resize(m_Trees.size());
+  for (std::size_t i = m_Valid; i < m_Trees.size(); ++i) {
+    m_Buffer += m_Trees[i]->name();
+    m_Buffer += m_Sep;
+    m_Lengths[i] = m_Buffer.size();
+  }
+  m_Valid = m_Trees.size();
+  return m_Buffer;
+}
+
+namespace
+{
+
+// Retrieve shared pointers to the given entries:
+template <class Entry>
+std::vector<std::shared_ptr<Entry>> toShared(std::vector<FileTreeEntry*> const& entries)
+{
+  std::vector<std::shared_ptr<Entry>> result;
+  result.reserve(entries.size());
+  for (auto* entry : entries) {
+    result.push_back(entry->shared_from_this());
+  }
+  return result;
+}
+
+// Add the indices of the segments following ** segments, since these can match
+// no directory at all:
+void closeStates(std::vector<FileGlob::Segment> const& segments,
+                 std::vector<std::size_t>& states)
+{
+  for (std::size_t i = 0; i < states.size(); ++i) {
+    const auto s = states[i];
+    if (s < segments.size() && segments[s].kind == FileGlob::SegmentKind::RECURSIVE &&
+        std::find(states.begin(), states.end(), s + 1) == states.end()) {
+      states.push_back(s + 1);
+    }
+  }
+}
+
+}  // namespace
+
+std::vector<std::shared_ptr<FileTreeEntry>> IFileTree::findAll(FileGlob const& pattern,
+                                                               FileTypes types)
+{
+  std::vector<FileTreeEntry*> matches;
+  collectMatches(pattern, types, {0}, matches);
+  return toShared<FileTreeEntry>(matches);
+}
+
+std::vector<std::shared_ptr<const FileTreeEntry>>
+IFileTree::findAll(FileGlob const& pattern, FileTypes types) const
+{
+  std::vector<FileTreeEntry*> matches;
+  collectMatches(pattern, types, {0}, matches);
+  return toShared<const FileTreeEntry>(matches);
+}
+
+std::vector<std::shared_ptr<FileTreeEntry>>
+IFileTree::findAll(QRegularExpression const& regex, FileTypes types, QChar sep)
+{
+  std::vector<FileTreeEntry*> matches;
+  collectMatches(regex, types, sep, matches);
+  return toShared<FileTreeEntry>(matches);
+}
+
+std::vector<std::shared_ptr<const FileTreeEntry>>
+IFileTree::findAll(QRegularExpression const& regex, FileTypes types, QChar sep) const
+{
+  std::vector<FileTreeEntry*> matches;
+  collectMatches(regex, types, sep, matches);
+  return toShared<const FileTreeEntry>(matches);
+}
+
+std::vector<std::shared_ptr<FileTreeEntry>>
+IFileTree::findBySuffix(QString const& suffix)
+{
+  std::vector<FileTreeEntry*> matches;
+  collectBySuffix(suffix, matches);
+  return toShared<FileTreeEntry>(matches);
+}
+
+std::vector<std::shared_ptr<const FileTreeEntry>>
+IFileTree::findBySuffix(QString const& suffix) const
+{
+  std::vector<FileTreeEntry*> matches;
+  collectBySuffix(suffix, matches);
+  return toShared<const FileTreeEntry>(matches);
+}
+
+std::vector<std::shared_ptr<FileTreeEntry>>
+IFileTree::findBySuffix(QStringList const& suffixes)
+{
+  std::vector<FileTreeEntry*> matches;
+  for (auto& suffix : suffixes) {
+    collectBySuffix(suffix, matches);
+  }
+  return toShared<FileTreeEntry>(matches);
+}
+
+std::vector<std::shared_ptr<const FileTreeEntry>>
+IFileTree::findBySuffix(QStringList const& suffixes) const
+{
+  std::vector<FileTreeEntry*> matches;
+  for (auto& suffix : suffixes) {
+    collectBySuffix(suffix, matches);
+  }
+  return toShared<const FileTreeEntry>(matches);
+}
+
+void IFileTree::collectBySuffix(QString const& suffix,
+                                std::vector<FileTreeEntry*>& matches) const
+{
+  const auto collect = [&suffix, &matches](Extras::SuffixIndex const& index) {
+    auto it = index.find(FileNameComparator::hash(suffix));
+    if (it == index.end()) {
+      return;
+    }
+
+    // Filter out hash collisions:
+    for (auto& [entry, count] : it->second) {
+      if (entry->hasSuffix(suffix)) {
+        matches.push_back(entry);
+      }
+    }
+  };
+
+  // The index of a frozen tree is built by freeze() and never modified:
+  if (m_Frozen.load(std::memory_order_acquire)) {
+    Extras* extras = m_Extras.load(std::memory_order_acquire);
+    if (extras != nullptr &&
+        extras->frozenSuffixIndex.load(std::memory_order_acquire)) {
+      collect(*extras->suffixIndex);
+      return;
+    }
+  }
+
+  // The index is kept up to date by updateSuffixIndexes() once built:
+  Extras& extras = this->extras();
+  std::unique_lock lock(extras.mutex);
+  buildSuffixIndex(extras, lock);
+  collect(*extras.suffixIndex);
+}
+
+void IFileTree::buildSuffixIndex(Extras& extras,
+                                 std::unique_lock<std::mutex>& lock) const
+{
+  if (extras.suffixIndex != nullptr) {
+    return;
+  }
+
+  // The index is built without the lock, which populating this tree takes if it is a
+  // lazy clone:
+  lock.unlock();
+  auto index = std::make_unique<Extras::SuffixIndex>();
+  walkEntries([&index](WalkPath const&, FileTreeEntry const& entry) {
+    if (entry.isFile()) {
+      (*index)[FileNameComparator::hash(entry.suffixView())].emplace(
+          const_cast<FileTreeEntry*>(&entry), 1);
+    }
+  });
+  lock.lock();
+
+  if (extras.suffixIndex == nullptr) {
+    extras.suffixIndex = std::move(index);
+    g_SuffixIndexes.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void IFileTree::updateSuffixIndexes(std::span<FileTreeEntry const* const> entries,
+                                    bool insert)
+{
+  if (g_SuffixIndexes.load(std::memory_order_relaxed) == 0 || entries.empty()) {
+    return;
+  }
+
+  // Indexes are never dropped once built:
+  std::vector<std::shared_ptr<IFileTree>> indexed;
+  for (auto tree = astree(); tree != nullptr; tree = tree->parent()) {
+    Extras* extras = tree->m_Extras.load(std::memory_order_acquire);
+    if (extras == nullptr) {
+      continue;
+    }
+    std::scoped_lock lock(extras->mutex);
+    if (extras->suffixIndex != nullptr) {
+      indexed.push_back(tree);
+    }
+  }
+
+  if (indexed.empty()) {
+    return;
+  }
+
+  // The files themselves, or the files under the directories:
+  std::vector<FileTreeEntry*> files;
+  for (auto* entry : entries) {
+    if (entry->isFile()) {
+      files.push_back(const_cast<FileTreeEntry*>(entry));
+    } else {
+      entry->m_Tree->walkEntries([&files](WalkPath const&, FileTreeEntry const& e) {
+        if (e.isFile()) {
+          files.push_back(const_cast<FileTreeEntry*>(&e));
+        }
+      });
+    }
+  }
+
+  if (files.empty()) {
+    return;
+  }
+
+  // Files are counted, so that an entry moved between two subtrees of an indexed
+  // tree stays indexed whether it is added to its new parent or removed from its
+  // previous one first:
+  for (auto& tree : indexed) {
+    Extras& extras = *tree->m_Extras.load(std::memory_order_acquire);
+    std::scoped_lock lock(extras.mutex);
+    auto& index = *extras.suffixIndex;
+    for (auto* file : files) {
+      const std::size_t hash = FileNameComparator::hash(file->suffixView());
+      if (insert) {
+        ++index[hash][file];
+        continue;
+      }
+
+      auto bucket = index.find(hash);
+      if (bucket == index.end()) {
+        continue;
+      }
+      if (auto it = bucket->second.find(file);
+          it != bucket->second.end() && --it->second == 0) {
+        bucket->second.erase(it);
+        if (bucket->second.empty()) {
+          index.erase(bucket);
+        }
+      }
+    }
+  }
+}
+
+void IFileTree::updateSuffixIndexes(
+    std::vector<std::shared_ptr<FileTreeEntry>> const& entries, bool insert)
+{
+  if (g_SuffixIndexes.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+
+  std::vector<FileTreeEntry const*> pointers;
+  pointers.reserve(entries.size());
+  for (auto const& entry : entries) {
+    pointers.push_back(entry.get());
+  }
+  updateSuffixIndexes(pointers, insert);
+}
+
+std::vector<IFileTree::Difference>
+IFileTree::diff(std::shared_ptr<const IFileTree> other) const
+{
+  std::vector<Difference> differences;
+  diffTrees(*this, *other, differences);
+  return differences;
+}
+
+void IFileTree::diffTrees(IFileTree const& before, IFileTree const& after,
+                          std::vector<Difference>& differences)
+{
+  if (before.contentSource() == after.contentSource()) {
+    return;
+  }
+
+  using Entries  = std::vector<std::shared_ptr<FileTreeEntry>>;
+  using Iterator = Entries::const_iterator;
+
+  // Merge-join the two given sorted ranges, calling one of the given functions for
+  // each entry or pair of entries with the same name:
+  const auto mergeJoin = [](Iterator aIt, Iterator aEnd, Iterator bIt, Iterator bEnd,
+                            auto&& onBoth, auto&& onA, auto&& onB) {
+    while (aIt != aEnd && bIt != bEnd) {
+      if (FileEntryComparator::nameLess(*aIt, *bIt)) {
+        onA(*aIt++);
+      } else if (FileEntryComparator::nameLess(*bIt, *aIt)) {
+        onB(*bIt++);
+      } else {
+        onBoth(*aIt++, *bIt++);
+      }
+    }
+    std::for_each(aIt, aEnd, onA);
+    std::for_each(bIt, bEnd, onB);
+  };
+
+  const auto diff = [&differences](Difference::Kind kind,
+                                   std::shared_ptr<FileTreeEntry> const& a,
+                                   std::shared_ptr<FileTreeEntry> const& b) {
+    differences.push_back({kind, a, b});
+  };
+
+  // Entries are sorted with directories first, so each vector is split in two sorted
+  // ranges, one for directories and one for files:
+  Entries const& a = before.entries();
+  Entries const& b = after.entries();
+  const auto isDir = [](auto const& entry) {
+    return entry->isDir();
+  };
+  const auto aFiles = std::partition_point(a.begin(), a.end(), isDir);
+  const auto bFiles = std::partition_point(b.begin(), b.end(), isDir);
+
+  // Entries only in one of the trees, which may still have a different type in the
+  // other tree:
+  Entries removedDirs, addedDirs, removedFiles, addedFiles;
+  std::vector<std::pair<IFileTree const*, IFileTree const*>> subtrees;
+
+  mergeJoin(
+      a.begin(), aFiles, b.begin(), bFiles,
+      [&subtrees](auto const& x, auto const& y) {
+        subtrees.push_back({x->m_Tree, y->m_Tree});
+      },
+      [&removedDirs](auto const& x) {
+        removedDirs.push_back(x);
+      },
+      [&addedDirs](auto const& y) {
+        addedDirs.push_back(y);
+      });
+
+  mergeJoin(
+      aFiles, a.end(), bFiles, b.end(), [](auto const&, auto const&) {},
+      [&removedFiles](auto const& x) {
+        removedFiles.push_back(x);
+      },
+      [&addedFiles](auto const& y) {
+        addedFiles.push_back(y);
+      });
+
+  // Pair directories that became files and files that became directories:
+  mergeJoin(
+      removedDirs.cbegin(), removedDirs.cend(), addedFiles.cbegin(), addedFiles.cend(),
+      [&diff](auto const& x, auto const& y) {
+        diff(Difference::Kind::TYPE_CHANGED, x, y);
+      },
+      [&diff](auto const& x) {
+        diff(Difference::Kind::REMOVED, x, nullptr);
+      },
+      [&diff](auto const& y) {
+        diff(Difference::Kind::ADDED, nullptr, y);
+      });
+
+  mergeJoin(
+      removedFiles.cbegin(), removedFiles.cend(), addedDirs.cbegin(), addedDirs.cend(),
+      [&diff](auto const& x, auto const& y) {
+        diff(Difference::Kind::TYPE_CHANGED, x, y);
+      },
+      [&diff](auto const& x) {
+        diff(Difference::Kind::REMOVED, x, nullptr);
+      },
+      [&diff](auto const& y) {
+        diff(Difference::Kind::ADDED, nullptr, y);
+      });
+
+  for (auto& [x, y] : subtrees) {
+    diffTrees(*x, *y, differences);
+  }
+}
+
+std::size_t IFileTree::subscribe(ChangeCallback callback) const
+{
+  const std::size_t subscription =
+      g_NextSubscription.fetch_add(1, std::memory_order_relaxed);
+
+  Extras& extras = this->extras();
+  std::scoped_lock lock(extras.mutex);
+  extras.subscribers.emplace_back(subscription, std::move(callback));
+  g_Subscriptions.fetch_add(1, std::memory_order_relaxed);
+  return subscription;
+}
+
+bool IFileTree::unsubscribe(std::size_t subscription) const
+{
+  Extras* extras = m_Extras.load(std::memory_order_acquire);
+  if (extras == nullptr) {
+    return false;
+  }
+
+  std::scoped_lock lock(extras->mutex);
+  const auto count = std::erase_if(extras->subscribers, [subscription](auto const& s) {
+    return s.first == subscription;
+  });
+  g_Subscriptions.fetch_sub(count, std::memory_order_relaxed);
+  return count > 0;
+}
+
+void IFileTree::notifyChange(Change::Kind kind, FileTreeEntry const& entry,
+                             IFileTree const* tree, IFileTree const* previousTree,
+                             QString const* previousName)
+{
+  if (g_Subscriptions.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+
+  // Trees with subscribers containing either location of the entry, and callbacks,
+  // copied so that they are called without holding any lock:
+  std::vector<IFileTree const*> observers;
+  std::vector<std::vector<ChangeCallback>> callbacks;
+  for (auto* start : {tree, previousTree}) {
+    for (auto t = start ? start->astree() : nullptr; t != nullptr; t = t->parent()) {
+      if (std::find(observers.begin(), observers.end(), t.get()) != observers.end()) {
+        continue;
+      }
+      Extras* extras = t->m_Extras.load(std::memory_order_acquire);
+      if (extras == nullptr) {
+        continue;
+      }
+      std::scoped_lock lock(extras->mutex);
+      if (!extras->subscribers.empty()) {
+        observers.push_back(t.get());
+        auto& c = callbacks.emplace_back();
+        for (auto& [id, callback] : extras->subscribers) {
+          c.push_back(callback);
+        }
+      }
+    }
+  }
+
+  // Path of the entry with the given name in the given tree, relative to the given
+  // observer, or a null string if the tree is not under the observer:
+  const auto relativePath = [](IFileTree const* observer, IFileTree const* tree,
+                               QString const& name) {
+    QStringList parts{name};
+    for (auto t = tree ? tree->astree() : nullptr; t != nullptr; t = t->parent()) {
+      if (t.get() == observer) {
+        std::reverse(parts.begin(), parts.end());
+        return parts.join("\\");
+      }
+      parts.push_back(t->name());
+    }
+    return QString();
+  };
+
+  const auto self = entry.shared_from_this();
+  for (std::size_t i = 0; i < observers.size(); ++i) {
+    Change change{kind, self, relativePath(observers[i], tree, entry.name()),
+                  relativePath(observers[i], previousTree,
+                               previousName ? *previousName : entry.name())};
+
+    // Report moves from or to outside of the observer as removals or insertions:
+    if (kind == Change::Kind::MOVED && change.previousPath.isNull()) {
+      change.kind = Change::Kind::INSERTED;
+    } else if ((kind == Change::Kind::MOVED || kind == Change::Kind::MERGED) &&
+               change.path.isNull()) {
+      change.kind = Change::Kind::REMOVED;
+      change.path = std::exchange(change.previousPath, QString());
+    }
+
+    for (auto& callback : callbacks[i]) {
+      callback(change);
+    }
+  }
+}
+
+IFileTree const* IFileTree::contentSource() const
+{
+  IFileTree const* tree = this;
+  while (true) {
+    Extras* extras = tree->m_Extras.load(std::memory_order_acquire);
+    if (extras == nullptr) {
+      return tree;
+    }
+    std::scoped_lock lock(extras->mutex);
+    if (extras->cloneSource == nullptr) {
+      return tree;
+    }
+    tree = extras->cloneSource.get();
+  }
+}
+
+void IFileTree::touch()
+{
+  std::shared_ptr<IFileTree> tree = astree();
+  while (tree != nullptr) {
+    tree->m_Revision.fetch_add(1, std::memory_order_release);
+    tree = tree->parent();
+  }
+}
+
+void IFileTree::collectMatches(FileGlob const& pattern, FileTypes types,
+                               std::vector<std::size_t> states,
+                               std::vector<FileTreeEntry*>& matches) const
+{
+  auto const& segments = pattern.segments();
+
+  // Fast path for suffix-only patterns, which match at any depth:
+  if (pattern.isSuffixOnly() && states.size() == 1 && states[0] == 0) {
+    QString const& suffix = segments.back().text;
+    walkEntries([&](WalkPath const&, FileTreeEntry const& entry) {
+      if (types.testFlag(entry.fileType()) &&
+          entry.m_Name.str().endsWith(suffix, FileNameComparator::CaseSensitivity)) {
+        matches.push_back(const_cast<FileTreeEntry*>(&entry));
+      }
+    });
+    return;
+  }
+
+  closeStates(segments, states);
+
+  // Literal segments only, the entries can be looked up directly:
+  const bool literals = std::all_of(states.begin(), states.end(), [&](auto s) {
+    return s == segments.size() || segments[s].kind == FileGlob::SegmentKind::LITERAL;
+  });
+
+  if (literals) {
+    for (auto s : states) {
+      if (s == segments.size()) {
+        continue;
+      }
+
+      // Only directories can match if this is not the last segment:
+      const bool last = s + 1 == segments.size();
+      auto* entry =
+          findEntry(segments[s].text, last ? FILE_OR_DIRECTORY : FileTypes{DIRECTORY});
+      if (entry == nullptr) {
+        continue;
+      }
+
+      if (last) {
+        if (types.testFlag(entry->fileType())) {
+          matches.push_back(entry);
+        }
+      } else {
+        entry->m_Tree->collectMatches(pattern, types, {s + 1}, matches);
+      }
+    }
+    return;
+  }
+
+  std::vector<std::size_t> next;
+  for (auto& entry : entries()) {
+    next.clear();
+    bool matched = false;
+
+    for (auto s : states) {
+      if (s == segments.size()) {
+        continue;
+      }
+
+      auto const& segment = segments[s];
+      if (segment.kind == FileGlob::SegmentKind::RECURSIVE) {
+        // A trailing ** matches everything:
+        matched = matched || s + 1 == segments.size();
+        if (entry->isDir()) {
+          next.push_back(s);
+        }
+      } else if (FileGlob::matches(segment, entry->m_Name.str())) {
+        if (s + 1 == segments.size()) {
+          matched = true;
+        } else if (entry->isDir()) {
+          next.push_back(s + 1);
+        }
+      }
+    }
+
+    if (matched && types.testFlag(entry->fileType())) {
+      matches.push_back(entry.get());
+    }
+
+    if (!next.empty()) {
+      entry->m_Tree->collectMatches(pattern, types, next, matches);
+    }
+  }
+}
+
+void IFileTree::collectMatches(QRegularExpression const& regex, FileTypes types,
+                               QChar sep, std::vector<FileTreeEntry*>& matches) const
+{
+  QString buffer;
+  walkEntries(
+      [&](WalkPath const& path, FileTreeEntry const& entry) {
+        if (!types.testFlag(entry.fileType())) {
+          return;
+        }
+
+        // Reuse the buffer, resize() keeps its capacity:
+        buffer.resize(0);
+        buffer.append(path.str());
+        buffer.append(entry.m_Name.str());
+        if (regex.match(buffer).hasMatch()) {
+          matches.push_back(const_cast<FileTreeEntry*>(&entry));
+        }
+      },
+      sep);
+}
+
 /**
  *
  */
 std::shared_ptr<FileTreeEntry> IFileTree::addFile(QString path, bool replaceIfExists)
 {
-  QStringList parts = splitPath(path);
+  checkMutable();
+
+  auto [parentPath, name] = splitLast(path);
+  if (name.isEmpty()) {
+    return nullptr;
+  }
 
   // Check if the file already exists:
-  auto existingEntry = fetchEntry(parts, IFileTree::FILE_OR_DIRECTORY);
+  auto existingEntry = fetchEntry(path, IFileTree::FILE_OR_DIRECTORY);
   if (!replaceIfExists && existingEntry != nullptr) {
     return nullptr;
   }
 
   // Find or create the tree:
-  IFileTree* tree;
-
-  if (parts.size() > 1) {
-
-    // Create the tree:
-    std::shared_ptr<FileTreeEntry> treeEntry =
-        createTree(parts.begin(), parts.end() - 1);
-
-    // Early fail if the tree was not created:
-    if (treeEntry == nullptr) {
-      return nullptr;
-    }
+  std::shared_ptr<IFileTree> tree = createTree(parentPath);
 
-    tree = treeEntry->astree().get();
-  } else {
-    tree = this;
+  // Early fail if the tree was not created:
+  if (tree == nullptr) {
+    return nullptr;
   }
 
-  std::shared_ptr<FileTreeEntry> entry =
-      tree->makeFile(tree->astree(), parts[parts.size() - 1]);
+  std::shared_ptr<FileTreeEntry> entry = tree->makeFile(tree, name.toString());
 
   // If makeFile returns a null pointer, it means we cannot create file:
   if (entry == nullptr) {
@@ -225,17 +976,114 @@ std::shared_ptr<FileTreeEntry> IFileTree::addFile(QString path, bool replaceIfEx
   tree->entries().insert(
       std::upper_bound(tree->begin(), tree->end(), entry, FileEntryComparator{}),
       entry);
+  tree->indexInsert(entry.get());
+  tree->touch();
+  notifyChange(Change::Kind::INSERTED, *entry, tree.get());
 
   return entry;
 }
 
+/**
+ *
+ */
+std::size_t IFileTree::addFiles(QStringList const& paths, bool replaceIfExists)
+{
+  checkMutable();
+
+  // New files, grouped by directory, in order of appearance of the directories:
+  std::vector<std::pair<std::shared_ptr<IFileTree>,
+                        std::vector<std::shared_ptr<FileTreeEntry>>>>
+      files;
+  std::unordered_map<IFileTree const*, std::size_t> filesIndex;
+
+  // Check if the two given paths have the same components:
+  const auto samePath = [](QStringView a, QStringView b) {
+    qsizetype aPosition = 0, bPosition = 0;
+    while (true) {
+      const QStringView aPart = nextComponent(a, aPosition);
+      const QStringView bPart = nextComponent(b, bPosition);
+      if (aPart != bPart) {
+        return false;
+      }
+      if (aPart.isEmpty()) {
+        return true;
+      }
+    }
+  };
+
+  // Paths from the same directory are usually consecutive:
+  QStringView lastParent;
+  std::shared_ptr<IFileTree> lastTree = astree();
+
+  for (auto& path : paths) {
+    auto [parentPath, name] = splitLast(path);
+    if (name.isEmpty()) {
+      continue;
+    }
+
+    if (!samePath(parentPath, lastParent)) {
+      lastTree   = createTree(parentPath);
+      lastParent = parentPath;
+    }
+
+    // Early fail if the tree was not created:
+    if (lastTree == nullptr) {
+      continue;
+    }
+
+    auto entry = lastTree->makeFile(lastTree, name.toString());
+    if (entry == nullptr) {
+      continue;
+    }
+
+    auto [it, added] = filesIndex.emplace(lastTree.get(), files.size());
+    if (added) {
+      files.push_back({lastTree, {}});
+    }
+    files[it->second].second.push_back(std::move(entry));
+  }
+
+  std::size_t count = 0;
+  for (auto& [tree, entries] : files) {
+
+    // Remove duplicates, keeping the first or last occurence:
+    std::stable_sort(entries.begin(), entries.end(), FileEntryComparator::nameLess);
+    if (replaceIfExists) {
+      std::reverse(entries.begin(), entries.end());
+    }
+    entries.erase(std::unique(entries.begin(), entries.end(),
+                              [](auto const& a, auto const& b) {
+                                return FileEntryComparator::sameName(*a, *b);
+                              }),
+                  entries.end());
+
+    // Check for existing entries:
+    std::unordered_set<FileTreeEntry const*> removed;
+    std::erase_if(entries, [&](auto const& entry) {
+      auto* existing = tree->findEntry(entry->name(), FILE_OR_DIRECTORY);
+      if (existing == nullptr) {
+        return false;
+      }
+      if (!replaceIfExists || !tree->beforeRemove(tree.get(), existing)) {
+        return true;
+      }
+      removed.insert(existing);
+      return false;
+    });
+
+    count += entries.size();
+    tree->spliceEntries(std::move(entries), removed);
+  }
+
+  return count;
+}
+
 /**
  *
  */
 std::shared_ptr<IFileTree> IFileTree::addDirectory(QString path)
 {
-  QStringList parts = splitPath(path);
-  return createTree(parts.begin(), parts.end());
+  return createTree(path);
 }
 
 /**
@@ -244,6 +1092,18 @@ std::shared_ptr<IFileTree> IFileTree::addDirectory(QString path)
 IFileTree::iterator IFileTree::insert(std::shared_ptr<FileTreeEntry> entry,
                                       InsertPolicy insertPolicy)
 {
+  const QString name = entry->name();
+  return insertEntry(std::move(entry), insertPolicy, name);
+}
+
+IFileTree::iterator IFileTree::insertEntry(std::shared_ptr<FileTreeEntry> entry,
+                                           InsertPolicy insertPolicy,
+                                           QString const& previousName)
+{
+  checkMutable();
+  if (auto parent = entry->parent()) {
+    parent->checkMutable();
+  }
 
   // Check that this is not the current tree or a parent tree:
   if (entry->isDir()) {
@@ -257,8 +1117,12 @@ IFileTree::iterator IFileTree::insert(std::shared_ptr<FileTreeEntry> entry,
   }
 
   // Check if there exists an entry with the same name:
-  auto existingIt = std::find_if(
-      begin(), end(), MatchEntryComparator{entry->name(), FILE_OR_DIRECTORY});
+  auto existingIt = end();
+  if (auto* existing = findEntry(entry->name(), FILE_OR_DIRECTORY)) {
+    existingIt = std::find_if(begin(), end(), [existing](auto const& e) {
+      return e.get() == existing;
+    });
+  }
 
   // Already in the tree?
   if (existingIt != end() && *existingIt == entry) {
@@ -279,12 +1143,17 @@ IFileTree::iterator IFileTree::insert(std::shared_ptr<FileTreeEntry> entry,
       if (beforeReplace(this, existingIt->get(), entry.get())) {
         // Detach the old entry from its parent (not using .detach()
         // to remove the entry since we are replacing it):
-        (*existingIt)->m_Parent.reset();
+        const auto existing = *existingIt;
+        existing->m_Parent.reset();
+        indexErase(existing.get());
         entries().erase(existingIt);
+        notifyChange(Change::Kind::REMOVED, *existing, this);
 
         // insert at the right place
         insertionIt = entries().insert(
             std::lower_bound(begin(), end(), entry, FileEntryComparator{}), entry);
+        indexInsert(entry.get());
+        touch();
       } else {
         return end();
       }
@@ -295,29 +1164,214 @@ IFileTree::iterator IFileTree::insert(std::shared_ptr<FileTreeEntry> entry,
       // If we end up here, we know that the policy is MERGE and that both
       // are directory that can be merged:
       mergeTree((*existingIt)->astree(), entry->astree(), nullptr);
+      notifyChange(Change::Kind::MERGED, **existingIt, this,
+                   entry->parent().get(), &previousName);
       insertionIt = existingIt;
     }
   } else if (beforeInsert(this, entry.get())) {
     insertionIt = entries().insert(
         std::lower_bound(begin(), end(), entry, FileEntryComparator{}), entry);
+    indexInsert(entry.get());
+    touch();
+  } else {
+    return end();
   }
 
   // Remove the tree from its parent (parent() can be null if we are inserting
-  // a new tree):
-  if (entry->parent() != nullptr) {
-    entry->parent()->erase(entry);
+  // a new tree), the change is reported as a move below:
+  const auto previousParent = entry->parent();
+  if (previousParent != nullptr) {
+    previousParent->eraseEntry(entry, false);
   }
 
   // If the entry was actually inserted, we update its parent:
   if (*insertionIt == entry) {
     entry->m_Parent = astree();
+    if (previousParent != nullptr) {
+      notifyChange(Change::Kind::MOVED, *entry, this, previousParent.get(),
+                   &previousName);
+    } else {
+      notifyChange(Change::Kind::INSERTED, *entry, this);
+    }
   }
   // Otherwize, we reset it (if this was a merge operation):
   else {
     entry->m_Parent.reset();
   }
-
-  return insertionIt;
+
+  return insertionIt;
+}
+
+/**
+ *
+ */
+std::size_t IFileTree::insertMany(std::vector<std::shared_ptr<FileTreeEntry>> entries,
+                                  InsertPolicy insertPolicy)
+{
+  checkMutable();
+  for (auto const& entry : entries) {
+    if (auto parent = entry != nullptr ? entry->parent() : nullptr) {
+      parent->checkMutable();
+    }
+  }
+
+  const auto self = astree();
+
+  // Ignore entries that are already in this tree, and this tree or its parents:
+  std::erase_if(entries, [this, &self](auto const& entry) {
+    if (entry == nullptr) {
+      return true;
+    }
+    if (entry->parent() == self &&
+        findEntry(entry->name(), FILE_OR_DIRECTORY) == entry.get()) {
+      return true;
+    }
+    if (entry->isDir()) {
+      for (auto tmp = self; tmp != nullptr; tmp = tmp->parent()) {
+        if (tmp == entry->astree()) {
+          return true;
+        }
+      }
+    }
+    return false;
+  });
+
+  // Group the entries by name, keeping the order of entries with the same name:
+  std::stable_sort(entries.begin(), entries.end(), FileEntryComparator::nameLess);
+
+  std::vector<std::shared_ptr<FileTreeEntry>> added;
+  std::unordered_set<FileTreeEntry const*> removed;
+
+  // Entries that were inserted or merged, which must be removed from their parent:
+  std::vector<std::shared_ptr<FileTreeEntry>> processed;
+
+  for (auto first = entries.begin(); first != entries.end();) {
+    auto last = std::find_if(first, entries.end(), [&first](auto const& entry) {
+      return !FileEntryComparator::sameName(**first, *entry);
+    });
+
+    // The entry currently holding the name, applying the policy like insert() would
+    // if the entries were inserted one after the other:
+    std::shared_ptr<FileTreeEntry> current;
+    bool currentIsNew = false;
+    if (auto* existing = findEntry((*first)->name(), FILE_OR_DIRECTORY)) {
+      current = existing->shared_from_this();
+    }
+
+    for (auto it = first; it != last; ++it) {
+      auto& entry = *it;
+      if (current == nullptr) {
+        if (!beforeInsert(this, entry.get())) {
+          continue;
+        }
+      } else if (insertPolicy == InsertPolicy::FAIL_IF_EXISTS) {
+        continue;
+      } else if (insertPolicy == InsertPolicy::REPLACE ||
+                 (current->isFile() && entry->isFile())) {
+        if (!beforeReplace(this, current.get(), entry.get())) {
+          continue;
+        }
+        // The current entry is either an existing one, or one from the vector that
+        // is simply not added:
+        if (!currentIsNew) {
+          removed.insert(current.get());
+        }
+      } else if (current->isFile() || entry->isFile()) {
+        continue;
+      } else {
+        mergeTree(current->astree(), entry->astree(), nullptr);
+        const QString name = entry->name();
+        notifyChange(Change::Kind::MERGED, *current, this, entry->parent().get(),
+                     &name);
+        processed.push_back(entry);
+        continue;
+      }
+
+      current      = entry;
+      currentIsNew = true;
+      processed.push_back(entry);
+    }
+
+    if (currentIsNew) {
+      added.push_back(current);
+    }
+
+    first = last;
+  }
+
+  // Remove the entries from their parents, the ones added to this tree are then
+  // attached by spliceEntries():
+  std::unordered_map<FileTreeEntry const*, std::shared_ptr<const IFileTree>>
+      previousParents;
+  for (auto& entry : processed) {
+    if (auto parent = entry->parent(); parent != nullptr) {
+      if (parent != self) {
+        parent->eraseEntry(entry, false);
+      }
+      previousParents.emplace(entry.get(), std::move(parent));
+    }
+    entry->m_Parent.reset();
+  }
+
+  spliceEntries(std::move(added), removed, previousParents);
+
+  return processed.size();
+}
+
+void IFileTree::spliceEntries(
+    std::vector<std::shared_ptr<FileTreeEntry>> added,
+    std::unordered_set<FileTreeEntry const*> const& removed,
+    std::unordered_map<FileTreeEntry const*, std::shared_ptr<const IFileTree>> const&
+        previousParents)
+{
+  if (added.empty() && removed.empty()) {
+    return;
+  }
+
+  auto& current = entries();
+  std::vector<std::shared_ptr<FileTreeEntry>> removedEntries;
+  if (!removed.empty()) {
+    std::erase_if(current, [&removed, &removedEntries](auto const& entry) {
+      if (removed.contains(entry.get())) {
+        entry->m_Parent.reset();
+        removedEntries.push_back(entry);
+        return true;
+      }
+      return false;
+    });
+  }
+
+  const auto self = astree();
+  for (auto& entry : added) {
+    entry->m_Parent = self;
+  }
+
+  std::sort(added.begin(), added.end(), FileEntryComparator{});
+
+  // The added entries are copied, not moved, since they are notified below:
+  std::vector<std::shared_ptr<FileTreeEntry>> merged;
+  merged.reserve(current.size() + added.size());
+  std::merge(std::make_move_iterator(current.begin()),
+             std::make_move_iterator(current.end()), added.begin(), added.end(),
+             std::back_inserter(merged), FileEntryComparator{});
+  current.swap(merged);
+
+  indexReset();
+  updateSuffixIndexes(removedEntries, false);
+  updateSuffixIndexes(added, true);
+  touch();
+
+  for (auto& entry : removedEntries) {
+    notifyChange(Change::Kind::REMOVED, *entry, this);
+  }
+  for (auto& entry : added) {
+    auto it = previousParents.find(entry.get());
+    if (it != previousParents.end()) {
+      notifyChange(Change::Kind::MOVED, *entry, this, it->second.get());
+    } else {
+      notifyChange(Change::Kind::INSERTED, *entry, this);
+    }
+  }
 }
 
 /**
@@ -326,6 +1380,10 @@ IFileTree::iterator IFileTree::insert(std::shared_ptr<FileTreeEntry> entry,
 bool IFileTree::move(std::shared_ptr<FileTreeEntry> entry, QString path,
                      InsertPolicy insertPolicy)
 {
+  checkMutable();
+  if (auto parent = entry->parent()) {
+    parent->checkMutable();
+  }
 
   // Check that this is not a parent tree:
   if (entry->isDir()) {
@@ -341,38 +1399,29 @@ bool IFileTree::move(std::shared_ptr<FileTreeEntry> entry, QString path,
   // Insert in folder or replace:
   const bool insertFolder = path.isEmpty() || path.endsWith("/") || path.endsWith("\\");
 
-  // Retrieve the path:
-  QStringList parts = splitPath(path);
-
   // Backup the entry name (in case the insertion fails), and update the
   // name:
-  QString entryName = entry->m_Name;
+  QString entryName   = entry->name();
+  QStringView treePath = path;
   if (!insertFolder) {
-    entry->m_Name = parts.takeLast();
+    auto [parentPath, name] = splitLast(path);
+    renameEntry(entry.get(), name.toString());
+    treePath = parentPath;
   }
 
   // Find or create the tree:
-  IFileTree* tree;
-
-  if (!parts.isEmpty()) {
-
-    // Create the tree:
-    std::shared_ptr<FileTreeEntry> treeEntry = createTree(parts.begin(), parts.end());
-
-    // Early fail if the tree was not created:
-    if (treeEntry == nullptr) {
-      return false;
-    }
+  std::shared_ptr<IFileTree> tree = createTree(treePath);
 
-    tree = treeEntry->astree().get();
-  } else {
-    tree = this;
+  // Early fail if the tree was not created:
+  if (tree == nullptr) {
+    renameEntry(entry.get(), entryName);
+    return false;
   }
 
   // We try to insert, and if it fails we need to reset the name:
-  auto it = tree->insert(entry, insertPolicy);
+  auto it = tree->insertEntry(entry, insertPolicy, entryName);
   if (it == tree->end()) {
-    entry->m_Name = entryName;
+    renameEntry(entry.get(), entryName);
     return false;
   }
 
@@ -403,6 +1452,8 @@ IFileTree::copy(std::shared_ptr<const FileTreeEntry> entry, QString path,
 std::size_t IFileTree::merge(std::shared_ptr<IFileTree> source,
                              OverwritesType* overwrites)
 {
+  checkMutable();
+  source->checkMutable();
 
   // Check that this is not a parent tree:
   std::shared_ptr<IFileTree> tmp = astree();
@@ -421,7 +1472,13 @@ std::size_t IFileTree::merge(std::shared_ptr<IFileTree> source,
  */
 IFileTree::iterator IFileTree::erase(std::shared_ptr<FileTreeEntry> entry)
 {
+  return eraseEntry(entry, true);
+}
 
+IFileTree::iterator IFileTree::eraseEntry(std::shared_ptr<FileTreeEntry> const& entry,
+                                          bool notify)
+{
+  checkMutable();
   if (!beforeRemove(this, entry.get())) {
     return end();
   }
@@ -431,8 +1488,13 @@ IFileTree::iterator IFileTree::erase(std::shared_ptr<FileTreeEntry> entry)
     return it;
   }
   entry->m_Parent.reset();
-  return entries().erase(it);
-  ;
+  indexErase(entry.get());
+  auto next = entries().erase(it);
+  touch();
+  if (notify) {
+    notifyChange(Change::Kind::REMOVED, *entry, this);
+  }
+  return next;
 }
 
 /**
@@ -441,14 +1503,16 @@ IFileTree::iterator IFileTree::erase(std::shared_ptr<FileTreeEntry> entry)
 std::pair<IFileTree::iterator, std::shared_ptr<FileTreeEntry>>
 IFileTree::erase(QString name)
 {
-  auto it = std::find_if(begin(), end(), [&name](const auto& entry) {
-    return entry->compare(name) == 0;
-  });
-
-  if (it == end()) {
-    return {it, nullptr};
+  checkMutable();
+  auto* found = findEntry(name, FILE_OR_DIRECTORY);
+  if (found == nullptr) {
+    return {end(), nullptr};
   }
 
+  auto it = std::find_if(begin(), end(), [found](const auto& entry) {
+    return entry.get() == found;
+  });
+
   if (!beforeRemove(this, it->get())) {
     return {end(), nullptr};
   }
@@ -456,8 +1520,12 @@ IFileTree::erase(QString name)
   // Save the entry to return it:
   auto entry = *it;
   entry->m_Parent.reset();
+  indexErase(entry.get());
 
-  return {entries().erase(it), entry};
+  auto next = entries().erase(it);
+  touch();
+  notifyChange(Change::Kind::REMOVED, *entry, this);
+  return {next, entry};
 }
 
 /**
@@ -465,6 +1533,8 @@ IFileTree::erase(QString name)
  */
 bool IFileTree::clear()
 {
+  checkMutable();
+
   // Need to find the iterator up to which we should erase:
   auto& entries_ = entries();
   auto it        = entries_.begin();
@@ -472,7 +1542,17 @@ bool IFileTree::clear()
     // Detach (but not remove from the vector):
     (*it)->m_Parent.reset();
   }
-  entries_.erase(entries_.begin(), it);
+  if (it != entries_.begin()) {
+    std::vector<std::shared_ptr<FileTreeEntry>> removed(
+        std::make_move_iterator(entries_.begin()), std::make_move_iterator(it));
+    entries_.erase(entries_.begin(), it);
+    indexReset();
+    updateSuffixIndexes(removed, false);
+    touch();
+    for (auto& entry : removed) {
+      notifyChange(Change::Kind::REMOVED, *entry, this);
+    }
+  }
   return empty();
 }
 
@@ -492,14 +1572,29 @@ std::size_t IFileTree::removeAll(QStringList names)
 std::size_t IFileTree::removeIf(
     std::function<bool(std::shared_ptr<FileTreeEntry> const&)> predicate)
 {
+  checkMutable();
+
   std::size_t osize = size();
   auto& en          = entries();
+  std::vector<std::shared_ptr<FileTreeEntry>> removed;
   // Cannot use begin() and end() directly because those are immutable iterators:
   en.erase(std::remove_if(en.begin(), en.end(),
-                          [this, &predicate](auto& entry) {
-                            return beforeRemove(this, entry.get()) && predicate(entry);
+                          [this, &predicate, &removed](auto& entry) {
+                            if (beforeRemove(this, entry.get()) && predicate(entry)) {
+                              removed.push_back(entry);
+                              return true;
+                            }
+                            return false;
                           }),
            en.end());
+  if (size() != osize) {
+    indexReset();
+    updateSuffixIndexes(removed, false);
+    touch();
+  }
+  for (auto& entry : removed) {
+    notifyChange(Change::Kind::REMOVED, *entry, this);
+  }
   return osize - size();
 }
 
@@ -514,6 +1609,39 @@ QStringList IFileTree::splitPath(QString path)
   return path.replace("\\", "/").split("/", Qt::SkipEmptyParts);
 }
 
+QStringView IFileTree::nextComponent(QStringView path, qsizetype& position)
+{
+  const auto isSeparator = [](QChar c) {
+    return c == u'/' || c == u'\\';
+  };
+
+  while (position < path.size() && isSeparator(path[position])) {
+    ++position;
+  }
+  const qsizetype start = position;
+  while (position < path.size() && !isSeparator(path[position])) {
+    ++position;
+  }
+  return path.sliced(start, position - start);
+}
+
+std::pair<QStringView, QStringView> IFileTree::splitLast(QStringView path)
+{
+  const auto isSeparator = [](QChar c) {
+    return c == u'/' || c == u'\\';
+  };
+
+  qsizetype end = path.size();
+  while (end > 0 && isSeparator(path[end - 1])) {
+    --end;
+  }
+  qsizetype start = end;
+  while (start > 0 && !isSeparator(path[start - 1])) {
+    --start;
+  }
+  return {path.first(start), path.sliced(start, end - start)};
+}
+
 /**
  *
  */
@@ -565,12 +1693,16 @@ std::size_t IFileTree::mergeTree(std::shared_ptr<IFileTree> destination,
     auto dstIt = std::lower_bound(dstEntries.begin(), dstEntries.end(), srcEntry, comp);
 
     // Exact match found:
-    if (dstIt != dstEntries.end() && (*dstIt)->compare(srcEntry->name()) == 0 &&
+    if (dstIt != dstEntries.end() &&
+        FileEntryComparator::sameName(**dstIt, *srcEntry) &&
         (*dstIt)->isFile() == srcEntry->isFile()) {
 
       // Both directory, we merge:
       if ((*dstIt)->isDir() && srcEntry->isDir()) {
         noverwrites += mergeTree((*dstIt)->astree(), srcEntry->astree(), overwrites);
+        const QString srcName = srcEntry->name();
+        notifyChange(Change::Kind::MERGED, **dstIt, destination.get(), source.get(),
+                     &srcName);
 
         // Detach the entry:
         srcEntry->m_Parent.reset();
@@ -588,8 +1720,12 @@ std::size_t IFileTree::mergeTree(std::shared_ptr<IFileTree> destination,
         }
 
         // Replace the destination:
+        destination->indexErase(dstEntry.get());
         *dstIt             = srcEntry;
         srcEntry->m_Parent = destination;
+        destination->indexInsert(srcEntry.get());
+        notifyChange(Change::Kind::REMOVED, *dstEntry, destination.get());
+        notifyChange(Change::Kind::MOVED, *srcEntry, destination.get(), source.get());
       }
       // If not, fails:
       else {
@@ -598,14 +1734,19 @@ std::size_t IFileTree::mergeTree(std::shared_ptr<IFileTree> destination,
     } else {
       // If we did not find a match, the only way to check is to look
       // through the vector:
-      auto conflictIt = std::find_if(dstEntries.begin(), dstEntries.end(),
-                                     [name = srcEntry->name()](auto const& dstEntry) {
-                                       return dstEntry->compare(name) == 0;
-                                     });
+      auto conflictIt = dstEntries.end();
+      if (auto* conflict =
+              destination->findEntry(srcEntry->name(), FILE_OR_DIRECTORY)) {
+        conflictIt = std::find_if(dstEntries.begin(), dstEntries.end(),
+                                  [conflict](auto const& dstEntry) {
+                                    return dstEntry.get() == conflict;
+                                  });
+      }
 
       // Conflict (note that here both entries are of different types, so no need to
       // check if we replace or merge):
       int deleteIndex = -1;
+      std::shared_ptr<FileTreeEntry> conflictEntry;
       if (conflictIt != dstEntries.end()) {
 
         // We check if we can replace the entry:
@@ -621,7 +1762,9 @@ std::size_t IFileTree::mergeTree(std::shared_ptr<IFileTree> destination,
         }
 
         // Detach the conflicting entry (we erase it later, after the insertion):
+        conflictEntry = *conflictIt;
         (*conflictIt)->m_Parent.reset();
+        destination->indexErase(conflictIt->get());
 
         // Update overwrites information:
         noverwrites++;
@@ -636,6 +1779,7 @@ std::size_t IFileTree::mergeTree(std::shared_ptr<IFileTree> destination,
 
       // Insert the entry using the previous iterator:
       dstEntries.insert(dstIt, srcEntry);
+      destination->indexInsert(srcEntry.get());
 
       // We delete here:
       if (deleteIndex != -1) {
@@ -644,15 +1788,252 @@ std::size_t IFileTree::mergeTree(std::shared_ptr<IFileTree> destination,
 
       // Update the parent:
       srcEntry->m_Parent = destination;
+
+      if (conflictEntry != nullptr) {
+        notifyChange(Change::Kind::REMOVED, *conflictEntry, destination.get());
+      }
+      notifyChange(Change::Kind::MOVED, *srcEntry, destination.get(), source.get());
     }
   }
 
-  // Clear the sources:
+  // Clear the sources, the merged directories are empty at this point:
+  source->updateSuffixIndexes(srcEntries, false);
   srcEntries.clear();
+  source->indexReset();
+
+  destination->touch();
+  source->touch();
 
   return noverwrites;
 }
 
+struct IFileTree::MergePlan
+{
+  // Entry of the source, and the entry of the destination with the same name, if
+  // any. If both are directories, they are merged with the given plan, otherwise the
+  // source entry replaces the destination entry:
+  struct Action
+  {
+    std::shared_ptr<FileTreeEntry> source;
+    std::shared_ptr<FileTreeEntry> destination;
+    std::unique_ptr<MergePlan> merge;
+  };
+
+  std::shared_ptr<IFileTree> destination;
+  std::shared_ptr<IFileTree> source;
+
+  // Actions in the order of the entries of the source:
+  std::vector<Action> actions;
+};
+
+std::size_t IFileTree::mergeParallel(std::shared_ptr<IFileTree> source,
+                                     OverwritesType* overwrites, int maxThreads)
+{
+  checkMutable();
+  source->checkMutable();
+
+  // Check that this is not a parent tree:
+  std::shared_ptr<IFileTree> tmp = astree();
+  while (tmp != nullptr) {
+    if (tmp == source) {
+      return MERGE_FAILED;
+    }
+    tmp = tmp->parent();
+  }
+
+  MergePlan root{astree(), source, {}};
+
+  // Directories of the two trees are only read while planning, so all the
+  // subdirectories can be planned concurrently:
+  {
+    TaskGroup tasks(maxThreads);
+    std::function<void(MergePlan*)> plan = [&](MergePlan* current) {
+      planMerge(*current);
+      for (auto& action : current->actions) {
+        if (action.merge != nullptr) {
+          tasks.start([&plan, next = action.merge.get()] {
+            plan(next);
+          });
+        }
+      }
+    };
+    tasks.start([&plan, &root] {
+      plan(&root);
+    });
+    tasks.wait();
+  }
+
+  // When the source is under this tree, a plan can merge into or replace the source
+  // or one of its parents, e.g., when merging "Data" into a tree that has
+  // "Data/Data", so the plans would modify the same trees concurrently:
+  std::unordered_set<FileTreeEntry const*> sourcePath;
+  bool sourceUnderThis = false;
+  for (auto tree = source; tree != nullptr && !sourceUnderThis; tree = tree->parent()) {
+    sourceUnderThis = tree.get() == this;
+    sourcePath.insert(tree.get());
+  }
+
+  if (sourceUnderThis) {
+    std::function<bool(MergePlan const&)> overlaps = [&](MergePlan const& plan) {
+      return std::any_of(plan.actions.begin(), plan.actions.end(),
+                         [&](MergePlan::Action const& action) {
+                           return sourcePath.contains(action.destination.get()) ||
+                                  (action.merge != nullptr && overlaps(*action.merge));
+                         });
+    };
+    if (overlaps(root)) {
+      return MERGE_FAILED;
+    }
+  }
+
+  // Callbacks are called on this thread, in a deterministic order:
+  std::vector<OverwritesType::value_type> replaced;
+  if (!checkMerge(root, replaced)) {
+    return MERGE_FAILED;
+  }
+
+  // Each plan only modifies its own destination and source, so plans can be applied
+  // concurrently:
+  {
+    TaskGroup tasks(maxThreads);
+    std::function<void(MergePlan const*)> apply = [&](MergePlan const* current) {
+      for (auto& action : current->actions) {
+        if (action.merge != nullptr) {
+          tasks.start([&apply, next = action.merge.get()] {
+            apply(next);
+          });
+        }
+      }
+      applyMerge(*current);
+    };
+    tasks.start([&apply, &root] {
+      apply(&root);
+    });
+    tasks.wait();
+  }
+
+  notifyMerge(root);
+
+  if (overwrites != nullptr) {
+    overwrites->insert(replaced.begin(), replaced.end());
+  }
+  return replaced.size();
+}
+
+void IFileTree::planMerge(MergePlan& plan)
+{
+  auto const& sources = std::as_const(*plan.source).entries();
+  plan.actions.reserve(sources.size());
+  for (auto const& srcEntry : sources) {
+    MergePlan::Action action{srcEntry, nullptr, nullptr};
+    if (auto* dstEntry =
+            plan.destination->findEntry(srcEntry->name(), FILE_OR_DIRECTORY)) {
+      action.destination = dstEntry->shared_from_this();
+      if (dstEntry->isDir() && srcEntry->isDir()) {
+        action.merge = std::make_unique<MergePlan>(
+            MergePlan{dstEntry->astree(), srcEntry->astree(), {}});
+      }
+    }
+    plan.actions.push_back(std::move(action));
+  }
+}
+
+bool IFileTree::checkMerge(MergePlan const& plan,
+                           std::vector<OverwritesType::value_type>& overwrites)
+{
+  // Lazy clones must copy their entries before the trees are modified, which cannot
+  // be done concurrently:
+  plan.destination->detachClones();
+  plan.source->detachClones();
+
+  for (auto const& action : plan.actions) {
+    if (action.merge != nullptr) {
+      if (!checkMerge(*action.merge, overwrites)) {
+        return false;
+      }
+    } else if (action.destination != nullptr) {
+      if (!beforeReplace(plan.destination.get(), action.destination.get(),
+                         action.source.get())) {
+        return false;
+      }
+      overwrites.emplace_back(action.destination, action.source);
+    } else if (!beforeInsert(plan.destination.get(), action.source.get())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void IFileTree::applyMerge(MergePlan const& plan)
+{
+  std::unordered_set<FileTreeEntry const*> replaced;
+  std::vector<FileTreeEntry const*> replacedEntries;
+  std::vector<std::shared_ptr<FileTreeEntry>> added;
+  for (auto const& action : plan.actions) {
+    if (action.merge != nullptr) {
+      continue;
+    }
+    if (action.destination != nullptr) {
+      action.destination->m_Parent.reset();
+      replaced.insert(action.destination.get());
+      replacedEntries.push_back(action.destination.get());
+    }
+    action.source->m_Parent = plan.destination;
+    added.push_back(action.source);
+  }
+
+  // The added entries are sorted since the entries of the source are:
+  if (!added.empty()) {
+    plan.destination->updateSuffixIndexes(replacedEntries, false);
+    plan.destination->updateSuffixIndexes(added, true);
+    plan.source->updateSuffixIndexes(added, false);
+
+    auto& current = plan.destination->entries();
+    if (!replaced.empty()) {
+      std::erase_if(current, [&replaced](auto const& entry) {
+        return replaced.contains(entry.get());
+      });
+    }
+
+    std::vector<std::shared_ptr<FileTreeEntry>> merged;
+    merged.reserve(current.size() + added.size());
+    std::merge(std::make_move_iterator(current.begin()),
+               std::make_move_iterator(current.end()),
+               std::make_move_iterator(added.begin()),
+               std::make_move_iterator(added.end()), std::back_inserter(merged),
+               FileEntryComparator{});
+    current.swap(merged);
+    plan.destination->indexReset();
+    plan.destination->touch();
+  }
+
+  // The merged subdirectories of the source are detached by notifyMerge(), so that
+  // notifications can still compute their paths:
+  plan.source->entries().clear();
+  plan.source->indexReset();
+  plan.source->touch();
+}
+
+void IFileTree::notifyMerge(MergePlan const& plan)
+{
+  for (auto const& action : plan.actions) {
+    if (action.merge != nullptr) {
+      notifyMerge(*action.merge);
+      const QString srcName = action.source->name();
+      notifyChange(Change::Kind::MERGED, *action.destination, plan.destination.get(),
+                   plan.source.get(), &srcName);
+      action.source->m_Parent.reset();
+    } else {
+      if (action.destination != nullptr) {
+        notifyChange(Change::Kind::REMOVED, *action.destination,
+                     plan.destination.get());
+      }
+      notifyChange(Change::Kind::MOVED, *action.source, plan.destination.get(),
+                   plan.source.get());
+    }
+  }
+}
+
 /**
  *
  */
@@ -668,53 +2049,45 @@ std::shared_ptr<IFileTree> IFileTree::createOrphanTree(QString name) const
 /**
  *
  */
-std::shared_ptr<FileTreeEntry> IFileTree::fetchEntry(QStringList path,
+std::shared_ptr<FileTreeEntry> IFileTree::fetchEntry(QStringView path,
                                                      FileTypes matchTypes)
 {
   return std::const_pointer_cast<FileTreeEntry>(
       const_cast<const IFileTree*>(this)->fetchEntry(path, matchTypes));
 }
-std::shared_ptr<const FileTreeEntry> IFileTree::fetchEntry(QStringList const& path,
+std::shared_ptr<const FileTreeEntry> IFileTree::fetchEntry(QStringView path,
                                                            FileTypes matchTypes) const
 {
+  auto [parentPath, name] = splitLast(path);
+
   // Check to ensure that the path contains at least one element:
-  if (path.isEmpty()) {
+  if (name.isEmpty()) {
     return nullptr;
   }
 
   // Early check:
-  if (path[path.size() - 1].startsWith("*")) {
+  if (name.startsWith(u'*')) {
     return nullptr;
   }
 
   const IFileTree* tree = this;
-  auto it               = std::begin(path);
-  for (; tree != nullptr && it != std::end(path) - 1; ++it) {
+  qsizetype position    = 0;
+  for (QStringView part = nextComponent(parentPath, position);
+       tree != nullptr && !part.isEmpty(); part = nextComponent(parentPath, position)) {
     // Special cases:
-    if (*it == ".") {
+    if (part == u".") {
       continue;
-    } else if (*it == "..") {
+    } else if (part == u"..") {
       tree = tree->parent().get();
     } else {
       // Find the entry at the current level:
-#ifdef __MSVC__
-      auto entryIt = std::find_if(tree->begin(), tree->end(),
-                                  MatchEntryComparator{*it, IFileTree::DIRECTORY});
-#else
-      auto entryIt = tree->end();
-
-      for(auto entry= tree->begin();entry != tree->end(); it++){
-        if((entry->fileType() == IFileTree::DIRECTORY) && entry->compare(*it) == 0){
-          entryIt = entry;
-          break;
-        }
-      }
-#endif
+      auto* entry = tree->findEntry(part, IFileTree::DIRECTORY);
+
       // Early exists if the entry does not exist or is not a directory:
-      if (entryIt == tree->end()) {
+      if (entry == nullptr) {
         tree = nullptr;
       } else {
-        tree = (*entryIt)->astree().get();
+        tree = entry->astree().get();
       }
     }
   }
@@ -724,20 +2097,8 @@ std::shared_ptr<const FileTreeEntry> IFileTree::fetchEntry(QStringList const& pa
   }
 
   // We have the final tree:
-#ifdef __MSVC__
-  auto entryIt =
-      std::find_if(tree->begin(), tree->end(), MatchEntryComparator{*it, matchTypes});
-#else
-  auto entryIt = tree->end();
-  for(auto entry= tree->begin();entry != tree->end(); it++){
-    if((entry->fileType() == matchTypes) && entry->compare(*it) == 0){
-      entryIt = entry;
-      break;
-    }
-  }
-#endif
-  auto bIt = tree->end();
-  return entryIt == bIt ? nullptr : *entryIt;
+  auto* entry = tree->findEntry(name, matchTypes);
+  return entry == nullptr ? nullptr : entry->shared_from_this();
 }
 
 /**
@@ -758,7 +2119,26 @@ IFileTree::makeFile(std::shared_ptr<const IFileTree> parent, QString name) const
 /**
  *
  */
-IFileTree::IFileTree() {}
+IFileTree::IFileTree()
+{
+  m_Tree = this;
+}
+
+IFileTree::~IFileTree()
+{
+  std::unique_ptr<Extras> extras(m_Extras.load(std::memory_order_acquire));
+  if (extras == nullptr) {
+    return;
+  }
+
+  if (extras->cloneSource != nullptr) {
+    g_PendingClones.fetch_sub(1, std::memory_order_relaxed);
+  }
+  g_Subscriptions.fetch_sub(extras->subscribers.size(), std::memory_order_relaxed);
+  if (extras->suffixIndex != nullptr && !extras->frozenSuffixIndex) {
+    g_SuffixIndexes.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
 
 /**
  *
@@ -767,33 +2147,89 @@ std::shared_ptr<FileTreeEntry> IFileTree::clone() const
 {
   std::shared_ptr<IFileTree> tree = doClone();
 
-  // Don't copy not populated tree, it is not useful:
-  if (m_Populated) {
-    tree->m_Populated = true;
-    auto& tentries    = tree->m_Entries;
-    for (auto e : entries()) {
-      auto ce      = e->clone();
-      ce->m_Parent = tree;
-      tentries.push_back(ce);
-    }
+  // Lazy clones always have extras, so a tree without them that is not populated
+  // has nothing to copy:
+  if (!m_Populated && m_Extras.load(std::memory_order_acquire) == nullptr) {
+    return tree;
+  }
+
+  Extras& extras = this->extras();
+  std::scoped_lock lock(extras.mutex);
+
+  // Don't copy not populated tree, it is not useful, unless this tree is itself a
+  // lazy clone, in which case its entries come from its source:
+  if (m_Populated || extras.cloneSource != nullptr) {
+    tree->extras().cloneSource = astree();
+    g_PendingClones.fetch_add(1, std::memory_order_relaxed);
+
+    std::erase_if(extras.pendingClones, [](auto const& weakClone) {
+      auto clone = weakClone.lock();
+      return clone == nullptr || clone->m_Populated;
+    });
+    extras.pendingClones.push_back(tree);
   }
 
   return tree;
 }
 
+void IFileTree::detachClones()
+{
+  if (g_PendingClones.load(std::memory_order_acquire) == 0) {
+    return;
+  }
+
+  // The lazy clones of the parents of this tree reach this tree through their own
+  // lazy subtrees, which only exist once they have copied their entries, so clones
+  // are copied from the top:
+  std::vector<std::shared_ptr<const IFileTree>> trees;
+  for (std::shared_ptr<const IFileTree> tree = astree(); tree != nullptr;
+       tree = tree->parent()) {
+    trees.push_back(tree);
+  }
+
+  for (auto it = trees.rbegin(); it != trees.rend(); ++it) {
+    (*it)->copyToClones();
+  }
+}
+
+void IFileTree::copyToClones() const
+{
+  Extras* extras = m_Extras.load(std::memory_order_acquire);
+  if (extras == nullptr) {
+    return;
+  }
+
+  std::vector<std::weak_ptr<const IFileTree>> clones;
+  {
+    std::scoped_lock lock(extras->mutex);
+    clones.swap(extras->pendingClones);
+  }
+
+  for (auto& weakClone : clones) {
+    if (auto clone = weakClone.lock()) {
+      // Populating the clone copies the entries of this tree:
+      clone->entries();
+    }
+  }
+}
+
 /**
  *
  */
-std::shared_ptr<IFileTree> IFileTree::createTree(QStringList::const_iterator begin,
-                                                 QStringList::const_iterator end)
+std::shared_ptr<IFileTree> IFileTree::createTree(QStringView path)
 {
-  // The current tree and entry:
+  checkMutable();
+
+  // The current tree and entry, and the last tree where a directory was created:
   std::shared_ptr<IFileTree> tree = astree();
-  for (auto it = begin; tree != nullptr && it != end; ++it) {
+  std::shared_ptr<IFileTree> modified;
+  qsizetype position = 0;
+  for (QStringView part = nextComponent(path, position);
+       tree != nullptr && !part.isEmpty(); part = nextComponent(path, position)) {
     // Special cases:
-    if (*it == ".") {
+    if (part == u".") {
       continue;
-    } else if (*it == "..") {
+    } else if (part == u"..") {
       // parent() returns nullptr if it does not exist, so no
       // check required:
       tree = parent();
@@ -801,13 +2237,11 @@ std::shared_ptr<IFileTree> IFileTree::createTree(QStringList::const_iterator beg
 
       // Check if the entry exists (looking for both files and directories
       // because we don't want to override a file):
-      auto entryIt =
-          std::find_if(tree->begin(), tree->end(),
-                       MatchEntryComparator{*it, IFileTree::FILE_OR_DIRECTORY});
+      auto* entry = tree->findEntry(part, IFileTree::FILE_OR_DIRECTORY);
 
       // Create if it does not:
-      if (entryIt == tree->end()) {
-        auto newTree = tree->makeDirectory(tree, *it);
+      if (entry == nullptr) {
+        auto newTree = tree->makeDirectory(tree, part.toString());
 
         // If makeDirectory returns a null pointer, it means we cannot create tree.
         if (newTree == nullptr) {
@@ -821,18 +2255,148 @@ std::shared_ptr<IFileTree> IFileTree::createTree(QStringList::const_iterator beg
         tree->entries().insert(std::upper_bound(tree->begin(), tree->end(), newTree,
                                                 FileEntryComparator{}),
                                newTree);
-        tree = newTree;
-      } else if ((*entryIt)->isDir()) {
-        tree = (*entryIt)->astree();
+        tree->indexInsert(newTree.get());
+        notifyChange(Change::Kind::INSERTED, *newTree, tree.get());
+        modified = tree;
+        tree     = newTree;
+      } else if (entry->isDir()) {
+        tree = entry->astree();
       } else {  // Cannot go further:
         tree = nullptr;
       }
     }
   }
 
+  // The created directories are nested, so this covers all of them:
+  if (modified != nullptr) {
+    modified->touch();
+  }
+
   return tree;
 }
 
+/**
+ *
+ */
+FileTreeEntry* IFileTree::findEntry(QStringView name, FileTypes matchTypes) const
+{
+  const auto& entries_ = entries();
+  const auto matches   = MatchEntryComparator{name, matchTypes};
+
+  // Small directories are faster to scan than to index:
+  if (entries_.size() < INDEX_MIN_SIZE) {
+    for (auto& entry : entries_) {
+      if (matches(entry.get())) {
+        return entry.get();
+      }
+    }
+    return nullptr;
+  }
+
+  const auto lookup = [&matches](EntryIndex const& index) -> FileTreeEntry* {
+    auto [it, end] = index.equal_range(matches.hash());
+    for (; it != end; ++it) {
+      if (matches(it->second)) {
+        return it->second;
+      }
+    }
+    return nullptr;
+  };
+
+  // The index of a frozen tree is built by freeze() and never modified, so it can be
+  // read without locking:
+  if (m_Frozen.load(std::memory_order_acquire)) {
+    return lookup(*m_Index);
+  }
+
+  std::scoped_lock lock(m_IndexMutex);
+  buildIndex();
+  return lookup(*m_Index);
+}
+
+void IFileTree::buildIndex() const
+{
+  if (m_Index) {
+    return;
+  }
+
+  auto const& entries_ = entries();
+  m_Index              = std::make_unique<EntryIndex>();
+  m_Index->reserve(entries_.size());
+  for (auto& entry : entries_) {
+    m_Index->emplace(entry->m_Name.hash(), entry.get());
+  }
+}
+
+/**
+ *
+ */
+void IFileTree::indexInsert(FileTreeEntry* entry)
+{
+  {
+    std::scoped_lock lock(m_IndexMutex);
+    if (m_Index) {
+      m_Index->emplace(entry->m_Name.hash(), entry);
+    }
+  }
+
+  FileTreeEntry const* const entries[] = {entry};
+  updateSuffixIndexes(entries, true);
+}
+
+/**
+ *
+ */
+void IFileTree::indexErase(FileTreeEntry const* entry)
+{
+  FileTreeEntry const* const entries[] = {entry};
+  updateSuffixIndexes(entries, false);
+
+  std::scoped_lock lock(m_IndexMutex);
+  if (!m_Index) {
+    return;
+  }
+
+  auto [it, end] = m_Index->equal_range(entry->m_Name.hash());
+  for (; it != end; ++it) {
+    if (it->second == entry) {
+      m_Index->erase(it);
+      return;
+    }
+  }
+
+  // The entry is not indexed under its current name, so the index cannot be
+  // trusted anymore:
+  m_Index.reset();
+}
+
+/**
+ *
+ */
+void IFileTree::indexReset()
+{
+  std::scoped_lock lock(m_IndexMutex);
+  m_Index.reset();
+}
+
+/**
+ *
+ */
+void IFileTree::renameEntry(FileTreeEntry* entry, QString name)
+{
+  auto parent = entry->parent();
+  if (parent != nullptr) {
+    parent->checkMutable();
+    parent->detachClones();
+    parent->touch();
+    parent->indexErase(entry);
+  }
+  entry->setName(std::move(name));
+  if (parent != nullptr) {
+    parent->indexInsert(entry);
+  }
+}
+
 /**
  * @brief Retrieve the vector of entries after populating it if required.
  *
@@ -840,9 +2404,15 @@ std::shared_ptr<IFileTree> IFileTree::createTree(QStringList::const_iterator beg
  */
 std::vector<std::shared_ptr<FileTreeEntry>>& IFileTree::entries()
 {
+  checkMutable();
+
   std::call_once(m_OnceFlag, [this]() {
     populate();
   });
+
+  // The entries are only accessed non-const to be modified:
+  detachClones();
+
   return m_Entries;
 }
 const std::vector<std::shared_ptr<FileTreeEntry>>& IFileTree::entries() const
@@ -853,6 +2423,81 @@ const std::vector<std::shared_ptr<FileTreeEntry>>& IFileTree::entries() const
   return m_Entries;
 }
 
+void IFileTree::prefetch(int depth, int maxThreads) const
+{
+  TaskGroup tasks(maxThreads);
+
+  // Each task populates a tree and starts one task per subtree. Entries are
+  // populated through entries(), i.e., under the once flag of each tree, so
+  // concurrent accesses from other threads are synchronized:
+  std::function<void(IFileTree const*, int)> task = [&](IFileTree const* tree,
+                                                        int depth) {
+    auto const& children = tree->entries();
+    if (depth == 0) {
+      return;
+    }
+    for (auto& child : children) {
+      if (IFileTree const* subtree = child->m_Tree) {
+        tasks.start([&task, subtree, depth] {
+          task(subtree, depth - 1);
+        });
+      }
+    }
+  };
+
+  tasks.start([&task, this, depth] {
+    task(this, depth);
+  });
+  tasks.wait();
+}
+
+void IFileTree::freeze() const
+{
+  if (m_Frozen.load(std::memory_order_acquire)) {
+    return;
+  }
+  populateAll();
+
+  // Only the index of this tree is built, indexing the subtrees too would index each
+  // file once per parent. Frozen indexes are not updated, so they are not counted:
+  {
+    Extras& extras = this->extras();
+    std::unique_lock lock(extras.mutex);
+    buildSuffixIndex(extras, lock);
+    if (!extras.frozenSuffixIndex.exchange(true, std::memory_order_release)) {
+      g_SuffixIndexes.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+
+  freezeTree();
+}
+
+void IFileTree::freezeTree() const
+{
+  // Subtrees are frozen first, so that a frozen tree only contains frozen trees:
+  for (auto& entry : entries()) {
+    if (IFileTree const* subtree = entry->m_Tree;
+        subtree != nullptr && !subtree->m_Frozen.load(std::memory_order_acquire)) {
+      subtree->freezeTree();
+    }
+  }
+
+  // Small trees are scanned instead of indexed, see findEntry():
+  std::scoped_lock lock(m_IndexMutex);
+  if (m_Entries.size() >= INDEX_MIN_SIZE) {
+    buildIndex();
+  }
+  m_Frozen.store(true, std::memory_order_release);
+}
+
+void IFileTree::checkMutable() const
+{
+  if (m_Frozen.load(std::memory_order_acquire)) {
+    throw UnsupportedOperationException(
+        QObject::tr("Cannot modify frozen tree '%1'.").arg(name()));
+  }
+}
+
 /**
  * @brief Populate the internal vectors and update the flag.
  */
@@ -861,7 +2506,22 @@ void IFileTree::populate() const
   // Need to check m_Populated again here since the tree can be populated without
   // a call to entries() (e.g., on copy/orphanTree):
   if (!m_Populated) {
-    if (!doPopulate(astree(), m_Entries)) {
+    std::shared_ptr<const IFileTree> source;
+    if (Extras* extras = m_Extras.load(std::memory_order_acquire)) {
+      std::scoped_lock lock(extras->mutex);
+      source.swap(extras->cloneSource);
+    }
+
+    if (source != nullptr) {
+      // Lazy clone, copy the entries of the source, which are already sorted:
+      auto self = astree();
+      for (auto& entry : source->entries()) {
+        auto copy      = entry->clone();
+        copy->m_Parent = self;
+        m_Entries.push_back(std::move(copy));
+      }
+      g_PendingClones.fetch_sub(1, std::memory_order_relaxed);
+    } else if (!doPopulate(astree(), m_Entries)) {
       std::sort(std::begin(m_Entries), std::end(m_Entries), FileEntryComparator{});
     }
     m_Populated = true;
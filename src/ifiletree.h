@@ -21,20 +21,32 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #ifndef IFILETREE_H
 #define IFILETREE_H
 
+#include <algorithm>
 #include <atomic>
+#include <cstdint>
+#include <functional>
 #include <iterator>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <span>
 #include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include <QDateTime>
 #include <QFlags>
 #include <QList>
+#include <QRegularExpression>
 #include <QString>
+#include <QStringView>
 
 #include "dllimport.h"
+#include "fileglob.h"
+#include "filenamepool.h"
 #include "utility.h"
 
 /**
@@ -92,6 +104,90 @@ struct FileNameComparator
   {
     return lhs.compare(rhs, CaseSensitivity);
   }
+  static int compare(QStringView lhs, QStringView rhs)
+  {
+    return lhs.compare(rhs, CaseSensitivity);
+  }
+
+  /**
+   * @brief Compute a hash of the given filename that is consistent with compare(),
+   *     i.e., two filenames that compare equal have the same hash.
+   *
+   * @param name Filename to hash.
+   *
+   * @return the hash of the filename.
+   */
+  static std::size_t hash(QStringView name)
+  {
+    // FNV-1a over the case-folded code points, folding on the fly so that hashing
+    // does not allocate:
+    std::uint64_t h    = 14695981039346656037ull;
+    const qsizetype sz = name.size();
+    for (qsizetype i = 0; i < sz; ++i) {
+      char32_t c = name[i].unicode();
+      if (QChar::isHighSurrogate(c) && i + 1 < sz && name[i + 1].isLowSurrogate()) {
+        c = QChar::surrogateToUcs4(name[i], name[i + 1]);
+        ++i;
+      }
+      h = (h ^ QChar::toCaseFolded(c)) * 1099511628211ull;
+    }
+    return static_cast<std::size_t>(h);
+  }
+
+  /**
+   * @brief Case-fold the given filename, such that comparing two folded filenames
+   *     case-sensitively is equivalent to comparing the original filenames with
+   *     compare().
+   *
+   * @param name Filename to fold.
+   *
+   * @return the folded filename, sharing its data with the given one if the
+   *     filename is already folded.
+   */
+  static QString caseFold(QString const& name)
+  {
+    const qsizetype sz = name.size();
+
+    // Retrieve the code point at the given index and its size:
+    const auto codePointAt = [&name, sz](qsizetype i) -> std::pair<char32_t, int> {
+      const QChar c = name[i];
+      if (c.isHighSurrogate() && i + 1 < sz && name[i + 1].isLowSurrogate()) {
+        return {QChar::surrogateToUcs4(c, name[i + 1]), 2};
+      }
+      return {c.unicode(), 1};
+    };
+
+    // Most names are already folded, in which case we share the data:
+    qsizetype i = 0;
+    while (i < sz) {
+      const auto [c, n] = codePointAt(i);
+      if (QChar::toCaseFolded(c) != c) {
+        break;
+      }
+      i += n;
+    }
+
+    if (i == sz) {
+      return name;
+    }
+
+    QString folded;
+    folded.reserve(sz);
+    folded.append(QStringView(name).first(i));
+    while (i < sz) {
+      const auto [c, n]   = codePointAt(i);
+      const char32_t fold = QChar::toCaseFolded(c);
+      if (QChar::requiresSurrogates(fold)) {
+        folded.append(QChar(QChar::highSurrogate(fold)));
+        folded.append(QChar(QChar::lowSurrogate(fold)));
+      } else {
+        folded.append(QChar(static_cast<char16_t>(fold)));
+      }
+      i += n;
+    }
+
+    return folded;
+  }
 
   /**
    *
@@ -152,14 +248,14 @@ public:  // Methods
    *
    * @return true if this entry is a file, false otherwize.
    */
-  bool isFile() const { return astree() == nullptr; }
+  bool isFile() const { return m_Tree == nullptr; }
 
   /**
    * @brief Check if this entry is a directory.
    *
    * @return true if this entry is a directory, false otherwize.
    */
-  bool isDir() const { return astree() != nullptr; }
+  bool isDir() const { return m_Tree != nullptr; }
 
   /**
    * @brief Convert this entry to a tree. This method returns a null pointer
@@ -189,7 +285,7 @@ public:  // Methods
    *
    * @return the name of this entry.
    */
-  QString name() const { return m_Name; }
+  QString name() const { return m_Name.str(); }
 
   /**
    * @brief Compare the name of this entry against the given string.
@@ -200,7 +296,14 @@ public:  // Methods
    *
    * @return -1, 0 or 1 depending on the result of the comparison.
    */
-  int compare(QString name) const { return FileNameComparator::compare(m_Name, name); }
+  int compare(QString const& name) const
+  {
+    return FileNameComparator::compare(m_Name.str(), name);
+  }
+  int compare(QStringView name) const
+  {
+    return FileNameComparator::compare(m_Name.str(), name);
+  }
 
   /**
    * @brief Retrieve the "last" extension of this entry.
@@ -234,7 +337,7 @@ public:  // Methods
    * @brief Retrieve the path from this entry up to the root of the tree.
    *
    * This method propagate up the tree so is not constant complexity as
-   * the full path is never stored.
+   * the full path is never stored, but the path is built with a single allocation.
    *
    * @param sep The type of separator to use to create the path.
    *
@@ -309,6 +412,13 @@ protected:  // Constructors:
    */
   virtual std::shared_ptr<FileTreeEntry> clone() const;
 
+  /**
+   * @brief Change the name of this entry, updating its comparison key.
+   *
+   * @param name The new name of this entry.
+   */
+  void setName(QString name);
+
   /**
    * @brief Creates a new FileTreeEntry corresponding to a file with the given
    * parameters.
@@ -323,11 +433,26 @@ protected:  // Constructors:
   createFileEntry(std::shared_ptr<const IFileTree> parent, QString name);
 
 private:
+  /**
+   * @brief Retrieve the suffix of this entry without copying it, see suffix().
+   *
+   * @return a view on the suffix of this entry, valid until this entry is renamed.
+   */
+  QStringView suffixView() const;
+
   std::weak_ptr<const IFileTree> m_Parent;
 
-  QString m_Name;
+  // Interned name, which also holds the case-folded name and its hash so that
+  // comparing entries does not have to fold their names again:
+  FileNamePool::Name m_Name;
+
+  // This entry as a tree, set by the constructor of IFileTree, so that checking the
+  // type of an entry does not have to go through astree():
+  IFileTree* m_Tree = nullptr;
 
   friend class IFileTree;
+  friend struct FileEntryComparator;
+  friend struct MatchEntryComparator;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(FileTreeEntry::FileTypes);
@@ -342,7 +467,8 @@ Q_DECLARE_OPERATORS_FOR_FLAGS(FileTreeEntry::FileTypes);
  * object.
  *
  * Read-only operations on the tree are thread-safe, even when the tree has not been
- * populated yet.
+ * populated yet. A tree that is shared between threads should be frozen with freeze(),
+ * which guarantees that it is not modified anymore.
  *
  * In order to prevent wrong usage of the tree, implementing classes may throw
  * UnsupportedOperationException if an operation is not supported. By default, all
@@ -364,6 +490,11 @@ Q_DECLARE_OPERATORS_FOR_FLAGS(FileTreeEntry::FileTypes);
  * the root node is destroyed, it will not be possible to go up the tree, even if we
  * still have a valid shared pointer.
  *
+ * Looking up an entry by name in a directory with many entries uses a
+ * case-insensitive hash index of that directory, built on the first lookup and kept
+ * up-to-date by the mutable operations, so finding an entry by path costs time
+ * proportional to the depth of the path, not to the width of the directories.
+ *
  * The inheritance is made virtual to provide a way for child classes to use both a
  * custom FileTreeEntry and IFileTree implementations. This has no impact on the usage
  * of the interface.
@@ -478,28 +609,28 @@ public:  // Access methods:
   /**
    *
    */
-  iterator begin() { return {std::cbegin(entries())}; }
+  iterator begin() { return {std::cbegin(std::as_const(*this).entries())}; }
   const_iterator begin() const { return {std::cbegin(entries())}; }
   const_iterator cbegin() const { return {std::cbegin(entries())}; }
 
   /**
    *
    */
-  reverse_iterator rbegin() { return {std::crbegin(entries())}; }
+  reverse_iterator rbegin() { return {std::crbegin(std::as_const(*this).entries())}; }
   const_reverse_iterator rbegin() const { return {std::crbegin(entries())}; }
   const_reverse_iterator crbegin() const { return {std::crbegin(entries())}; }
 
   /**
    *
    */
-  iterator end() { return {std::cend(entries())}; }
+  iterator end() { return {std::cend(std::as_const(*this).entries())}; }
   const_iterator end() const { return {std::cend(entries())}; }
   const_iterator cend() const { return {std::cend(entries())}; }
 
   /**
    *
    */
-  reverse_iterator rend() { return {std::crend(entries())}; }
+  reverse_iterator rend() { return {std::crend(std::as_const(*this).entries())}; }
   const_reverse_iterator rend() const { return {std::crend(entries())}; }
   const_reverse_iterator crend() const { return {std::crend(entries())}; }
 
@@ -524,7 +655,7 @@ public:  // Access methods:
   std::shared_ptr<FileTreeEntry> at(std::size_t i)
   {
     if (i < size()) {
-      return entries()[i];
+      return std::as_const(*this).entries()[i];
     }
     throw std::out_of_range("IFileTree::at");
   }
@@ -546,13 +677,21 @@ public:  // Access methods:
   /**
    * @brief Check if the given entry exists.
    *
+   * The overloads taking a QStringView, which also accept std::u16string_view, split
+   * the path in place and do not allocate.
+   *
    * @param path Path to the entry, separated by / or \.
    * @param type The type of the entry to check.
    *
    * @return true if the entry was found, false otherwize.
    */
-  bool exists(QString path,
+  bool exists(QStringView path,
               FileTreeEntry::FileTypes type = FileTreeEntry::FILE_OR_DIRECTORY) const;
+  bool exists(QString path,
+              FileTreeEntry::FileTypes type = FileTreeEntry::FILE_OR_DIRECTORY) const
+  {
+    return exists(QStringView(path), type);
+  }
 
   /**
    * @brief Retrieve the given entry.
@@ -565,9 +704,19 @@ public:  // Access methods:
    *
    * @return the entry if found, a null pointer otherwize.
    */
-  std::shared_ptr<FileTreeEntry> find(QString path, FileTypes type = FILE_OR_DIRECTORY);
-  std::shared_ptr<const FileTreeEntry> find(QString path,
+  std::shared_ptr<FileTreeEntry> find(QStringView path,
+                                      FileTypes type = FILE_OR_DIRECTORY);
+  std::shared_ptr<const FileTreeEntry> find(QStringView path,
                                             FileTypes type = FILE_OR_DIRECTORY) const;
+  std::shared_ptr<FileTreeEntry> find(QString path, FileTypes type = FILE_OR_DIRECTORY)
+  {
+    return find(QStringView(path), type);
+  }
+  std::shared_ptr<const FileTreeEntry> find(QString path,
+                                            FileTypes type = FILE_OR_DIRECTORY) const
+  {
+    return find(QStringView(path), type);
+  }
 
   /**
    * @brief Convenient method around find() that returns IFileTree instead of entries.
@@ -576,16 +725,24 @@ public:  // Access methods:
    *
    * @return the directory if found, a null pointer otherwize.
    */
-  std::shared_ptr<IFileTree> findDirectory(QString path)
+  std::shared_ptr<IFileTree> findDirectory(QStringView path)
   {
     auto entry = find(path, DIRECTORY);
     return (entry != nullptr && entry->isDir()) ? entry->astree() : nullptr;
   }
-  std::shared_ptr<const IFileTree> findDirectory(QString path) const
+  std::shared_ptr<const IFileTree> findDirectory(QStringView path) const
   {
     auto entry = find(path, DIRECTORY);
     return (entry != nullptr && entry->isDir()) ? entry->astree() : nullptr;
   }
+  std::shared_ptr<IFileTree> findDirectory(QString path)
+  {
+    return findDirectory(QStringView(path));
+  }
+  std::shared_ptr<const IFileTree> findDirectory(QString path) const
+  {
+    return findDirectory(QStringView(path));
+  }
 
   /**
    * @brief Retrieve the path from this tree to the given entry.
@@ -598,9 +755,211 @@ public:  // Access methods:
    */
   QString pathTo(std::shared_ptr<const FileTreeEntry> entry, QString sep = "\\") const
   {
-    return entry->pathFrom(astree());
+    return entry->pathFrom(astree(), sep);
+  }
+
+public:  // Queries:
+  /**
+   * @brief Find all the entries under this tree whose path matches the given glob
+   *     pattern, see FileGlob.
+   *
+   * Subtrees that cannot match the pattern are not visited, literal segments of the
+   * pattern are looked up directly instead of checking every entry of a tree, and
+   * patterns only checking the suffix of entries at any depth, e.g., `**` followed by
+   * `*.esp`, do a single walk of the tree without any other check. Paths of the
+   * entries are never built.
+   *
+   * Parent trees are always found before their children.
+   *
+   * @param pattern Pattern to match, relative to this tree.
+   * @param types Types of the entries to find.
+   *
+   * @return the matching entries.
+   */
+  std::vector<std::shared_ptr<FileTreeEntry>>
+  findAll(FileGlob const& pattern, FileTypes types = FILE_OR_DIRECTORY);
+  std::vector<std::shared_ptr<const FileTreeEntry>>
+  findAll(FileGlob const& pattern, FileTypes types = FILE_OR_DIRECTORY) const;
+  std::vector<std::shared_ptr<FileTreeEntry>>
+  findAll(QString const& pattern, FileTypes types = FILE_OR_DIRECTORY)
+  {
+    return findAll(FileGlob(pattern), types);
+  }
+  std::vector<std::shared_ptr<const FileTreeEntry>>
+  findAll(QString const& pattern, FileTypes types = FILE_OR_DIRECTORY) const
+  {
+    return findAll(FileGlob(pattern), types);
   }
 
+  /**
+   * @brief Find all the entries under this tree whose path matches the given regular
+   *     expression.
+   *
+   * Unlike the glob version, this needs the path of every entry, which is built in a
+   * single reused buffer. The whole tree is visited.
+   *
+   * @param regex Regular expression to match against the path of the entries from
+   *     this tree, including their names.
+   * @param types Types of the entries to find.
+   * @param sep The separator to use in paths.
+   *
+   * @return the matching entries.
+   */
+  std::vector<std::shared_ptr<FileTreeEntry>>
+  findAll(QRegularExpression const& regex, FileTypes types = FILE_OR_DIRECTORY,
+          QChar sep = '/');
+  std::vector<std::shared_ptr<const FileTreeEntry>>
+  findAll(QRegularExpression const& regex, FileTypes types = FILE_OR_DIRECTORY,
+          QChar sep = '/') const;
+
+  /**
+   * @brief Find all the files under this tree, at any depth, with the given suffix,
+   *     see FileTreeEntry::hasSuffix().
+   *
+   * This uses an index of the files of this tree by suffix, which is built on the
+   * first call and then kept up to date when this tree or one of its subtrees is
+   * modified, so repeated queries do not walk the tree.
+   *
+   * @param suffix Suffix of the files to find, without the leading dot.
+   *
+   * @return the matching files, in no particular order.
+   */
+  std::vector<std::shared_ptr<FileTreeEntry>> findBySuffix(QString const& suffix);
+  std::vector<std::shared_ptr<const FileTreeEntry>>
+  findBySuffix(QString const& suffix) const;
+
+  /**
+   * @brief Find all the files under this tree, at any depth, with one of the given
+   *     suffixes, see findBySuffix().
+   *
+   * @param suffixes Suffixes of the files to find, without the leading dot.
+   *
+   * @return the matching files, grouped by suffix, in the order of the suffixes.
+   */
+  std::vector<std::shared_ptr<FileTreeEntry>>
+  findBySuffix(QStringList const& suffixes);
+  std::vector<std::shared_ptr<const FileTreeEntry>>
+  findBySuffix(QStringList const& suffixes) const;
+
+public:  // Comparison:
+  /**
+   * @brief A difference between two trees, see diff().
+   */
+  struct Difference
+  {
+    enum class Kind
+    {
+      // The entry only exists in the other tree:
+      ADDED,
+
+      // The entry only exists in this tree:
+      REMOVED,
+
+      // The entry exists in both trees, but is a file in one of them and a directory
+      // in the other one:
+      TYPE_CHANGED
+    };
+
+    Kind kind;
+
+    // The entry in this tree, null if the entry was added:
+    std::shared_ptr<const FileTreeEntry> before;
+
+    // The entry in the other tree, null if the entry was removed:
+    std::shared_ptr<const FileTreeEntry> after;
+  };
+
+  /**
+   * @brief Compute the differences between this tree and the given one.
+   *
+   * Both trees are compared level by level with a single merge-join over their
+   * sorted entries, so this is linear in the number of entries that are compared.
+   * Names are compared case-insensitively. Files present in both trees are considered
+   * identical, since trees only know about names.
+   *
+   * Added and removed directories are reported as a single difference, their content
+   * is not. Subtrees that are known to be identical are not compared, i.e., the same
+   * tree in both, or a lazy clone and its source, see clone().
+   *
+   * @param other The tree to compare this tree to.
+   *
+   * @return the differences from this tree to the given one, where parent trees are
+   *     always before their children.
+   */
+  std::vector<Difference> diff(std::shared_ptr<const IFileTree> other) const;
+
+public:  // Change notifications:
+  /**
+   * @brief A change made to a tree, see subscribe().
+   */
+  struct Change
+  {
+    enum class Kind
+    {
+      // An entry was added at path, e.g., by addFile() or insert():
+      INSERTED,
+
+      // The entry at path was removed, either erased or replaced by another entry:
+      REMOVED,
+
+      // The entry at previousPath was moved to path, e.g., by move() or merge():
+      MOVED,
+
+      // The directory at previousPath was merged into the existing directory entry
+      // at path, the entries moved from one directory to the other are reported by
+      // their own changes. previousPath is empty if the merged directory was not
+      // under the subscribed tree:
+      MERGED
+    };
+
+    Kind kind;
+
+    // The entry that was changed, the destination directory for merges:
+    std::shared_ptr<const FileTreeEntry> entry;
+
+    // Paths relative to the subscribed tree, separated by \:
+    QString path;
+    QString previousPath;
+  };
+
+  using ChangeCallback = std::function<void(Change const&)>;
+
+  /**
+   * @brief Register a callback to be notified of the changes made to this tree or to
+   *     any of its subtrees.
+   *
+   * Changes are reported from the point of view of this tree: an entry moved from
+   * this tree to an unrelated tree is reported as removed, and an entry moved from an
+   * unrelated tree to this tree is reported as inserted. Removed directories are
+   * reported as a single change, their content is not.
+   *
+   * Callbacks are called synchronously, after the change has been made, on the thread
+   * that made the change. Callbacks may read the tree, and may unsubscribe, but must
+   * not modify the tree. Trees without subscriptions, which is the common case, do not
+   * pay for this feature.
+   *
+   * @param callback Callback to call for each change.
+   *
+   * @return an identifier for the subscription, that can be used to unsubscribe.
+   */
+  std::size_t subscribe(ChangeCallback callback) const;
+
+  /**
+   * @brief Unregister a callback registered with subscribe().
+   *
+   * @param subscription Identifier returned by subscribe().
+   *
+   * @return true if the subscription was removed, false if there was no such
+   *     subscription on this tree.
+   */
+  bool unsubscribe(std::size_t subscription) const;
+
+  /**
+   * @return the revision of this tree, which changes each time this tree or one of
+   *     its subtrees is modified, e.g., to invalidate data computed from this tree.
+   */
+  std::uint64_t revision() const { return m_Revision.load(std::memory_order_acquire); }
+
 public:  // Walk operations
   enum class WalkReturn
   {
@@ -639,6 +998,164 @@ public:  // Walk operations
            callback,
        QString sep = "\\") const;
 
+  /**
+   * @brief Path to the parent of the current entry during a walkEntries().
+   *
+   * The path is only built when str() is called, in a buffer that is reused for the
+   * whole walk, so walking a tree without requesting paths does not allocate them.
+   */
+  class QDLLEXPORT WalkPath
+  {
+  public:
+    /**
+     * @return the path from the walked tree to the parent of the current entry, with
+     *     a trailing separator, or an empty string for direct children of the walked
+     *     tree. The reference is only valid until the callback returns.
+     */
+    QString const& str() const;
+
+    /**
+     * @return the depth of the current entry, 0 for direct children of the walked
+     *     tree.
+     */
+    std::size_t depth() const { return m_Trees.size() - 1; }
+
+    /**
+     * @return the tree containing the current entry.
+     */
+    IFileTree const& parent() const { return *m_Trees.back(); }
+
+  private:
+    WalkPath(IFileTree const* tree, QChar sep);
+
+    void push(IFileTree const* tree)
+    {
+      m_Trees.push_back(tree);
+      m_Valid = std::min(m_Valid, m_Trees.size() - 1);
+    }
+
+    void pop()
+    {
+      m_Trees.pop_back();
+      m_Valid = std::min(m_Valid, m_Trees.size());
+    }
+
+    QChar m_Sep;
+
+    // Trees from the walked tree to the parent of the current entry:
+    std::vector<IFileTree const*> m_Trees;
+
+    // The buffer contains the path of the first m_Valid trees, and m_Lengths[i] is
+    // the length of the path of m_Trees[i] in the buffer:
+    mutable QString m_Buffer;
+    mutable std::vector<qsizetype> m_Lengths;
+    mutable std::size_t m_Valid;
+
+    friend class IFileTree;
+  };
+
+  /**
+   * @brief Walk this tree, calling the given function for each entry in it.
+   *
+   * This is a faster alternative to walk(): the callback is not type-erased, entries
+   * are given by reference and the path is only built on demand, see WalkPath. The
+   * callback is called with a `WalkPath const&` and a `FileTreeEntry const&`, and can
+   * either return a `WalkReturn` or nothing, which is the same as `CONTINUE`.
+   *
+   * Entries are visited in the same order as walk(). Unlike walk(), the walked trees
+   * must not be modified by the callback.
+   *
+   * @param callback Method to call for each entry in the tree.
+   * @param sep The separator to use in paths.
+   */
+  template <class Callback>
+  void walkEntries(Callback&& callback, QChar sep = '\\') const
+  {
+    using Result =
+        std::invoke_result_t<Callback&, WalkPath const&, FileTreeEntry const&>;
+
+    WalkPath path(this, sep);
+
+    // Index of the next entry to visit in each tree of the path:
+    std::vector<std::size_t> next{0};
+
+    while (!next.empty()) {
+      auto const& children = path.m_Trees.back()->entries();
+      if (next.back() == children.size()) {
+        next.pop_back();
+        path.pop();
+        continue;
+      }
+
+      FileTreeEntry const& entry = *children[next.back()++];
+
+      auto res = WalkReturn::CONTINUE;
+      if constexpr (std::is_void_v<Result>) {
+        callback(std::as_const(path), entry);
+      } else {
+        res = callback(std::as_const(path), entry);
+      }
+
+      if (res == WalkReturn::STOP) {
+        break;
+      }
+      if (entry.m_Tree != nullptr && res != WalkReturn::SKIP) {
+        path.push(entry.m_Tree);
+        next.push_back(0);
+      }
+    }
+  }
+
+public:  // Population:
+  /**
+   * @brief Populate this tree and its subtrees up to the given depth, populating
+   *     sibling directories in parallel.
+   *
+   * Trees are normally populated lazily, one directory at a time, when their entries
+   * are first accessed. For trees backed by a slow source, e.g., the filesystem, this
+   * can be used before a full scan so that directories are populated concurrently on
+   * a thread pool. This returns once all the requested trees are populated.
+   *
+   * doPopulate() must be thread-safe for different directories, which is the case if
+   * it only reads from its source. Each directory is still populated exactly once,
+   * even if its entries are accessed concurrently from another thread.
+   *
+   * The tree must not be modified while this method runs.
+   *
+   * @param depth Depth to populate, 0 only populates this tree, 1 also populates its
+   *     direct subtrees, and so on. A negative depth populates the whole tree.
+   * @param maxThreads Maximum number of threads to use, or 0 to use the number of
+   *     processors.
+   */
+  void prefetch(int depth, int maxThreads = 0) const;
+
+  /**
+   * @brief Populate this tree and all of its subtrees in parallel, see prefetch().
+   */
+  void populateAll(int maxThreads = 0) const { prefetch(-1, maxThreads); }
+
+  /**
+   * @brief Populate this tree and all of its subtrees, and make them immutable.
+   *
+   * Once frozen, lookups, walks and finds on the tree and its subtrees are safe to
+   * call from any number of threads without external synchronization, and name
+   * lookups do not take any lock. The index by suffix of the tree itself is built
+   * here, so findBySuffix() on the tree does not take any lock either. All the
+   * operations that would modify the tree or one of its subtrees throw
+   * UnsupportedOperationException instead, and leave the tree untouched. Clones of a
+   * frozen tree are not frozen.
+   *
+   * This is meant to be called by the owner of a tree before sharing it with other
+   * threads, e.g., as a const tree, and must not be called while the tree is being
+   * modified. A tree cannot be unfrozen.
+   */
+  void freeze() const;
+
+  /**
+   * @return true if this tree has been frozen, see freeze().
+   */
+  bool isFrozen() const { return m_Frozen.load(std::memory_order_acquire); }
+
 public:  // Utility functions:
   /**
    * @brief Create a new orphan empty tree.
@@ -684,6 +1201,29 @@ public:  // Mutable operations:
    */
   virtual std::shared_ptr<IFileTree> addDirectory(QString path);
 
+  /**
+   * @brief Create new files under this tree, creating the missing directories.
+   *
+   * This is equivalent to calling addFile() for each path, but the new files of each
+   * directory are sorted once and merged with the existing entries of the directory
+   * in a single pass, instead of being inserted one by one, which makes this much
+   * faster to build large trees.
+   *
+   * If the same file appears multiple times in the given paths, only the first one is
+   * added, or the last one if replaceIfExists is true. The result is unspecified if
+   * a path is both a file and a directory in the given paths.
+   *
+   * This method invalidates iterators to this tree and all the subtrees present in
+   * the given paths.
+   *
+   * @param paths Paths of the files to create.
+   * @param replaceIfExists If true and an entry already exists at one of the given
+   *     paths, it will be replaced by a new entry, see addFile().
+   *
+   * @return the number of files created.
+   */
+  std::size_t addFiles(QStringList const& paths, bool replaceIfExists = false);
+
   /**
    * @brief Insert the given entry in this tree, removing it from its
    * previouis parent.
@@ -713,6 +1253,30 @@ public:  // Mutable operations:
   iterator insert(std::shared_ptr<FileTreeEntry> entry,
                   InsertPolicy insertPolicy = InsertPolicy::FAIL_IF_EXISTS);
 
+  /**
+   * @brief Insert the given entries in this tree, removing them from their previous
+   * parents.
+   *
+   * This is equivalent to calling insert() for each entry, in order, but the
+   * entries are sorted once and merged with the existing entries of this tree in a
+   * single pass, instead of being inserted one by one. Entries with the same name in
+   * the given vector are resolved against each other according to the insert policy,
+   * as if they had been inserted one after the other.
+   *
+   * Entries that are this tree or a parent of this tree, and entries that are
+   * already in this tree, are ignored.
+   *
+   * This method invalidates iterator to this tree, to the parent trees of the given
+   * entries, and to subtrees of this tree if the insert policy is MERGE.
+   *
+   * @param entries Entries to insert.
+   * @param insertPolicy Policy to use on conflict.
+   *
+   * @return the number of entries that were inserted or merged.
+   */
+  std::size_t insertMany(std::vector<std::shared_ptr<FileTreeEntry>> entries,
+                         InsertPolicy insertPolicy = InsertPolicy::FAIL_IF_EXISTS);
+
   /**
    * @brief Merge the given tree with this tree, i.e., insert all entries
    * of the given tree into this tree.
@@ -741,6 +1305,40 @@ public:  // Mutable operations:
   std::size_t merge(std::shared_ptr<IFileTree> source,
                     OverwritesType* overwrites = nullptr);
 
+  /**
+   * @brief Merge the given tree with this tree like merge(), merging independent
+   *     subdirectories in parallel.
+   *
+   * The merge is done in phases: the conflicts between the two trees are first found
+   * in parallel, then beforeReplace() and beforeInsert() are called on the calling
+   * thread, in the same order as merge() would call them, and finally the directories
+   * are merged in parallel. Change notifications are sent once all the directories are
+   * merged, on the calling thread and in the same order as merge(), and overwrites are
+   * reported the same way as merge().
+   *
+   * Unlike merge(), if one of the calls to beforeReplace() or beforeInsert() fails,
+   * neither tree is modified.
+   *
+   * This is faster than merge() for large trees, e.g., when merging a whole data
+   * folder into the root of a tree. Neither tree may be accessed from another thread
+   * while this method runs.
+   *
+   * The merge fails if the source is under this tree and would be merged into or
+   * replaced by one of its own entries, e.g., when merging "Data" into a tree that
+   * has "Data/Data".
+   *
+   * @param source Tree to merge.
+   * @param overwrites If not null, can be used to create a mapping from
+   *     overriden file to new files.
+   * @param maxThreads Maximum number of threads to use, or 0 to use the number of
+   *     processors.
+   *
+   * @return the number of overwritten entries, or MERGE_FAILED if the merge
+   *     failed (e.g. because the source is a parent of this tree).
+   */
+  std::size_t mergeParallel(std::shared_ptr<IFileTree> source,
+                            OverwritesType* overwrites = nullptr, int maxThreads = 0);
+
   /**
    * @brief Move the given entry to the given path under this tree.
    *
@@ -877,7 +1475,7 @@ public:  // Inherited methods:
   }
 
 public:  // Destructor:
-  virtual ~IFileTree() {}
+  virtual ~IFileTree();
 
 public:  // Deleted operators:
   IFileTree(IFileTree const&) = delete;
@@ -924,6 +1522,29 @@ protected:
    */
   static QStringList splitPath(QString path);
 
+  /**
+   * @brief Retrieve the next component of the given path, without allocating.
+   *
+   * @param path The path, separated by / or \.
+   * @param position Position in the path to start from, updated to the end of the
+   *     returned component.
+   *
+   * @return the next non-empty component of the path, or an empty view if there are
+   *     no more components.
+   */
+  static QStringView nextComponent(QStringView path, qsizetype& position);
+
+  /**
+   * @brief Split the given path into the path of its parent and its last component,
+   *     without allocating.
+   *
+   * @param path The path, separated by / or \.
+   *
+   * @return the path of the parent and the last component, which is empty if the path
+   *     has no components.
+   */
+  static std::pair<QStringView, QStringView> splitLast(QStringView path);
+
   /**
    * @brief Called before replacing an entry with another one.
    *
@@ -1050,7 +1671,13 @@ protected:  // Constructor
   IFileTree();
 
   /**
+   * @brief Creates a new orphan tree identical to this tree.
    *
+   * If this tree is populated, the clone is lazy: it only references this tree and
+   * copies its entries (again as lazy clones for the subtrees) when it is populated,
+   * or right before this tree is modified. Cloning a tree is therefore a constant
+   * time operation, and only the parts of the clone that are actually accessed or
+   * modified are copied.
    */
   std::shared_ptr<FileTreeEntry> clone() const override;
 
@@ -1066,8 +1693,8 @@ private:  // Private stuff, look away!
    *
    * @return the entry, or a null pointer if the entry did not exist.
    */
-  std::shared_ptr<FileTreeEntry> fetchEntry(QStringList path, FileTypes matchType);
-  std::shared_ptr<const FileTreeEntry> fetchEntry(QStringList const& path,
+  std::shared_ptr<FileTreeEntry> fetchEntry(QStringView path, FileTypes matchType);
+  std::shared_ptr<const FileTreeEntry> fetchEntry(QStringView path,
                                                   FileTypes matchType) const;
 
   /**
@@ -1082,22 +1709,210 @@ private:  // Private stuff, look away!
   std::size_t mergeTree(std::shared_ptr<IFileTree> destination,
                         std::shared_ptr<IFileTree> source, OverwritesType* overwrites);
 
+  // Merge of a source directory into a destination directory, see mergeParallel():
+  struct MergePlan;
+
+  /**
+   * @brief Find the entries of the destination of the given plan that conflict with
+   * the entries of its source, without modifying either. The plans of the
+   * subdirectories to merge are created but not filled.
+   */
+  static void planMerge(MergePlan& plan);
+
+  /**
+   * @brief Call beforeReplace() and beforeInsert() for the given plan, recursively, in
+   * the same order as mergeTree().
+   *
+   * @param plan The plan to check.
+   * @param overwrites Replaced entries and the entries replacing them.
+   *
+   * @return true if the merge is allowed, false otherwise.
+   */
+  bool checkMerge(MergePlan const& plan,
+                  std::vector<OverwritesType::value_type>& overwrites);
+
+  /**
+   * @brief Move the entries of the source of the given plan to its destination, except
+   * for the subdirectories to merge.
+   */
+  static void applyMerge(MergePlan const& plan);
+
+  /**
+   * @brief Send the change notifications of the given plan, recursively, in the same
+   * order as mergeTree(), and detach the merged source subdirectories.
+   */
+  static void notifyMerge(MergePlan const& plan);
+
   /**
    * @brief Create a new subtree under the given tree.
    *
    * This method will create missing folders in the given path and will not fail if the
    * directory already exists but will fail the given path contains "." or "..".
    *
-   * @param begin, end Range of section of the path.
+   * @param path Path of the tree, separated by / or \.
    *
    * @return the entry corresponding to the create tree, or a null pointer if the tree
    * was not created.
    */
-  std::shared_ptr<IFileTree> createTree(QStringList::const_iterator begin,
-                                        QStringList::const_iterator end);
+  std::shared_ptr<IFileTree> createTree(QStringView path);
+
+  /**
+   * @brief Find the entries under this tree matching the given pattern.
+   *
+   * @param pattern Pattern to match.
+   * @param types Types of the entries to find.
+   * @param states Indices of the segments of the pattern to match against the
+   *     entries of this tree.
+   * @param matches Vector to add the matching entries to.
+   */
+  void collectMatches(FileGlob const& pattern, FileTypes types,
+                      std::vector<std::size_t> states,
+                      std::vector<FileTreeEntry*>& matches) const;
+  void collectMatches(QRegularExpression const& regex, FileTypes types, QChar sep,
+                      std::vector<FileTreeEntry*>& matches) const;
+
+  /**
+   * @brief Add the files of this tree with the given suffix to the given vector,
+   *     building or rebuilding the suffix index of this tree if required.
+   */
+  void collectBySuffix(QString const& suffix,
+                       std::vector<FileTreeEntry*>& matches) const;
+
+  /**
+   * @brief Add the differences between the two given trees to the given vector, see
+   *     diff().
+   */
+  static void diffTrees(IFileTree const& before, IFileTree const& after,
+                        std::vector<Difference>& differences);
+
+  /**
+   * @return the tree whose entries this tree has, i.e., the source of this tree if
+   *     this is a lazy clone that has not been populated yet, recursively, or this
+   *     tree.
+   */
+  IFileTree const* contentSource() const;
+
+  /**
+   * @brief Mark this tree and its parents as modified, see revision(). This is called
+   *     once by each operation that modifies this tree.
+   */
+  void touch();
+
+  /**
+   * @brief Update the suffix indexes of this tree and of its parents after the given
+   *     entries were added to this tree or before they are removed from it. This
+   *     does nothing if no tree has a suffix index.
+   *
+   * @param entries Entries added or removed, the files under the directories are
+   *     added or removed too.
+   * @param insert true if the entries were added, false if they are removed.
+   */
+  void updateSuffixIndexes(std::span<FileTreeEntry const* const> entries, bool insert);
+  void updateSuffixIndexes(std::vector<std::shared_ptr<FileTreeEntry>> const& entries,
+                           bool insert);
+
+  /**
+   * @brief Replace entries of this tree in a single pass over its entries.
+   *
+   * @param added Entries to add, which must not conflict with each other or with the
+   *     entries of this tree that are kept.
+   * @param removed Entries of this tree to remove.
+   */
+  void spliceEntries(std::vector<std::shared_ptr<FileTreeEntry>> added,
+                     std::unordered_set<FileTreeEntry const*> const& removed,
+                     std::unordered_map<FileTreeEntry const*,
+                                        std::shared_ptr<const IFileTree>> const&
+                         previousParents = {});
+
+  /**
+   * @brief Implementation of insert() for an entry that may have been renamed before
+   *     its insertion, e.g., by move().
+   *
+   * @param previousName Name of the entry in its current parent.
+   */
+  iterator insertEntry(std::shared_ptr<FileTreeEntry> entry, InsertPolicy insertPolicy,
+                       QString const& previousName);
+
+  /**
+   * @brief Implementation of erase().
+   *
+   * @param notify true to report the removal, false if the entry is being moved.
+   */
+  iterator eraseEntry(std::shared_ptr<FileTreeEntry> const& entry, bool notify);
+
+  /**
+   * @brief Report a change to the subscribers of the given trees and of their parents,
+   *     see subscribe(). This does nothing if there are no subscriptions at all.
+   *
+   * @param kind Kind of change.
+   * @param entry Entry that was changed.
+   * @param tree Tree containing the entry, or that contained it for removals.
+   * @param previousTree Tree that contained the entry for moves and merges.
+   * @param previousName Name of the entry in the previous tree, if different from its
+   *     current name.
+   */
+  static void notifyChange(Change::Kind kind, FileTreeEntry const& entry,
+                           IFileTree const* tree,
+                           IFileTree const* previousTree = nullptr,
+                           QString const* previousName   = nullptr);
+
+  /**
+   * @brief Find the entry with the given name directly under this tree.
+   *
+   * For directories with at least INDEX_MIN_SIZE entries, this uses (and builds
+   * if required) the name index of this tree, otherwise this is a linear search.
+   *
+   * @param name Name of the entry.
+   * @param matchTypes Type of the entry to find.
+   *
+   * @return the entry, or a null pointer if there is no such entry.
+   */
+  FileTreeEntry* findEntry(QStringView name, FileTypes matchTypes) const;
+
+  /**
+   * @brief Build the name index of this tree if it has not been built yet. The index
+   * mutex must be held.
+   */
+  void buildIndex() const;
+
+  /**
+   * @brief Update the name index of this tree after an entry was added or before
+   * an entry is removed. These do nothing if the index has not been built.
+   *
+   * @param entry The entry added or removed.
+   */
+  void indexInsert(FileTreeEntry* entry);
+  void indexErase(FileTreeEntry const* entry);
+
+  /**
+   * @brief Drop the name index of this tree, e.g., after a bulk removal. The index
+   * will be rebuilt on the next lookup.
+   */
+  void indexReset();
+
+  /**
+   * @brief Rename the given entry, keeping the index of its parent in sync.
+   *
+   * @param entry Entry to rename.
+   * @param name New name of the entry.
+   */
+  static void renameEntry(FileTreeEntry* entry, QString name);
+
+  // Minimum number of entries for a tree to use a name index:
+  static constexpr std::size_t INDEX_MIN_SIZE = 16;
+
+  // Case-insensitive index from name hash to entries, only built on lookup, for
+  // large directories:
+  using EntryIndex = std::unordered_multimap<std::size_t, FileTreeEntry*>;
+  mutable std::unique_ptr<EntryIndex> m_Index;
+  mutable std::mutex m_IndexMutex;
 
   // Indicate if this tree has been populated:
   mutable std::atomic<bool> m_Populated{false};
+
+  // Indicate if this tree has been frozen, set once its subtrees are frozen and its
+  // index is built, see freeze():
+  mutable std::atomic<bool> m_Frozen{false};
   mutable std::once_flag m_OnceFlag;
   mutable std::vector<std::shared_ptr<FileTreeEntry>> m_Entries;
 
@@ -1113,6 +1928,50 @@ private:  // Private stuff, look away!
    * @brief Populate the internal vectors and update the flag.
    */
   void populate() const;
+
+  /**
+   * @brief Freeze the subtrees of this tree, build its index and mark it as frozen.
+   *     This tree must already be populated, recursively.
+   */
+  void freezeTree() const;
+
+  /**
+   * @brief Throw UnsupportedOperationException if this tree is frozen. This is called
+   *     by all the operations that modify this tree, before any modification.
+   */
+  void checkMutable() const;
+
+  /**
+   * @brief Make the lazy clones of this tree and of its parents copy their entries,
+   * so that this tree can be modified without the modification being visible in the
+   * clones. This is called before any modification of this tree.
+   */
+  void detachClones();
+
+  /**
+   * @brief Make the lazy clones of this tree copy its entries.
+   */
+  void copyToClones() const;
+
+  // Revision of this tree, incremented each time this tree or one of its subtrees
+  // is modified:
+  std::atomic<std::uint64_t> m_Revision{0};
+
+  // State that most trees never use, i.e., the lazy clones, the subscriptions and
+  // the index by suffix, allocated on first use with a single mutex, see extras():
+  struct Extras;
+  mutable std::atomic<Extras*> m_Extras{nullptr};
+
+  /**
+   * @return the extra state of this tree, allocated if required.
+   */
+  Extras& extras() const;
+
+  /**
+   * @brief Build the suffix index of this tree if it has none, releasing the given
+   *     lock on its extra state while walking this tree.
+   */
+  void buildSuffixIndex(Extras& extras, std::unique_lock<std::mutex>& lock) const;
 };
 
 }  // namespace MOBase
@@ -0,0 +1,191 @@
+#include "directoryfiletree.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <QFile>
+
+#include "log.h"
+
+namespace MOBase
+{
+
+struct DirectoryFileTree::Root
+{
+  QString path;
+
+  // Descriptor of the root directory, all the other directories are opened relative
+  // to it:
+  int fd;
+
+  ~Root() { ::close(fd); }
+};
+
+namespace
+{
+
+// Record returned by getdents64, which is not declared by all C libraries:
+struct Dirent64
+{
+  std::uint64_t d_ino;
+  std::int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[1];
+};
+
+// Size of the buffer used to read directories, large enough for most directories
+// to be read with a single system call:
+constexpr std::size_t DIRENT_BUFFER_SIZE = 32 * 1024;
+
+// Whether the directory with the given identity is the directory at the given path,
+// relative to the given descriptor, or one of its parents, in which case following a
+// link to it would never end:
+bool isAncestor(int root, QString path, struct stat const& target)
+{
+  while (true) {
+    struct stat st;
+    const QByteArray encoded =
+        path.isEmpty() ? QByteArray(".") : QFile::encodeName(path);
+    if (::fstatat(root, encoded.constData(), &st, 0) == 0 &&
+        st.st_dev == target.st_dev && st.st_ino == target.st_ino) {
+      return true;
+    }
+    if (path.isEmpty()) {
+      return false;
+    }
+    const qsizetype slash = path.lastIndexOf('/');
+    path.truncate(slash < 0 ? 0 : slash);
+  }
+}
+
+}  // namespace
+
+std::shared_ptr<DirectoryFileTree> DirectoryFileTree::create(QString const& path)
+{
+  const int fd =
+      ::open(QFile::encodeName(path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    log::warn("failed to open directory '{}': {}", path, std::strerror(errno));
+    return nullptr;
+  }
+
+  std::shared_ptr<const Root> root(new Root{path, fd});
+  return std::shared_ptr<DirectoryFileTree>(
+      new DirectoryFileTree(nullptr, "", std::move(root), ""));
+}
+
+std::optional<DirectoryFileTree::Metadata>
+DirectoryFileTree::metadata(FileTreeEntry const& entry)
+{
+  std::shared_ptr<const DirectoryFileTree> tree;
+  const QString path = diskPath(entry, tree);
+  if (path.isNull()) {
+    return {};
+  }
+
+  struct stat st;
+  const QByteArray encoded = path.isEmpty() ? QByteArray(".") : QFile::encodeName(path);
+  if (::fstatat(tree->m_Root->fd, encoded.constData(), &st, 0) != 0 ||
+      S_ISDIR(st.st_mode) != entry.isDir()) {
+    return {};
+  }
+
+  return Metadata{static_cast<qint64>(st.st_size),
+                  QDateTime::fromMSecsSinceEpoch(
+                      static_cast<qint64>(st.st_mtim.tv_sec) * 1000 +
+                      st.st_mtim.tv_nsec / 1000000)};
+}
+
+QString DirectoryFileTree::rootPath() const
+{
+  return m_Root->path;
+}
+
+bool DirectoryFileTree::doPopulate(
+    std::shared_ptr<const IFileTree> parent,
+    std::vector<std::shared_ptr<FileTreeEntry>>& entries) const
+{
+  if (m_Path.isNull()) {
+    return true;
+  }
+
+  const QByteArray path =
+      m_Path.isEmpty() ? QByteArray(".") : QFile::encodeName(m_Path);
+  const int fd =
+      ::openat(m_Root->fd, path.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    log::warn("failed to open directory '{}/{}': {}", m_Root->path, m_Path,
+              std::strerror(errno));
+    return true;
+  }
+
+  alignas(Dirent64) char buffer[DIRENT_BUFFER_SIZE];
+  while (true) {
+    const long size = ::syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+    if (size <= 0) {
+      if (size < 0) {
+        log::warn("failed to read directory '{}/{}': {}", m_Root->path, m_Path,
+                  std::strerror(errno));
+      }
+      break;
+    }
+
+    for (long offset = 0; offset < size;) {
+      auto const* dirent = reinterpret_cast<Dirent64 const*>(buffer + offset);
+      offset += dirent->d_reclen;
+
+      const char* name = dirent->d_name;
+      if (std::strcmp(name, ".") == 0 || std::strcmp(name, "..") == 0) {
+        continue;
+      }
+
+      // The type of symbolic links, and of all entries on file systems that do not
+      // report types, can only be known with a stat:
+      unsigned char type = dirent->d_type;
+      if (type == DT_LNK || type == DT_UNKNOWN) {
+        struct stat st;
+        if (::fstatat(fd, name, &st, 0) != 0) {
+          continue;
+        }
+        type = S_ISDIR(st.st_mode)   ? DT_DIR
+               : S_ISREG(st.st_mode) ? DT_REG
+                                     : DT_UNKNOWN;
+
+        // Links to a directory containing them would make the tree infinite:
+        if (type == DT_DIR && isAncestor(m_Root->fd, m_Path, st)) {
+          log::debug("ignoring '{}/{}', which links to one of its parents",
+                     m_Root->path, m_Path.isEmpty()
+                                       ? QFile::decodeName(name)
+                                       : m_Path + "/" + QFile::decodeName(name));
+          continue;
+        }
+      }
+
+      // Other types of files (sockets, devices, ...) are ignored:
+      const QString entryName = QFile::decodeName(name);
+      if (type == DT_DIR) {
+        entries.push_back(std::shared_ptr<DirectoryFileTree>(new DirectoryFileTree(
+            parent, entryName, m_Root,
+            m_Path.isEmpty() ? entryName : m_Path + "/" + entryName)));
+      } else if (type == DT_REG) {
+        entries.push_back(makeDiskFile(parent, entryName));
+      }
+    }
+  }
+
+  ::close(fd);
+
+  // Directory listings are not sorted:
+  sortEntries(entries);
+  return true;
+}
+
+}  // namespace MOBase
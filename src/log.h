@@ -8,8 +8,14 @@
 #include <QSize>
 #include <QString>
 #include <QStringView>
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <filesystem>
+#include <iterator>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include <format>
@@ -60,25 +66,116 @@ concept RuntimeFormatString = requires(F&& f, Args&&... args) {
   !std::is_convertible_v<std::decay_t<F>, std::string_view>;
 };
 
-void QDLLEXPORT doLogImpl(spdlog::logger& lg, Levels lv, const std::string& s) noexcept;
+// messages of a category are prefixed by its name and written regardless of the
+// level of the logger, see Category; ring is the crash buffer of the logger, or null
+//
+void QDLLEXPORT doLogImpl(spdlog::logger& lg, spdlog::sinks::sink* ring, Levels lv,
+                          std::string_view category, const std::string& s) noexcept;
+
+// writes a message directly to the crash buffer of a logger, for the messages below
+// the level of the logger, see LoggerConfiguration::crashBufferLevel
+//
+void QDLLEXPORT keepImpl(spdlog::sinks::sink& ring, Levels lv,
+                         std::string_view s) noexcept;
+
+// level of the default logger, or Info if it hasn't been created yet
+//
+Levels QDLLEXPORT defaultLevel() noexcept;
 
 void QDLLEXPORT ireplace_all(std::string& input, std::string const& search,
                              std::string const& replace) noexcept;
 
+// replaces the filters of a blacklist in messages, see Logger::addToBlacklist()
+//
+// the filters are compiled into an Aho-Corasick automaton, so a message is scanned
+// once regardless of the number of filters, and messages without any match are left
+// untouched without allocating; filters are matched case-insensitively for ASCII
+// characters
+//
+// when matches overlap, the one that starts first wins, then the longest one;
+// replacements are not scanned again
+//
+class QDLLEXPORT Scrubber
+{
+public:
+  Scrubber() = default;
+  explicit Scrubber(const std::vector<BlacklistEntry>& entries);
+
+  bool empty() const { return m_replacements.empty(); }
+
+  void scrub(std::string& s) const;
+
+private:
+  // index of the class of each case-folded byte in the transition table, 0 for
+  // bytes that are not in any filter
+  std::array<std::uint16_t, 256> m_classes{};
+  std::size_t m_classCount = 1;
+
+  // transitions of the automaton, m_classCount per state, state 0 is the root
+  std::vector<std::uint32_t> m_next;
+
+  // length of the string leading to each state; a transition to a state exactly one
+  // deeper is an edge of the trie, the others come from failure links
+  std::vector<std::uint32_t> m_depth;
+
+  // length of the longest filter that ends at each state, 0 if none
+  std::vector<std::uint32_t> m_matchLength;
+
+  // filter ending exactly at each state, -1 if none
+  std::vector<std::int32_t> m_filter;
+
+  std::vector<std::string> m_replacements;
+
+  // length of the longest filter that starts at the given position, 0 if none
+  //
+  std::size_t anchoredMatch(const std::string& s, std::size_t start,
+                            std::int32_t& filter) const;
+};
+
+// buffer in which a message is formatted, owned by the calling thread and reused by
+// the next messages, so logging doesn't allocate once the buffer has grown enough
+//
+// a formatter that logs while a message is being formatted gets another buffer
+//
+class QDLLEXPORT MessageBuffer
+{
+public:
+  MessageBuffer() noexcept;
+  ~MessageBuffer();
+
+  MessageBuffer(const MessageBuffer&)            = delete;
+  MessageBuffer& operator=(const MessageBuffer&) = delete;
+
+  // empty when the buffer is created
+  //
+  std::string& str() noexcept { return *m_buffer; }
+
+private:
+  std::string* m_buffer;
+
+  // used when the buffers of the thread are all in use
+  std::string m_fallback;
+};
+
+// formats a message and writes it to the logger; without a scrubber, the message is
+// only kept in the crash buffer, see keepImpl()
+//
 template <class... Args>
-void doLog(spdlog::logger& logger, Levels lv,
-           const std::vector<MOBase::log::BlacklistEntry> bl,
+void doLog(spdlog::logger& logger, spdlog::sinks::sink* ring, Levels lv,
+           std::string_view category, const Scrubber* scrubber,
            std::format_string<Args...> format, Args&&... args) noexcept
 {
   // format errors are logged without much information to avoid throwing again
 
-  std::string s;
+  MessageBuffer buffer;
+  std::string& s = buffer.str();
+
   try {
-    s = std::format(format, std::forward<Args>(args)...);
+    std::format_to(std::back_inserter(s), format, std::forward<Args>(args)...);
 
     // check the blacklist
-    for (const BlacklistEntry& entry : bl) {
-      ireplace_all(s, entry.filter, entry.replacement);
+    if (scrubber) {
+      scrubber->scrub(s);
     }
   } catch (std::format_error&) {
     s  = "format error while logging";
@@ -91,30 +188,40 @@ void doLog(spdlog::logger& logger, Levels lv,
     lv = Levels::Error;
   }
 
-  doLogImpl(logger, lv, s);
+  if (scrubber) {
+    doLogImpl(logger, ring, lv, category, s);
+  } else {
+    keepImpl(*ring, lv, s);
+  }
 }
 
 template <class F, class... Args>
-void doLog(spdlog::logger& logger, Levels lv,
-           const std::vector<MOBase::log::BlacklistEntry> bl, F&& format,
+void doLog(spdlog::logger& logger, spdlog::sinks::sink* ring, Levels lv,
+           std::string_view category, const Scrubber* scrubber, F&& format,
            Args&&... args) noexcept
 {
-  std::string s;
+  MessageBuffer buffer;
+  std::string& s = buffer.str();
 
   // format errors are logged without much information to avoid throwing again
 
   try {
     if constexpr (sizeof...(Args) == 0) {
-      s = std::format("{}", std::forward<F>(format));
+      std::format_to(std::back_inserter(s), "{}", std::forward<F>(format));
     } else if constexpr (std::is_same_v<std::decay_t<F>, QString>) {
-      s = std::vformat(format.toStdString(), std::make_format_args(args...));
+      // the format string needs its own buffer, QString arguments are converted in
+      // the one of the formatter
+      MessageBuffer f;
+      MOBase::details::appendUtf8(f.str(), format);
+      std::vformat_to(std::back_inserter(s), f.str(), std::make_format_args(args...));
     } else {
-      s = std::vformat(std::forward<F>(format), std::make_format_args(args...));
+      std::vformat_to(std::back_inserter(s), std::forward<F>(format),
+                      std::make_format_args(args...));
     }
 
     // check the blacklist
-    for (const BlacklistEntry& entry : bl) {
-      ireplace_all(s, entry.filter, entry.replacement);
+    if (scrubber) {
+      scrubber->scrub(s);
     }
   } catch (std::format_error&) {
     s  = "format error while logging";
@@ -127,7 +234,11 @@ void doLog(spdlog::logger& logger, Levels lv,
     lv = Levels::Error;
   }
 
-  doLogImpl(logger, lv, s);
+  if (scrubber) {
+    doLogImpl(logger, ring, lv, category, s);
+  } else {
+    keepImpl(*ring, lv, s);
+  }
 }
 
 }  // namespace MOBase::log::details
@@ -171,6 +282,21 @@ struct Entry
 
 using Callback = void(Entry);
 
+// what an asynchronous logger does with a message when its queue is full
+//
+enum class OverflowPolicy
+{
+  // wait until the background thread has made room in the queue
+  Block,
+
+  // discard the message
+  Drop,
+
+  // discard the message and count it, the number of dropped messages is logged
+  // once the queue has room again, see Logger::droppedCount()
+  DropAndCount
+};
+
 struct LoggerConfiguration
 {
   std::string name;
@@ -178,6 +304,21 @@ struct LoggerConfiguration
   std::string pattern;
   bool utc = false;
   std::vector<BlacklistEntry> blacklist;
+
+  // when set, messages are queued and written to the console, file and callback
+  // by a background thread instead of the thread that logs them
+  bool async              = false;
+  std::size_t queueSize   = 8192;
+  OverflowPolicy overflow = OverflowPolicy::Block;
+
+  // number of messages kept in memory for crash reports, 0 to disable, see
+  // Logger::dumpCrashBuffer(); messages of crashBufferLevel and above are kept
+  // even when the level of the logger is higher
+  //
+  // those are still formatted, but then go straight to the crash buffer: they're
+  // not scrubbed and don't go through the sinks
+  std::size_t crashBufferSize = 0;
+  Levels crashBufferLevel     = Levels::Debug;
 };
 
 class QDLLEXPORT Logger
@@ -189,6 +330,16 @@ public:
   Levels level() const;
   void setLevel(Levels lv);
 
+  // whether messages of the given level are logged; this is checked before a message
+  // is formatted, so disabled levels only cost an atomic load
+  //
+  // this includes the messages only kept in the crash buffer
+  //
+  bool shouldLog(Levels lv) const noexcept
+  {
+    return lv >= m_level.load(std::memory_order_relaxed);
+  }
+
   void setPattern(const std::string& pattern);
   void setFile(const File& f);
   void setCallback(Callback* f);
@@ -197,6 +348,27 @@ public:
   void removeFromBlacklist(const std::string& filter);
   void resetBlacklist();
 
+  // writes all the pending messages of an asynchronous logger and flushes the
+  // sinks; this is the hook for crash handlers, which should call it before the
+  // process goes away
+  //
+  // this never waits forever: a thread that stalled while logging, typically the
+  // one that crashed, is given up on after a short time and its message is lost
+  //
+  void flush();
+
+  // number of messages dropped by an asynchronous logger because its queue was
+  // full, only counted with OverflowPolicy::DropAndCount
+  //
+  std::size_t droppedCount() const;
+
+  // writes the messages kept in memory to the given file, oldest first; crash
+  // handlers should call this after flush(), see LoggerConfiguration::crashBufferSize
+  //
+  // returns false if the crash buffer is disabled or the file can't be written
+  //
+  bool dumpCrashBuffer(const std::filesystem::path& file) const noexcept;
+
   template <class F, class... Args>
     requires(details::RuntimeFormatString<F, Args...>)
   void debug(F&& format, Args&&... args) noexcept
@@ -253,23 +425,65 @@ public:
     requires(details::RuntimeFormatString<F, Args...>)
   void log(Levels lv, F&& format, Args&&... args) noexcept
   {
-    details::doLog(*m_logger, lv, m_conf.blacklist, std::forward<F>(format),
-                   std::forward<Args>(args)...);
+    if (!shouldLog(lv)) {
+      return;
+    }
+
+    if (lv < m_sinksLevel.load(std::memory_order_relaxed)) {
+      details::doLog(*m_logger, m_ring.get(), lv, {}, nullptr,
+                     std::forward<F>(format), std::forward<Args>(args)...);
+      return;
+    }
+
+    const auto scrubber = m_scrubber.load(std::memory_order_acquire);
+    details::doLog(*m_logger, m_ring.get(), lv, {}, scrubber.get(),
+                   std::forward<F>(format), std::forward<Args>(args)...);
   }
 
   template <class... Args>
   void log(Levels lv, std::format_string<Args...> format, Args&&... args) noexcept
   {
-    details::doLog(*m_logger, lv, m_conf.blacklist, format,
+    if (!shouldLog(lv)) {
+      return;
+    }
+
+    if (lv < m_sinksLevel.load(std::memory_order_relaxed)) {
+      details::doLog(*m_logger, m_ring.get(), lv, {}, nullptr, format,
+                     std::forward<Args>(args)...);
+      return;
+    }
+
+    const auto scrubber = m_scrubber.load(std::memory_order_acquire);
+    details::doLog(*m_logger, m_ring.get(), lv, {}, scrubber.get(), format,
                    std::forward<Args>(args)...);
   }
 
 private:
+  friend class Category;
+
   LoggerConfiguration m_conf;
+
+  // lowest level logged, including the messages only kept in the crash buffer, so it
+  // can be checked inline, see shouldLog()
+  std::atomic<Levels> m_level;
+
+  // level of m_logger and its sinks; messages below it only go to the crash buffer
+  std::atomic<Levels> m_sinksLevel;
+
+  // compiled from m_conf.blacklist every time it changes; threads that log take a
+  // snapshot, so the blacklist can change while messages are being scrubbed
+  std::atomic<std::shared_ptr<const details::Scrubber>> m_scrubber;
+
   std::unique_ptr<spdlog::logger> m_logger;
   std::shared_ptr<spdlog::sinks::sink> m_sinks;
   std::shared_ptr<spdlog::sinks::sink> m_console, m_callback, m_file;
 
+  // queue in front of m_sinks for asynchronous loggers, null otherwise
+  std::shared_ptr<spdlog::sinks::sink> m_async;
+
+  // messages kept in memory, next to m_sinks or m_async; null when disabled
+  std::shared_ptr<spdlog::sinks::sink> m_ring;
+
   void createLogger(const std::string& name);
   void addSink(std::shared_ptr<spdlog::sinks::sink> sink);
 };
@@ -277,6 +491,133 @@ private:
 QDLLEXPORT void createDefault(LoggerConfiguration conf);
 QDLLEXPORT Logger& getDefault();
 
+// named source of messages with its own level, typically a static object in the
+// code that logs; messages are written to the default logger, prefixed by the name
+// of the category
+//
+// the level of a category is independent from the one of the logger: debug messages
+// of a single category can be enabled while the logger is at info, and messages of
+// a disabled level only cost an atomic load, so instrumentation can stay in the code
+//
+// a category follows the level of the default logger until it is given its own,
+// with setLevel() or setCategoryLevel()
+//
+class QDLLEXPORT Category
+{
+public:
+  explicit Category(std::string name);
+  Category(std::string name, Levels level);
+  ~Category();
+
+  Category(const Category&)            = delete;
+  Category& operator=(const Category&) = delete;
+
+  const std::string& name() const;
+
+  Levels level() const;
+  void setLevel(Levels lv);
+
+  // follows the level of the default logger again
+  //
+  void resetLevel();
+
+  bool shouldLog(Levels lv) const noexcept
+  {
+    const int own = m_level.load(std::memory_order_relaxed);
+    return lv >= (own == Inherit ? details::defaultLevel() : static_cast<Levels>(own));
+  }
+
+  template <class F, class... Args>
+    requires(details::RuntimeFormatString<F, Args...>)
+  void debug(F&& format, Args&&... args) noexcept
+  {
+    log(Debug, std::forward<F>(format), std::forward<Args>(args)...);
+  }
+
+  template <class... Args>
+  void debug(std::format_string<Args...> format, Args&&... args) noexcept
+  {
+    log(Debug, format, std::forward<Args>(args)...);
+  }
+
+  template <class F, class... Args>
+    requires(details::RuntimeFormatString<F, Args...>)
+  void info(F&& format, Args&&... args) noexcept
+  {
+    log(Info, std::forward<F>(format), std::forward<Args>(args)...);
+  }
+
+  template <class... Args>
+  void info(std::format_string<Args...> format, Args&&... args) noexcept
+  {
+    log(Info, format, std::forward<Args>(args)...);
+  }
+
+  template <class F, class... Args>
+    requires(details::RuntimeFormatString<F, Args...>)
+  void warn(F&& format, Args&&... args) noexcept
+  {
+    log(Warning, std::forward<F>(format), std::forward<Args>(args)...);
+  }
+
+  template <class... Args>
+  void warn(std::format_string<Args...> format, Args&&... args) noexcept
+  {
+    log(Warning, format, std::forward<Args>(args)...);
+  }
+
+  template <class F, class... Args>
+    requires(details::RuntimeFormatString<F, Args...>)
+  void error(F&& format, Args&&... args) noexcept
+  {
+    log(Error, std::forward<F>(format), std::forward<Args>(args)...);
+  }
+
+  template <class... Args>
+  void error(std::format_string<Args...> format, Args&&... args) noexcept
+  {
+    log(Error, format, std::forward<Args>(args)...);
+  }
+
+  template <class F, class... Args>
+    requires(details::RuntimeFormatString<F, Args...>)
+  void log(Levels lv, F&& format, Args&&... args) noexcept
+  {
+    if (!shouldLog(lv)) {
+      return;
+    }
+
+    Logger& logger      = getDefault();
+    const auto scrubber = logger.m_scrubber.load(std::memory_order_acquire);
+    details::doLog(*logger.m_logger, logger.m_ring.get(), lv, m_name, scrubber.get(),
+                   std::forward<F>(format), std::forward<Args>(args)...);
+  }
+
+  template <class... Args>
+  void log(Levels lv, std::format_string<Args...> format, Args&&... args) noexcept
+  {
+    if (!shouldLog(lv)) {
+      return;
+    }
+
+    Logger& logger      = getDefault();
+    const auto scrubber = logger.m_scrubber.load(std::memory_order_acquire);
+    details::doLog(*logger.m_logger, logger.m_ring.get(), lv, m_name, scrubber.get(),
+                   format, std::forward<Args>(args)...);
+  }
+
+private:
+  static constexpr int Inherit = -1;
+
+  std::string m_name;
+  std::atomic<int> m_level;
+};
+
+// sets the level of all the categories with the given name, including the ones
+// created later
+//
+QDLLEXPORT void setCategoryLevel(const std::string& name, Levels lv);
+
 template <class F, class... Args>
   requires(details::RuntimeFormatString<F, Args...>)
 void debug(F&& format, Args&&... args) noexcept
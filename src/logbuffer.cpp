@@ -0,0 +1,54 @@
+#include "log.h"
+
+#include <array>
+
+namespace MOBase::log::details
+{
+
+namespace
+{
+
+constexpr std::size_t MaxKeptCapacity = 64 * 1024;
+
+// buffers of the calling thread, one per nesting level of MessageBuffer
+//
+struct ThreadBuffers
+{
+  std::array<std::string, 4> buffers;
+  std::size_t used = 0;
+};
+
+ThreadBuffers& threadBuffers() noexcept
+{
+  thread_local ThreadBuffers buffers;
+  return buffers;
+}
+
+}  // namespace
+
+MessageBuffer::MessageBuffer() noexcept
+{
+  auto& tb = threadBuffers();
+
+  if (tb.used < tb.buffers.size()) {
+    m_buffer = &tb.buffers[tb.used];
+    m_buffer->clear();
+  } else {
+    m_buffer = &m_fallback;
+  }
+
+  // always incremented so the destructor doesn't need to know which one was used
+  ++tb.used;
+}
+
+MessageBuffer::~MessageBuffer()
+{
+  // a single huge message shouldn't keep its memory for the lifetime of the thread
+  if (m_buffer->capacity() > MaxKeptCapacity) {
+    std::string().swap(*m_buffer);
+  }
+
+  --threadBuffers().used;
+}
+
+}  // namespace MOBase::log::details
@@ -0,0 +1,100 @@
+#include "log.h"
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace MOBase::log
+{
+
+namespace
+{
+
+// categories that currently exist, and levels given by name with
+// setCategoryLevel()
+//
+struct CategoryRegistry
+{
+  std::mutex mutex;
+  std::vector<Category*> categories;
+  std::unordered_map<std::string, Levels> levels;
+};
+
+CategoryRegistry& registry()
+{
+  // never destroyed, categories are typically static objects that may be destroyed
+  // after it
+  static CategoryRegistry* r = new CategoryRegistry;
+  return *r;
+}
+
+void add(Category& c)
+{
+  auto& r = registry();
+  std::scoped_lock lock(r.mutex);
+
+  // a level given by name overrides the one given by the code
+  if (auto itor = r.levels.find(c.name()); itor != r.levels.end()) {
+    c.setLevel(itor->second);
+  }
+
+  r.categories.push_back(&c);
+}
+
+}  // namespace
+
+Category::Category(std::string name) : m_name(std::move(name)), m_level(Inherit)
+{
+  add(*this);
+}
+
+Category::Category(std::string name, Levels level)
+    : m_name(std::move(name)), m_level(level)
+{
+  add(*this);
+}
+
+Category::~Category()
+{
+  auto& r = registry();
+  std::scoped_lock lock(r.mutex);
+  std::erase(r.categories, this);
+}
+
+const std::string& Category::name() const
+{
+  return m_name;
+}
+
+Levels Category::level() const
+{
+  const int own = m_level.load(std::memory_order_relaxed);
+  return own == Inherit ? details::defaultLevel() : static_cast<Levels>(own);
+}
+
+void Category::setLevel(Levels lv)
+{
+  m_level.store(lv, std::memory_order_relaxed);
+}
+
+void Category::resetLevel()
+{
+  m_level.store(Inherit, std::memory_order_relaxed);
+}
+
+void setCategoryLevel(const std::string& name, Levels lv)
+{
+  auto& r = registry();
+  std::scoped_lock lock(r.mutex);
+
+  r.levels[name] = lv;
+
+  for (Category* c : r.categories) {
+    if (c->name() == name) {
+      c->setLevel(lv);
+    }
+  }
+}
+
+}  // namespace MOBase::log
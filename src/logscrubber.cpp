@@ -0,0 +1,187 @@
+#include "log.h"
+
+#include <deque>
+
+namespace MOBase::log::details
+{
+
+namespace
+{
+
+unsigned char fold(char c)
+{
+  const auto b = static_cast<unsigned char>(c);
+  return (b >= 'A' && b <= 'Z') ? static_cast<unsigned char>(b - 'A' + 'a') : b;
+}
+
+}  // namespace
+
+Scrubber::Scrubber(const std::vector<BlacklistEntry>& entries)
+{
+  // each byte that appears in a filter gets its own class, the others share class 0
+  // and always go back to the root, so the table stays small
+  for (const BlacklistEntry& e : entries) {
+    for (char c : e.filter) {
+      auto& cls = m_classes[fold(c)];
+      if (cls == 0) {
+        cls = static_cast<std::uint16_t>(m_classCount++);
+      }
+    }
+  }
+
+  const auto addState = [&](std::uint32_t depth) {
+    const auto state = static_cast<std::uint32_t>(m_depth.size());
+    m_next.resize(m_next.size() + m_classCount, 0);
+    m_depth.push_back(depth);
+    m_matchLength.push_back(0);
+    m_filter.push_back(-1);
+    return state;
+  };
+
+  addState(0);
+
+  // trie of the filters, 0 is used for missing edges since the root is never a child
+  for (const BlacklistEntry& e : entries) {
+    if (e.filter.empty()) {
+      continue;
+    }
+
+    std::uint32_t state = 0;
+    for (char c : e.filter) {
+      const std::size_t i = state * m_classCount + m_classes[fold(c)];
+      if (m_next[i] == 0) {
+        const std::uint32_t child = addState(m_depth[state] + 1);
+        m_next[i]                 = child;
+      }
+      state = m_next[i];
+    }
+
+    // a filter given twice keeps the last replacement
+    m_filter[state]      = static_cast<std::int32_t>(m_replacements.size());
+    m_matchLength[state] = m_depth[state];
+    m_replacements.push_back(e.replacement);
+  }
+
+  // failure links, breadth-first so the link of a state is always done before its
+  // children; missing edges are replaced by the transition of the failure state,
+  // which turns the trie into a complete automaton
+  std::vector<std::uint32_t> failure(m_depth.size(), 0);
+  std::deque<std::uint32_t> queue;
+
+  for (std::size_t c = 0; c < m_classCount; ++c) {
+    if (const std::uint32_t child = m_next[c]; child != 0) {
+      queue.push_back(child);
+    }
+  }
+
+  while (!queue.empty()) {
+    const std::uint32_t state = queue.front();
+    queue.pop_front();
+
+    const std::uint32_t fail = failure[state];
+
+    if (m_matchLength[state] == 0) {
+      // no filter ends here, but one may end at a suffix
+      m_matchLength[state] = m_matchLength[fail];
+    }
+
+    for (std::size_t c = 0; c < m_classCount; ++c) {
+      const std::size_t i      = state * m_classCount + c;
+      const std::uint32_t next = m_next[i];
+
+      if (next != 0 && m_depth[next] == m_depth[state] + 1) {
+        failure[next] = m_next[fail * m_classCount + c];
+        queue.push_back(next);
+      } else {
+        m_next[i] = m_next[fail * m_classCount + c];
+      }
+    }
+  }
+}
+
+void Scrubber::scrub(std::string& s) const
+{
+  if (m_replacements.empty()) {
+    return;
+  }
+
+  // the result is built in a buffer of the thread and swapped with the message, so
+  // both keep their capacity for the next messages
+  thread_local std::string out;
+  bool replaced = false;
+
+  // end of the last match, the scan restarts from the root there
+  std::size_t last    = 0;
+  std::uint32_t state = 0;
+
+  for (std::size_t i = 0; i < s.size(); ++i) {
+    state = m_next[state * m_classCount + m_classes[fold(s[i])]];
+
+    const std::uint32_t length = m_matchLength[state];
+    if (length == 0) {
+      continue;
+    }
+
+    // a filter ends here, but another one may start before it and end later, so
+    // the leftmost match is the first one found by starting from each position
+    // up to the start of this one
+    const std::size_t latest = i + 1 - length;
+
+    for (std::size_t start = last; start <= latest; ++start) {
+      std::int32_t filter   = -1;
+      const std::size_t len = anchoredMatch(s, start, filter);
+
+      if (len == 0) {
+        continue;
+      }
+
+      if (!replaced) {
+        out.clear();
+        replaced = true;
+      }
+
+      out.append(s, last, start - last);
+      out.append(m_replacements[static_cast<std::size_t>(filter)]);
+      last = start + len;
+      break;
+    }
+
+    // the loop increments it
+    i     = last - 1;
+    state = 0;
+  }
+
+  if (!replaced) {
+    return;
+  }
+
+  out.append(s, last);
+  s.swap(out);
+}
+
+std::size_t Scrubber::anchoredMatch(const std::string& s, std::size_t start,
+                                    std::int32_t& filter) const
+{
+  std::uint32_t state = 0;
+  std::size_t best    = 0;
+
+  for (std::size_t i = start; i < s.size(); ++i) {
+    const std::uint32_t next = m_next[state * m_classCount + m_classes[fold(s[i])]];
+
+    if (m_depth[next] != m_depth[state] + 1) {
+      // not an edge of the trie
+      break;
+    }
+
+    state = next;
+
+    if (m_filter[state] >= 0) {
+      best   = i + 1 - start;
+      filter = m_filter[state];
+    }
+  }
+
+  return best;
+}
+
+}  // namespace MOBase::log::details
@@ -0,0 +1,641 @@
+#include "logsinks.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <format>
+#include <string_view>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <spdlog/details/os.h>
+
+namespace MOBase::log::details
+{
+
+AsyncSink::AsyncSink(spdlog::sink_ptr target, std::string name, std::size_t capacity,
+                     OverflowPolicy policy)
+    : m_target(std::move(target)), m_name(std::move(name)), m_policy(policy),
+      m_enqueue(0), m_written(0), m_signal(0), m_skipBefore(0), m_producers(0),
+      m_stopped(false), m_exit(false), m_dropped(0), m_droppedTotal(0)
+{
+  // slots are indexed by masking the position
+  capacity = std::bit_ceil(std::max<std::size_t>(capacity, 2));
+
+  m_slots.reset(new Slot[capacity]);
+  m_mask = capacity - 1;
+
+  for (std::size_t i = 0; i < capacity; ++i) {
+    m_slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  m_thread = std::thread([this] {
+    run();
+  });
+}
+
+AsyncSink::~AsyncSink()
+{
+  stop();
+}
+
+void AsyncSink::log(const spdlog::details::log_msg& m)
+{
+  if (std::this_thread::get_id() == m_thread.get_id()) {
+    // logging from a sink, typically a log callback; the background thread cannot
+    // wait on its own queue, ignoring
+    return;
+  }
+
+  // this must be visible to stop() before m_stopped is checked
+  m_producers.fetch_add(1);
+
+  if (m_stopped.load()) {
+    m_producers.fetch_sub(1);
+    m_target->log(m);
+    return;
+  }
+
+  bool pushed = tryPush(m);
+
+  if (!pushed) {
+    switch (m_policy) {
+    case OverflowPolicy::Block: {
+      while (!pushed) {
+        // the background thread bumps m_written for every message, so if it
+        // changed between the load and the wait, there is room again
+        const std::size_t written = m_written.load(std::memory_order_acquire);
+        pushed                    = tryPush(m);
+
+        if (!pushed) {
+          m_written.wait(written, std::memory_order_acquire);
+        }
+      }
+      break;
+    }
+
+    case OverflowPolicy::DropAndCount: {
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+      m_droppedTotal.fetch_add(1, std::memory_order_relaxed);
+      break;
+    }
+
+    case OverflowPolicy::Drop:  // fall-through
+    default:
+      break;
+    }
+  }
+
+  m_producers.fetch_sub(1, std::memory_order_release);
+
+  if (pushed) {
+    m_signal.fetch_add(1, std::memory_order_release);
+    m_signal.notify_one();
+  }
+}
+
+void AsyncSink::flush()
+{
+  if (std::this_thread::get_id() == m_thread.get_id()) {
+    // see log()
+    return;
+  }
+
+  if (!m_stopped.load()) {
+    // positions below this have been claimed by a producer, they're either written
+    // or about to be
+    if (!waitForWritten(m_enqueue.load(std::memory_order_acquire))) {
+      // the background thread is stuck in the target, which is locked
+      return;
+    }
+  }
+
+  m_target->flush();
+}
+
+void AsyncSink::set_pattern(const std::string& pattern)
+{
+  m_target->set_pattern(pattern);
+}
+
+void AsyncSink::set_formatter(std::unique_ptr<spdlog::formatter> f)
+{
+  m_target->set_formatter(std::move(f));
+}
+
+void AsyncSink::stop()
+{
+  if (m_stopped.exchange(true)) {
+    // already stopped
+    return;
+  }
+
+  // producers that are already in log() push their message in the queue, those
+  // that come after will see m_stopped and write it themselves
+  //
+  // on Windows, other threads are killed by ExitProcess() before static loggers are
+  // destroyed, and may have died in log(); this gives up on them once the queue
+  // makes no progress for StallTimeout
+  std::size_t written = m_written.load(std::memory_order_acquire);
+  auto deadline       = std::chrono::steady_clock::now() + StallTimeout;
+
+  while (m_producers.load() != 0) {
+    if (const std::size_t w = m_written.load(std::memory_order_acquire); w != written) {
+      written  = w;
+      deadline = std::chrono::steady_clock::now() + StallTimeout;
+    } else if (std::chrono::steady_clock::now() >= deadline) {
+      skipStalled(m_enqueue.load(std::memory_order_acquire));
+      break;
+    }
+
+    std::this_thread::yield();
+  }
+
+  m_exit.store(true, std::memory_order_release);
+  m_signal.fetch_add(1, std::memory_order_release);
+  m_signal.notify_one();
+
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+}
+
+std::size_t AsyncSink::dropped() const
+{
+  return m_droppedTotal.load(std::memory_order_relaxed);
+}
+
+bool AsyncSink::tryPush(const spdlog::details::log_msg& m)
+{
+  std::size_t pos = m_enqueue.load(std::memory_order_relaxed);
+
+  for (;;) {
+    Slot& slot            = m_slots[pos & m_mask];
+    const std::size_t seq = slot.sequence.load(std::memory_order_acquire);
+
+    if (seq & Writing) {
+      if ((seq & ~Writing) != pos) {
+        // the message from the previous lap is still being written, the queue is
+        // full
+        return false;
+      }
+
+      // another producer claimed this position
+      pos = m_enqueue.load(std::memory_order_relaxed);
+      continue;
+    }
+
+    const std::ptrdiff_t dif = static_cast<std::ptrdiff_t>(seq - pos);
+
+    if (dif == 0) {
+      // the slot is free, claim it
+      if (!m_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        continue;
+      }
+
+      // the background thread may have skipped the slot if this thread stalled
+      // between the claim and here, see skipStalled(); the message goes in the next
+      // free slot instead
+      std::size_t expected = pos;
+      if (!slot.sequence.compare_exchange_strong(expected, pos | Writing,
+                                                 std::memory_order_acquire)) {
+        pos = m_enqueue.load(std::memory_order_relaxed);
+        continue;
+      }
+
+      // the slot is published even if the copy fails, or the background thread
+      // would stop at it; the message is lost
+      try {
+        slot.msg   = spdlog::details::log_msg_buffer(m);
+        slot.empty = false;
+      } catch (...) {
+        slot.empty = true;
+      }
+
+      slot.sequence.store(pos + 1, std::memory_order_release);
+      return true;
+    } else if (dif < 0) {
+      // the slot still holds the message from the previous lap, the queue is full
+      return false;
+    } else {
+      // another producer claimed this position
+      pos = m_enqueue.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+std::size_t AsyncSink::drain()
+{
+  std::size_t count = 0;
+  std::size_t pos   = m_written.load(std::memory_order_relaxed);
+
+  for (;;) {
+    Slot& slot = m_slots[pos & m_mask];
+    if (slot.sequence.load(std::memory_order_acquire) != pos + 1) {
+      if (pos >= m_skipBefore.load(std::memory_order_acquire)) {
+        // empty, or the producer hasn't finished writing the message yet
+        break;
+      }
+
+      // the producer stalled, see skipStalled(); the slot can only be skipped if
+      // it hasn't started writing the message, and is then freed for the next lap,
+      // otherwise the producer is still copying it or died doing so
+      std::size_t expected = pos;
+      if (!slot.sequence.compare_exchange_strong(expected, pos + m_mask + 1,
+                                                 std::memory_order_acq_rel)) {
+        if (expected == pos + 1) {
+          // published in the meantime
+          continue;
+        }
+
+        break;
+      }
+
+      ++pos;
+      m_written.store(pos, std::memory_order_release);
+      m_written.notify_all();
+      continue;
+    }
+    if (!slot.empty) {
+      try {
+        m_target->log(slot.msg);
+      } catch (std::exception& e) {
+        std::fprintf(stderr, "failed to write log message, %s\n", e.what());
+      } catch (...) {
+        std::fprintf(stderr, "failed to write log message\n");
+      }
+    }
+
+    // frees the slot for the next lap
+    slot.sequence.store(pos + m_mask + 1, std::memory_order_release);
+
+    ++pos;
+    ++count;
+
+    if (m_slots[pos & m_mask].sequence.load(std::memory_order_acquire) != pos + 1) {
+      // the queue is empty, this is done before releasing flush() so the report is
+      // written by the time it returns
+      reportDropped();
+    }
+
+    m_written.store(pos, std::memory_order_release);
+    m_written.notify_all();
+  }
+
+  return count;
+}
+
+bool AsyncSink::waitForWritten(std::size_t end)
+{
+  using namespace std::chrono_literals;
+
+  std::size_t written = m_written.load(std::memory_order_acquire);
+  auto deadline       = std::chrono::steady_clock::now() + StallTimeout;
+  bool skipped        = false;
+
+  // polls instead of waiting on m_written, which can't time out
+  while (written < end) {
+    std::this_thread::sleep_for(1ms);
+
+    if (const std::size_t w = m_written.load(std::memory_order_acquire); w != written) {
+      written  = w;
+      deadline = std::chrono::steady_clock::now() + StallTimeout;
+      skipped  = false;
+      continue;
+    }
+
+    if (std::chrono::steady_clock::now() < deadline) {
+      continue;
+    }
+
+    if (skipped) {
+      // skipping didn't help, the background thread itself is stuck
+      return false;
+    }
+
+    // a producer claimed a slot and never published it, typically because it is
+    // the thread that crashed
+    skipStalled(end);
+    skipped  = true;
+    deadline = std::chrono::steady_clock::now() + StallTimeout;
+  }
+
+  return true;
+}
+
+void AsyncSink::skipStalled(std::size_t end)
+{
+  m_skipBefore.store(end, std::memory_order_release);
+  m_signal.fetch_add(1, std::memory_order_release);
+  m_signal.notify_one();
+}
+
+void AsyncSink::reportDropped()
+{
+  const std::size_t n = m_dropped.exchange(0, std::memory_order_relaxed);
+  if (n == 0) {
+    return;
+  }
+
+  try {
+    const std::string s =
+        std::format("{} log messages were dropped, the queue was full", n);
+    m_target->log(spdlog::details::log_msg(m_name, spdlog::level::warn, s));
+  } catch (...) {
+    // eat it
+  }
+}
+
+void AsyncSink::run()
+{
+  for (;;) {
+    // loaded before draining so a message pushed after drain() returns is not
+    // missed by the wait below
+    const std::uint32_t signal = m_signal.load(std::memory_order_acquire);
+
+    if (drain() > 0) {
+      try {
+        m_target->flush();
+      } catch (...) {
+        // eat it
+      }
+
+      continue;
+    }
+
+    if (m_exit.load(std::memory_order_acquire)) {
+      // stop() waited for all the producers, so the queue is empty
+      break;
+    }
+
+    m_signal.wait(signal, std::memory_order_acquire);
+  }
+
+  reportDropped();
+
+  try {
+    m_target->flush();
+  } catch (...) {
+    // eat it
+  }
+}
+
+namespace
+{
+
+// file written by RingSink::dump() with the system calls, since the process may be
+// crashing and the heap may be corrupted
+//
+class DumpFile
+{
+public:
+  ~DumpFile() { close(); }
+
+  bool open(const std::filesystem::path& file) noexcept
+  {
+#ifdef _WIN32
+    m_handle = ::CreateFileW(file.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                             CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    return m_handle != INVALID_HANDLE_VALUE;
+#else
+    m_fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    return m_fd >= 0;
+#endif
+  }
+
+  bool write(const char* data, std::size_t size) noexcept
+  {
+    while (size > 0) {
+#ifdef _WIN32
+      DWORD written = 0;
+      if (!::WriteFile(m_handle, data, static_cast<DWORD>(size), &written, nullptr)) {
+        return false;
+      }
+#else
+      const ssize_t written = ::write(m_fd, data, size);
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return false;
+      }
+#endif
+      data += written;
+      size -= static_cast<std::size_t>(written);
+    }
+
+    return true;
+  }
+
+  bool close() noexcept
+  {
+#ifdef _WIN32
+    if (m_handle == INVALID_HANDLE_VALUE) {
+      return false;
+    }
+    const bool ok = ::CloseHandle(m_handle) != FALSE;
+    m_handle      = INVALID_HANDLE_VALUE;
+    return ok;
+#else
+    if (m_fd < 0) {
+      return false;
+    }
+    const bool ok = ::close(m_fd) == 0;
+    m_fd          = -1;
+    return ok;
+#endif
+  }
+
+private:
+#ifdef _WIN32
+  HANDLE m_handle = INVALID_HANDLE_VALUE;
+#else
+  int m_fd = -1;
+#endif
+};
+
+// formats a line of the dump in a fixed buffer, truncating it if it does not fit
+//
+class LineWriter
+{
+public:
+  LineWriter(char* buffer, std::size_t capacity)
+      : m_buffer(buffer), m_capacity(capacity), m_size(0)
+  {}
+
+  std::size_t size() const { return m_size; }
+
+  void put(std::string_view s)
+  {
+    const auto n = std::min(s.size(), m_capacity - m_size);
+    std::memcpy(m_buffer + m_size, s.data(), n);
+    m_size += n;
+  }
+
+  // writes the given number in decimal, padded with zeros to the given width
+  //
+  template <class T>
+  void number(T value, std::size_t width)
+  {
+    auto v = static_cast<std::uint64_t>(value);
+
+    char digits[20];
+    std::size_t n = 0;
+    do {
+      digits[sizeof(digits) - ++n] = static_cast<char>('0' + v % 10);
+      v /= 10;
+    } while (v != 0);
+
+    for (; width > n; --width) {
+      put("0");
+    }
+    put(std::string_view(digits + sizeof(digits) - n, n));
+  }
+
+private:
+  char* m_buffer;
+  std::size_t m_capacity;
+  std::size_t m_size;
+};
+
+}  // namespace
+
+RingSink::RingSink(std::size_t capacity)
+    : m_slots(new Slot[std::max<std::size_t>(capacity, 1)]),
+      m_capacity(std::max<std::size_t>(capacity, 1)), m_next(0)
+{}
+
+void RingSink::log(const spdlog::details::log_msg& m)
+{
+  write(m.time, m.thread_id, m.level,
+        std::string_view(m.payload.data(), m.payload.size()));
+}
+
+void RingSink::keep(spdlog::level::level_enum level, std::string_view text) noexcept
+{
+  write(std::chrono::system_clock::now(), spdlog::details::os::thread_id(), level,
+        text);
+}
+
+void RingSink::write(std::chrono::system_clock::time_point time, std::size_t thread,
+                     spdlog::level::level_enum level, std::string_view text) noexcept
+{
+  const std::uint64_t pos = m_next.fetch_add(1, std::memory_order_relaxed);
+  Slot& slot              = m_slots[pos % m_capacity];
+
+  // if the ring wraps around while another thread is still writing in this slot,
+  // both messages end up mixed; this needs as many threads logging at the same
+  // time as there are slots
+  //
+  // the exchange orders this write after the one of the previous lap
+  slot.sequence.exchange(2 * pos + 1, std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot.time   = time;
+  slot.thread = thread;
+  slot.level  = level;
+  slot.size   = text.size();
+  std::memcpy(slot.text, text.data(), std::min(text.size(), MaxText));
+
+  slot.sequence.store(2 * pos + 2, std::memory_order_release);
+}
+
+void RingSink::flush()
+{
+  // no-op
+}
+
+void RingSink::set_pattern(const std::string&)
+{
+  // messages are formatted by dump()
+}
+
+void RingSink::set_formatter(std::unique_ptr<spdlog::formatter>)
+{
+  // messages are formatted by dump()
+}
+
+bool RingSink::dump(const std::filesystem::path& file) const noexcept
+{
+  DumpFile out;
+  if (!out.open(file)) {
+    return false;
+  }
+
+  const std::uint64_t end   = m_next.load(std::memory_order_acquire);
+  const std::uint64_t begin = end > m_capacity ? end - m_capacity : 0;
+
+  std::array<char, MaxText> text;
+  std::array<char, MaxText + 128> line;
+  bool ok = true;
+
+  for (std::uint64_t pos = begin; pos < end && ok; ++pos) {
+    const Slot& slot = m_slots[pos % m_capacity];
+
+    const std::uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence != 2 * pos + 2) {
+      // still being written, or already overwritten
+      continue;
+    }
+
+    const auto time   = slot.time;
+    const auto thread = slot.thread;
+    const auto level  = slot.level;
+    const auto size   = slot.size;
+    const auto length = std::min(size, MaxText);
+    std::memcpy(text.data(), slot.text, length);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+      // overwritten while it was copied
+      continue;
+    }
+
+    // "[2024-01-31 12:34:56.789 UTC] [thread] [level] text\n"
+    const auto ms   = std::chrono::floor<std::chrono::milliseconds>(time);
+    const auto day  = std::chrono::floor<std::chrono::days>(ms);
+    const auto date = std::chrono::year_month_day(day);
+    const auto hms  = std::chrono::hh_mm_ss(ms - day);
+    const auto lv   = spdlog::level::to_string_view(level);
+
+    LineWriter w(line.data(), line.size());
+    w.put("[");
+    w.number(static_cast<int>(date.year()), 4);
+    w.put("-");
+    w.number(static_cast<unsigned>(date.month()), 2);
+    w.put("-");
+    w.number(static_cast<unsigned>(date.day()), 2);
+    w.put(" ");
+    w.number(hms.hours().count(), 2);
+    w.put(":");
+    w.number(hms.minutes().count(), 2);
+    w.put(":");
+    w.number(hms.seconds().count(), 2);
+    w.put(".");
+    w.number(hms.subseconds().count(), 3);
+    w.put(" UTC] [");
+    w.number(thread, 1);
+    w.put("] [");
+    w.put(std::string_view(lv.data(), lv.size()));
+    w.put("] ");
+    w.put(std::string_view(text.data(), length));
+    w.put(size > length ? "...\n" : "\n");
+
+    ok = out.write(line.data(), w.size());
+  }
+
+  return out.close() && ok;
+}
+
+}  // namespace MOBase::log::details
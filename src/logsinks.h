@@ -0,0 +1,194 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// must match the definition used by the rest of uibase
+#ifdef _WIN32
+#define SPDLOG_WCHAR_FILENAMES 1
+#endif
+
+#include <spdlog/details/log_msg_buffer.h>
+#include <spdlog/sinks/sink.h>
+
+#include "log.h"
+
+namespace MOBase::log::details
+{
+
+// sink used by asynchronous loggers, queues messages in a bounded ring buffer and
+// writes them to the target sink from a background thread
+//
+// the queue is lock-free for the threads that log: they only compete for the index
+// of the next slot and never wait on the file or callback sinks, unless the queue
+// is full and the overflow policy is OverflowPolicy::Block; the background thread is
+// the only consumer
+//
+// the target is flushed every time the queue becomes empty, and flush() waits until
+// everything that was logged before it has been written
+//
+// flush() and stop() never wait forever: when the queue makes no progress for
+// StallTimeout, the slots that were claimed by a producer but not written yet are
+// skipped, which handles producers that crashed or were killed while the process
+// was exiting; a producer that was only preempted notices that its slot was skipped
+// and claims another one
+//
+class AsyncSink : public spdlog::sinks::sink
+{
+public:
+  static constexpr std::chrono::milliseconds StallTimeout{500};
+
+  // the capacity is rounded up to a power of two
+  //
+  AsyncSink(spdlog::sink_ptr target, std::string name, std::size_t capacity,
+            OverflowPolicy policy);
+
+  ~AsyncSink() override;
+
+  void log(const spdlog::details::log_msg& m) override;
+  void flush() override;
+  void set_pattern(const std::string& pattern) override;
+  void set_formatter(std::unique_ptr<spdlog::formatter> f) override;
+
+  // writes all the queued messages and stops the background thread; messages logged
+  // after this are written synchronously
+  //
+  void stop();
+
+  // number of messages dropped because the queue was full, only counted with
+  // OverflowPolicy::DropAndCount
+  //
+  std::size_t dropped() const;
+
+private:
+  // set in the sequence of a slot while a producer writes its message
+  static constexpr std::size_t Writing = ~(~std::size_t(0) >> 1);
+
+  struct Slot
+  {
+    // equal to the position of the slot when it is free or claimed, to the position
+    // | Writing while the message is copied, and to the position + 1 once it has
+    // been written; skipped slots are freed for the next lap
+    std::atomic<std::size_t> sequence;
+    spdlog::details::log_msg_buffer msg;
+
+    // set when the message could not be copied, the slot is skipped
+    bool empty = false;
+  };
+
+  spdlog::sink_ptr m_target;
+  std::string m_name;
+  OverflowPolicy m_policy;
+
+  std::unique_ptr<Slot[]> m_slots;
+  std::size_t m_mask;
+
+  // next position to write, shared by all the producers
+  alignas(64) std::atomic<std::size_t> m_enqueue;
+
+  // number of messages written to the target or skipped, only modified by the
+  // background thread; producers wait on it when the queue is full, and flush()
+  // until it reaches the messages logged before it
+  alignas(64) std::atomic<std::size_t> m_written;
+
+  // bumped by producers after each message to wake up the background thread
+  alignas(64) std::atomic<std::uint32_t> m_signal;
+
+  // slots below this position that are not published are skipped by the background
+  // thread, see skipStalled()
+  std::atomic<std::size_t> m_skipBefore;
+
+  // number of threads currently in log(), stop() waits for them before stopping the
+  // background thread
+  std::atomic<std::size_t> m_producers;
+
+  std::atomic<bool> m_stopped;
+  std::atomic<bool> m_exit;
+
+  std::atomic<std::size_t> m_dropped, m_droppedTotal;
+
+  std::thread m_thread;
+
+  bool tryPush(const spdlog::details::log_msg& m);
+  std::size_t drain();
+
+  // waits until the messages below the given position have been written, skipping
+  // the ones of stalled producers; returns false if the background thread is stuck
+  //
+  bool waitForWritten(std::size_t end);
+
+  // makes the background thread skip the slots below the given position that were
+  // claimed but in which the producer hasn't started writing
+  //
+  void skipStalled(std::size_t end);
+
+  void reportDropped();
+  void run();
+};
+
+// sink that keeps the last messages in memory, so they can be written to a file when
+// the process crashes, see Logger::dumpCrashBuffer()
+//
+// messages are copied into a fixed array of slots without locking or allocating;
+// formatting is only done when the buffer is dumped
+//
+class RingSink : public spdlog::sinks::sink
+{
+public:
+  // longest message kept, longer ones are truncated
+  static constexpr std::size_t MaxText = 448;
+
+  explicit RingSink(std::size_t capacity);
+
+  void log(const spdlog::details::log_msg& m) override;
+  void flush() override;
+  void set_pattern(const std::string& pattern) override;
+  void set_formatter(std::unique_ptr<spdlog::formatter> f) override;
+
+  // adds a message without going through a logger, for the messages that are only
+  // kept in the crash buffer; the level of the sink is not checked
+  //
+  void keep(spdlog::level::level_enum level, std::string_view text) noexcept;
+
+  // writes the messages in the buffer to the given file, oldest first; messages
+  // that are being overwritten while this runs are skipped
+  //
+  // this does not allocate and only uses system calls to write the file, so it can
+  // be called from a crash handler
+  //
+  bool dump(const std::filesystem::path& file) const noexcept;
+
+private:
+  struct alignas(64) Slot
+  {
+    // 2 * position + 1 while a message is written in the slot, 2 * position + 2
+    // once it is complete, 0 if the slot has never been used
+    std::atomic<std::uint64_t> sequence{0};
+
+    std::chrono::system_clock::time_point time;
+    std::size_t thread              = 0;
+    spdlog::level::level_enum level = spdlog::level::info;
+
+    // size of the whole message, only the first MaxText bytes are kept
+    std::size_t size = 0;
+    char text[MaxText];
+  };
+
+  std::unique_ptr<Slot[]> m_slots;
+  std::size_t m_capacity;
+
+  // position of the next message
+  alignas(64) std::atomic<std::uint64_t> m_next;
+
+  void write(std::chrono::system_clock::time_point time, std::size_t thread,
+             spdlog::level::level_enum level, std::string_view text) noexcept;
+};
+
+}  // namespace MOBase::log::details
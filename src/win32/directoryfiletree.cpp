@@ -0,0 +1,185 @@
+#include "directoryfiletree.h"
+
+#include <optional>
+#include <string>
+#include <tuple>
+
+#include <QDir>
+
+#include <Windows.h>
+
+#include "log.h"
+
+namespace MOBase
+{
+
+struct DirectoryFileTree::Root
+{
+  QString path;
+};
+
+namespace
+{
+
+// Absolute native path of the given path relative to the given root, prefixed to
+// support long paths:
+std::wstring nativePath(QString const& root, QString const& path)
+{
+  QString absolute = QDir::toNativeSeparators(
+      path.isEmpty() ? root : QDir::cleanPath(root + "/" + path));
+  if (!absolute.startsWith("\\\\")) {
+    absolute.prepend("\\\\?\\");
+  }
+  return absolute.toStdWString();
+}
+
+QDateTime toDateTime(FILETIME const& time)
+{
+  // FILETIME counts 100-nanosecond intervals since January 1, 1601:
+  ULARGE_INTEGER t;
+  t.LowPart  = time.dwLowDateTime;
+  t.HighPart = time.dwHighDateTime;
+  return QDateTime::fromMSecsSinceEpoch(
+      static_cast<qint64>((t.QuadPart - 116444736000000000ULL) / 10000));
+}
+
+// Volume and index of the file at the given path, following links:
+std::optional<std::tuple<DWORD, DWORD, DWORD>> fileId(std::wstring const& path)
+{
+  const DWORD share = FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE;
+  HANDLE handle     = CreateFileW(path.c_str(), 0, share, nullptr, OPEN_EXISTING,
+                                  FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+  if (handle == INVALID_HANDLE_VALUE) {
+    return {};
+  }
+
+  BY_HANDLE_FILE_INFORMATION info;
+  const BOOL ok = GetFileInformationByHandle(handle, &info);
+  CloseHandle(handle);
+  if (!ok) {
+    return {};
+  }
+  return std::tuple{info.dwVolumeSerialNumber, info.nFileIndexHigh,
+                    info.nFileIndexLow};
+}
+
+// Whether the directory with the given identity is the directory at the given path,
+// relative to the given root, or one of its parents, in which case following a link
+// to it would never end:
+bool isAncestor(QString const& root, QString path,
+                std::tuple<DWORD, DWORD, DWORD> const& target)
+{
+  while (true) {
+    if (fileId(nativePath(root, path)) == target) {
+      return true;
+    }
+    if (path.isEmpty()) {
+      return false;
+    }
+    const qsizetype slash = path.lastIndexOf('/');
+    path.truncate(slash < 0 ? 0 : slash);
+  }
+}
+
+}  // namespace
+
+std::shared_ptr<DirectoryFileTree> DirectoryFileTree::create(QString const& path)
+{
+  const QString absolute = QDir(path).absolutePath();
+
+  const DWORD attributes = GetFileAttributesW(nativePath(absolute, "").c_str());
+  if (attributes == INVALID_FILE_ATTRIBUTES ||
+      (attributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+    log::warn("failed to open directory '{}': error {}", path, GetLastError());
+    return nullptr;
+  }
+
+  std::shared_ptr<const Root> root(new Root{absolute});
+  return std::shared_ptr<DirectoryFileTree>(
+      new DirectoryFileTree(nullptr, "", std::move(root), ""));
+}
+
+std::optional<DirectoryFileTree::Metadata>
+DirectoryFileTree::metadata(FileTreeEntry const& entry)
+{
+  std::shared_ptr<const DirectoryFileTree> tree;
+  const QString path = diskPath(entry, tree);
+  if (path.isNull()) {
+    return {};
+  }
+
+  WIN32_FILE_ATTRIBUTE_DATA data;
+  if (!GetFileAttributesExW(nativePath(tree->m_Root->path, path).c_str(),
+                            GetFileExInfoStandard, &data) ||
+      ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) != entry.isDir()) {
+    return {};
+  }
+
+  return Metadata{(static_cast<qint64>(data.nFileSizeHigh) << 32) | data.nFileSizeLow,
+                  toDateTime(data.ftLastWriteTime)};
+}
+
+QString DirectoryFileTree::rootPath() const
+{
+  return m_Root->path;
+}
+
+bool DirectoryFileTree::doPopulate(
+    std::shared_ptr<const IFileTree> parent,
+    std::vector<std::shared_ptr<FileTreeEntry>>& entries) const
+{
+  if (m_Path.isNull()) {
+    return true;
+  }
+
+  // FindExInfoBasic skips the short names, and FIND_FIRST_EX_LARGE_FETCH reads the
+  // directory with fewer, larger, requests:
+  const std::wstring pattern = nativePath(m_Root->path, m_Path) + L"\\*";
+  WIN32_FIND_DATAW data;
+  HANDLE handle = FindFirstFileExW(pattern.c_str(), FindExInfoBasic, &data,
+                                   FindExSearchNameMatch, nullptr,
+                                   FIND_FIRST_EX_LARGE_FETCH);
+  if (handle == INVALID_HANDLE_VALUE) {
+    const DWORD error = GetLastError();
+    if (error != ERROR_FILE_NOT_FOUND) {
+      log::warn("failed to read directory '{}/{}': error {}", m_Root->path, m_Path,
+                error);
+    }
+    return true;
+  }
+
+  do {
+    const QString name = QString::fromWCharArray(data.cFileName);
+    if (name == "." || name == "..") {
+      continue;
+    }
+
+    // Links and junctions to a directory containing them would make the tree
+    // infinite, they are the only directories that need to be opened:
+    if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
+        (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
+      const QString path = m_Path.isEmpty() ? name : m_Path + "/" + name;
+      const auto id      = fileId(nativePath(m_Root->path, path));
+      if (id && isAncestor(m_Root->path, m_Path, *id)) {
+        log::debug("ignoring '{}/{}', which links to one of its parents",
+                   m_Root->path, path);
+        continue;
+      }
+    }
+
+    if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+      entries.push_back(std::shared_ptr<DirectoryFileTree>(new DirectoryFileTree(
+          parent, name, m_Root, m_Path.isEmpty() ? name : m_Path + "/" + name)));
+    } else {
+      entries.push_back(makeDiskFile(parent, name));
+    }
+  } while (FindNextFileW(handle, &data));
+
+  FindClose(handle);
+
+  // Directory listings are not sorted the same way as trees:
+  sortEntries(entries);
+  return true;
+}
+
+}  // namespace MOBase
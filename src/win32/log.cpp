@@ -1,6 +1,7 @@
 #include "log.h"
 #include "pch.h"
 #include "utility.h"
+#include <algorithm>
 #include <iostream>
 
 #pragma warning(push)
@@ -20,6 +21,8 @@
 #include <spdlog/sinks/stdout_color_sinks.h>
 #pragma warning(pop)
 
+#include "logsinks.h"
+
 namespace MOBase::log
 {
 
@@ -190,29 +193,46 @@ spdlog::sink_ptr createFileSink(const File& f)
   }
 }
 
-Logger::Logger(LoggerConfiguration conf_moved) : m_conf(std::move(conf_moved))
+Logger::Logger(LoggerConfiguration conf_moved)
+    : m_conf(std::move(conf_moved)), m_level(m_conf.maxLevel),
+      m_sinksLevel(m_conf.maxLevel),
+      m_scrubber(std::make_shared<const details::Scrubber>(m_conf.blacklist))
 {
   createLogger(m_conf.name);
 
   const auto timeType =
       m_conf.utc ? spdlog::pattern_time_type::utc : spdlog::pattern_time_type::local;
 
-  m_logger->set_level(toSpdlog(m_conf.maxLevel));
+  setLevel(m_conf.maxLevel);
   m_logger->set_pattern(m_conf.pattern, timeType);
-  m_logger->flush_on(spdlog::level::trace);
+
+  // asynchronous loggers flush when their queue is empty, flushing after each
+  // message would wait for the background thread every time
+  m_logger->flush_on(m_async ? spdlog::level::off : spdlog::level::trace);
 }
 
-// anchor
-Logger::~Logger() = default;
+Logger::~Logger()
+{
+  // the background thread may still be writing to the sinks, and calling the
+  // callback
+  if (m_async) {
+    static_cast<details::AsyncSink*>(m_async.get())->stop();
+  }
+}
 
 Levels Logger::level() const
 {
-  return fromSpdlog(m_logger->level());
+  return m_sinksLevel.load(std::memory_order_relaxed);
 }
 
 void Logger::setLevel(Levels lv)
 {
+  // messages below the given level that are kept in the crash buffer are written
+  // to it directly, without going through m_logger, see log()
   m_logger->set_level(toSpdlog(lv));
+  m_sinksLevel.store(lv, std::memory_order_relaxed);
+  m_level.store(m_ring ? std::min(lv, m_conf.crashBufferLevel) : lv,
+                std::memory_order_relaxed);
 }
 
 void Logger::setPattern(const std::string& s)
@@ -270,6 +290,9 @@ void Logger::addToBlacklist(const std::string& filter, const std::string& replac
   if (!present) {
     m_conf.blacklist.push_back(BlacklistEntry(filter, replacement));
   }
+
+  m_scrubber.store(std::make_shared<const details::Scrubber>(m_conf.blacklist),
+                   std::memory_order_release);
 }
 
 void Logger::removeFromBlacklist(const std::string& filter)
@@ -286,11 +309,43 @@ void Logger::removeFromBlacklist(const std::string& filter)
       ++it;
     }
   }
+
+  m_scrubber.store(std::make_shared<const details::Scrubber>(m_conf.blacklist),
+                   std::memory_order_release);
 }
 
 void Logger::resetBlacklist()
 {
   m_conf.blacklist.clear();
+  m_scrubber.store(std::make_shared<const details::Scrubber>(),
+                   std::memory_order_release);
+}
+
+void Logger::flush()
+{
+  try {
+    m_logger->flush();
+  } catch (...) {
+    // eat it
+  }
+}
+
+std::size_t Logger::droppedCount() const
+{
+  if (!m_async) {
+    return 0;
+  }
+
+  return static_cast<details::AsyncSink*>(m_async.get())->dropped();
+}
+
+bool Logger::dumpCrashBuffer(const std::filesystem::path& file) const noexcept
+{
+  if (!m_ring) {
+    return false;
+  }
+
+  return static_cast<details::RingSink*>(m_ring.get())->dump(file);
 }
 
 void Logger::createLogger(const std::string& name)
@@ -310,7 +365,22 @@ void Logger::createLogger(const std::string& name)
     addSink(m_console);
   }
 
-  m_logger.reset(new spdlog::logger(name, m_sinks));
+  if (m_conf.async) {
+    m_async = std::make_shared<details::AsyncSink>(m_sinks, name, m_conf.queueSize,
+                                                   m_conf.overflow);
+  }
+
+  auto target = m_async ? m_async : m_sinks;
+
+  if (m_conf.crashBufferSize > 0) {
+    // the ring is not behind the queue of asynchronous loggers, so it has the
+    // messages that were not written yet when the process crashes
+    m_ring = std::make_shared<details::RingSink>(m_conf.crashBufferSize);
+    m_ring->set_level(toSpdlog(m_conf.crashBufferLevel));
+    m_logger.reset(new spdlog::logger(name, {target, m_ring}));
+  } else {
+    m_logger.reset(new spdlog::logger(name, target));
+  }
 }
 
 void Logger::addSink(std::shared_ptr<spdlog::sinks::sink> sink)
@@ -367,9 +437,33 @@ Logger& getDefault()
 namespace MOBase::log::details
 {
 
-void doLogImpl(spdlog::logger& lg, Levels lv, const std::string& s) noexcept
+// writes a message directly to the sinks of the logger, bypassing the levels of the
+// logger and of the other sinks; the crash buffer still filters with its own level
+//
+void logToSinks(spdlog::logger& lg, spdlog::sinks::sink* ring,
+                spdlog::level::level_enum lv, std::string_view s)
+{
+  const spdlog::details::log_msg m(lg.name(), lv, s);
+
+  for (auto& sink : lg.sinks()) {
+    if (sink.get() == ring && !sink->should_log(lv)) {
+      continue;
+    }
+
+    sink->log(m);
+  }
+
+  if (lv >= lg.flush_level()) {
+    lg.flush();
+  }
+}
+
+void doLogImpl(spdlog::logger& lg, spdlog::sinks::sink* ring, Levels lv,
+               std::string_view category, const std::string& s) noexcept
 {
   try {
+    const auto level = toSpdlog(lv);
+
     const char* start = s.c_str();
     const char* p     = start;
 
@@ -379,7 +473,17 @@ void doLogImpl(spdlog::logger& lg, Levels lv, const std::string& s) noexcept
       }
 
       std::string_view sv(start, static_cast<std::size_t>(p - start));
-      lg.log(toSpdlog(lv), "{}", sv);
+
+      if (category.empty()) {
+        // the message is already formatted, this overload doesn't format it again
+        lg.log(level, sv);
+      } else {
+        // the level of a category has already been checked by the caller, and is
+        // independent from the one of the logger
+        MessageBuffer buffer;
+        std::format_to(std::back_inserter(buffer.str()), "[{}] {}", category, sv);
+        logToSinks(lg, ring, level, buffer.str());
+      }
 
       if (!*p) {
         break;
@@ -393,6 +497,16 @@ void doLogImpl(spdlog::logger& lg, Levels lv, const std::string& s) noexcept
   }
 }
 
+void keepImpl(spdlog::sinks::sink& ring, Levels lv, std::string_view s) noexcept
+{
+  static_cast<RingSink&>(ring).keep(toSpdlog(lv), s);
+}
+
+Levels defaultLevel() noexcept
+{
+  return g_default ? g_default->level() : Info;
+}
+
 void ireplace_all(std::string& input, std::string const& search,
                   std::string const& replace) noexcept
 {
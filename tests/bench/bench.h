@@ -0,0 +1,178 @@
+#ifndef UIBASE_BENCH_H
+#define UIBASE_BENCH_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Minimal benchmark harness for uibase.
+ *
+ * Benchmarks are declared with UIBASE_BENCHMARK(group, name) and report their
+ * measurements with report() or measure(). The executable runs all the benchmarks, or
+ * only the ones whose "group.name" contains one of the arguments, and reports the peak
+ * resident set size after each of them.
+ */
+namespace MOBase::Bench
+{
+
+using BenchmarkFunction = void (*)();
+
+struct Benchmark
+{
+  std::string name;
+  BenchmarkFunction function;
+};
+
+inline std::vector<Benchmark>& benchmarks()
+{
+  static std::vector<Benchmark> list;
+  return list;
+}
+
+struct Registration
+{
+  Registration(const char* group, const char* name, BenchmarkFunction function)
+  {
+    benchmarks().push_back({std::string(group) + "." + name, function});
+  }
+};
+
+/**
+ * @brief Simple stopwatch, started on construction.
+ */
+class Stopwatch
+{
+public:
+  Stopwatch() : m_Start(clock::now()) {}
+
+  void restart() { m_Start = clock::now(); }
+
+  double elapsedMs() const
+  {
+    return std::chrono::duration<double, std::milli>(clock::now() - m_Start).count();
+  }
+
+private:
+  using clock = std::chrono::steady_clock;
+  clock::time_point m_Start;
+};
+
+/**
+ * @brief Allocations made since the start of the process, counted by the
+ *     replacement of malloc() defined in bench_main.cpp, which also sees operator new
+ *     and the allocations made by Qt and uibase.
+ *
+ * Replacing malloc() is only supported by the GNU C library, so allocations() returns
+ * an empty optional on other platforms rather than a partial count.
+ */
+struct Allocations
+{
+  std::size_t count;
+  std::size_t bytes;
+};
+
+std::optional<Allocations> allocations();
+
+/**
+ * @return the current resident set size of the process, in bytes.
+ */
+inline std::size_t currentRss()
+{
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS pmc;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+    return pmc.WorkingSetSize;
+  }
+  return 0;
+#else
+  long pages = 0, resident = 0;
+  if (FILE* f = std::fopen("/proc/self/statm", "r")) {
+    if (std::fscanf(f, "%ld %ld", &pages, &resident) != 2) {
+      resident = 0;
+    }
+    std::fclose(f);
+  }
+  return static_cast<std::size_t>(resident) *
+         static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+/**
+ * @return the peak resident set size of the process, in bytes.
+ */
+inline std::size_t peakRss()
+{
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS pmc;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+    return pmc.PeakWorkingSetSize;
+  }
+  return 0;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+  // ru_maxrss is in kilobytes on Linux:
+  return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+/**
+ * @brief Print a single measurement of the current benchmark.
+ */
+inline void report(const char* what, double value, const char* unit)
+{
+  std::printf("    %-32s %14.2f %s\n", what, value, unit);
+}
+
+inline void reportBytes(const char* what, std::size_t bytes)
+{
+  report(what, static_cast<double>(bytes) / (1024.0 * 1024.0), "MiB");
+}
+
+/**
+ * @brief Run the given function and report the time it took and, when they can be
+ *     counted, the allocations it made.
+ */
+template <class Function>
+void measure(const char* what, Function&& function)
+{
+  const auto before = allocations();
+  Stopwatch watch;
+  function();
+  const double elapsed = watch.elapsedMs();
+  const auto after     = allocations();
+
+  report(what, elapsed, "ms");
+  if (before && after) {
+    std::printf("    %-32s %14zu allocations, %.2f MiB\n", "",
+                after->count - before->count,
+                static_cast<double>(after->bytes - before->bytes) / (1024.0 * 1024.0));
+  }
+}
+
+}  // namespace MOBase::Bench
+
+#define UIBASE_BENCHMARK(group, name)                                                  \
+  static void bench_##group##_##name();                                                \
+  static MOBase::Bench::Registration bench_registration_##group##_##name(             \
+      #group, #name, &bench_##group##_##name);                                         \
+  static void bench_##group##_##name()
+
+#endif
@@ -0,0 +1,419 @@
+#include "bench.h"
+
+#include <memory>
+#include <utility>
+
+#include <QString>
+#include <QStringList>
+
+#include "arenafiletree.h"
+#include "filenamepool.h"
+#include "ifiletree.h"
+
+using namespace MOBase;
+using namespace MOBase::Bench;
+
+namespace
+{
+
+/**
+ * @brief Plain IFileTree where each entry is its own heap allocation, i.e., the
+ *     usual shared_ptr layout of IFileTree implementations.
+ */
+class HeapFileTree : public IFileTree
+{
+public:
+  static std::shared_ptr<IFileTree> create()
+  {
+    return std::shared_ptr<HeapFileTree>(new HeapFileTree(nullptr, ""));
+  }
+
+protected:
+  HeapFileTree(std::shared_ptr<const IFileTree> parent, QString name)
+      : FileTreeEntry(parent, name), IFileTree()
+  {}
+
+  std::shared_ptr<IFileTree> makeDirectory(std::shared_ptr<const IFileTree> parent,
+                                           QString name) const override
+  {
+    return std::shared_ptr<HeapFileTree>(new HeapFileTree(parent, name));
+  }
+
+  bool doPopulate(std::shared_ptr<const IFileTree>,
+                  std::vector<std::shared_ptr<FileTreeEntry>>&) const override
+  {
+    return true;
+  }
+
+  std::shared_ptr<IFileTree> doClone() const override
+  {
+    return std::shared_ptr<HeapFileTree>(new HeapFileTree(nullptr, name()));
+  }
+};
+
+/**
+ * @brief IFileTree generating its content when populated, in an order that is not
+ *     sorted, like archive or directory listings.
+ *
+ * Each directory has the given number of subdirectories, down to the given depth, and
+ * the given number of files.
+ */
+class GeneratedFileTree : public IFileTree
+{
+public:
+  static std::shared_ptr<IFileTree> create(int depth, int directories, int files)
+  {
+    return std::shared_ptr<GeneratedFileTree>(
+        new GeneratedFileTree(nullptr, "", depth, directories, files));
+  }
+
+protected:
+  GeneratedFileTree(std::shared_ptr<const IFileTree> parent, QString name, int depth,
+                    int directories, int files)
+      : FileTreeEntry(parent, name), IFileTree(), m_Depth(depth),
+        m_Directories(directories), m_Files(files)
+  {}
+
+  std::shared_ptr<IFileTree> makeDirectory(std::shared_ptr<const IFileTree> parent,
+                                           QString name) const override
+  {
+    return std::shared_ptr<GeneratedFileTree>(
+        new GeneratedFileTree(parent, name, 0, 0, 0));
+  }
+
+  bool doPopulate(std::shared_ptr<const IFileTree> parent,
+                  std::vector<std::shared_ptr<FileTreeEntry>>& entries) const override
+  {
+    entries.reserve(static_cast<std::size_t>(m_Files + m_Directories));
+    for (int i = m_Files; i-- > 0;) {
+      entries.push_back(createFileEntry(
+          parent, QString("%1_%2.dds").arg(i % 2 ? "Diffuse" : "normal").arg(i)));
+    }
+    if (m_Depth > 0) {
+      for (int i = m_Directories; i-- > 0;) {
+        entries.push_back(std::shared_ptr<GeneratedFileTree>(
+            new GeneratedFileTree(parent, QString("Folder%1").arg(i), m_Depth - 1,
+                                  m_Directories, m_Files)));
+      }
+    }
+    return false;
+  }
+
+  std::shared_ptr<IFileTree> doClone() const override
+  {
+    return std::shared_ptr<GeneratedFileTree>(
+        new GeneratedFileTree(nullptr, name(), m_Depth, m_Directories, m_Files));
+  }
+
+private:
+  int m_Depth;
+  int m_Directories;
+  int m_Files;
+};
+
+/**
+ * @brief Generate paths looking like the content of a large mod archive: a few top
+ *     level folders, many item folders, and the same few file names everywhere.
+ *
+ * @param files Approximate number of files to generate.
+ */
+QStringList modArchivePaths(std::size_t files)
+{
+  static const char* folders[] = {"meshes/armor", "meshes/clutter", "textures/armor",
+                                  "textures/clutter", "textures/landscape"};
+  static const char* names[]   = {"diffuse.dds", "diffuse_n.dds", "diffuse_s.dds",
+                                  "diffuse_g.dds", "model.nif",     "model_1.nif",
+                                  "model_0.nif",   "model.hkx",     "notes.txt",
+                                  "preview.png"};
+
+  QStringList paths;
+  paths.reserve(static_cast<qsizetype>(files));
+  for (std::size_t i = 0; paths.size() < static_cast<qsizetype>(files); ++i) {
+    const QString folder = QString("%1/set%2/item%3/")
+                               .arg(folders[i % std::size(folders)])
+                               .arg(i / 100)
+                               .arg(i);
+    for (auto* name : names) {
+      paths.push_back(folder + name);
+    }
+  }
+  return paths;
+}
+
+/**
+ * @brief Generate paths of files spread over a few large directories, which is the
+ *     worst case for one by one insertions.
+ *
+ * @param files Number of files to generate.
+ * @param directories Number of directories to spread the files over.
+ */
+QStringList flatPaths(std::size_t files, std::size_t directories)
+{
+  QStringList paths;
+  paths.reserve(static_cast<qsizetype>(files));
+  for (std::size_t i = 0; i < files; ++i) {
+    // Generate names in a non-sorted order:
+    paths.push_back(QString("data/dir%1/file%2.dds")
+                        .arg(i % directories)
+                        .arg((i * 7919) % files));
+  }
+  return paths;
+}
+
+/**
+ * @brief Report the content of the name pool, shared by all the trees.
+ */
+void reportNamePool()
+{
+  const auto stats = FileNamePool::instance().statistics();
+  report("interned names", static_cast<double>(stats.names), "");
+  reportBytes("names", stats.bytes);
+  reportBytes("names (uninterned)", stats.bytesUninterned);
+}
+
+/**
+ * @brief Build a tree from the given paths and destroy it, reporting the time taken
+ *     by both operations and the memory used by the tree.
+ *
+ * Measuring the memory through the resident set size is only meaningful when the
+ * benchmark runs in its own process, e.g., `uibase-bench ifiletree.arena`.
+ */
+template <class MakeTree, class Inspect>
+void buildAndDestroy(MakeTree makeTree, QStringList const& paths, Inspect inspect)
+{
+  const std::size_t rss = currentRss();
+
+  std::shared_ptr<IFileTree> tree = makeTree();
+  measure("build", [&] {
+    for (auto& path : paths) {
+      tree->addFile(path);
+    }
+  });
+  reportBytes("memory", currentRss() - rss);
+  inspect(*tree);
+  reportNamePool();
+
+  measure("destroy", [&] {
+    tree.reset();
+  });
+}
+
+/**
+ * @brief Build a tree from the given paths with addFiles().
+ */
+std::shared_ptr<IFileTree> buildTree(QStringList const& paths)
+{
+  auto tree = HeapFileTree::create();
+  tree->addFiles(paths);
+  return tree;
+}
+
+/**
+ * @brief Populate the given tree, report the time taken by walks over it, and destroy
+ *     it.
+ */
+void walkAndDestroy(std::shared_ptr<IFileTree> tree)
+{
+  std::size_t count = 0;
+  measure("walk", [&] {
+    tree->walk([&count](QString const&, std::shared_ptr<const FileTreeEntry>) {
+      ++count;
+      return IFileTree::WalkReturn::CONTINUE;
+    });
+  });
+  measure("walkEntries", [&] {
+    tree->walkEntries([&count](IFileTree::WalkPath const&, FileTreeEntry const&) {
+      ++count;
+    });
+  });
+  measure("path of all entries", [&] {
+    tree->walkEntries([&count](IFileTree::WalkPath const&, FileTreeEntry const& entry) {
+      count += entry.path().size();
+    });
+  });
+  report("entries", static_cast<double>(count), "");
+
+  measure("destroy", [&] {
+    tree.reset();
+  });
+}
+
+}  // namespace
+
+UIBASE_BENCHMARK(ifiletree, heap_300k)
+{
+  buildAndDestroy(&HeapFileTree::create, modArchivePaths(300'000),
+                  [](IFileTree const&) {});
+}
+
+UIBASE_BENCHMARK(ifiletree, arena_300k)
+{
+  buildAndDestroy(
+      [] {
+        return ArenaFileTree::create();
+      },
+      modArchivePaths(300'000),
+      [](IFileTree const& tree) {
+        auto arena = dynamic_cast<ArenaFileTree const&>(tree).arena();
+        reportBytes("arena", arena->bytesReserved());
+      });
+}
+
+// Both layouts in the same process, so their teardown can be compared directly; the
+// second erase/rebuild round shows that the arena reuses the memory of erased
+// entries instead of growing:
+UIBASE_BENCHMARK(ifiletree, teardown_300k)
+{
+  const QStringList paths = modArchivePaths(300'000);
+
+  std::shared_ptr<IFileTree> heap = HeapFileTree::create();
+  heap->addFiles(paths);
+  measure("destroy (heap)", [&] {
+    heap.reset();
+  });
+
+  std::shared_ptr<ArenaFileTree> arena = ArenaFileTree::create();
+  arena->addFiles(paths);
+  const auto handle = arena->arena();
+  reportBytes("arena used", handle->bytesUsed());
+
+  arena->clear();
+  arena->addFiles(paths);
+  reportBytes("arena used (rebuilt)", handle->bytesUsed());
+
+  measure("destroy (arena)", [&] {
+    arena.reset();
+  });
+}
+
+UIBASE_BENCHMARK(ifiletree, addfile_200k)
+{
+  const QStringList paths = flatPaths(200'000, 20);
+
+  auto tree = HeapFileTree::create();
+  measure("build", [&] {
+    for (auto& path : paths) {
+      tree->addFile(path);
+    }
+  });
+}
+
+UIBASE_BENCHMARK(ifiletree, addfiles_200k)
+{
+  const QStringList paths = flatPaths(200'000, 20);
+
+  auto tree = HeapFileTree::create();
+  measure("build", [&] {
+    tree->addFiles(paths);
+  });
+}
+
+// Deep tree, like the Data folder of a large mod: 4681 directories of 20 files.
+UIBASE_BENCHMARK(ifiletree, populate_deep)
+{
+  measure("populate", [] {
+    GeneratedFileTree::create(4, 8, 20)->populateAll(1);
+  });
+  measure("populate (parallel)", [] {
+    GeneratedFileTree::create(4, 8, 20)->populateAll();
+  });
+
+  auto tree = GeneratedFileTree::create(4, 8, 20);
+  tree->populateAll();
+  walkAndDestroy(std::move(tree));
+}
+
+// Wide tree, like texture folders: 8 directories of 50000 files.
+UIBASE_BENCHMARK(ifiletree, populate_wide)
+{
+  measure("populate", [] {
+    GeneratedFileTree::create(1, 8, 50'000)->populateAll(1);
+  });
+
+  auto tree = GeneratedFileTree::create(1, 8, 50'000);
+  tree->populateAll();
+  walkAndDestroy(std::move(tree));
+}
+
+UIBASE_BENCHMARK(ifiletree, find_300k)
+{
+  const QStringList paths = modArchivePaths(300'000);
+  QStringList missing;
+  for (auto& path : paths) {
+    missing.push_back(path + ".bak");
+  }
+
+  std::shared_ptr<const IFileTree> tree = buildTree(paths);
+
+  std::size_t found = 0;
+  measure("find", [&] {
+    for (auto& path : paths) {
+      found += tree->find(path) != nullptr;
+    }
+  });
+  measure("find (view)", [&] {
+    for (auto& path : paths) {
+      found += tree->find(QStringView(path)) != nullptr;
+    }
+  });
+  measure("exists (missing)", [&] {
+    for (auto& path : missing) {
+      found += tree->exists(QStringView(path));
+    }
+  });
+  measure("findBySuffix", [&] {
+    found += tree->findBySuffix("dds").size();
+  });
+  report("found", static_cast<double>(found), "");
+}
+
+UIBASE_BENCHMARK(ifiletree, merge_300k)
+{
+  // The source overlaps half of the destination:
+  const QStringList paths = modArchivePaths(300'000);
+  const QStringList destinationPaths = paths.mid(0, paths.size() * 3 / 4);
+  const QStringList sourcePaths      = paths.mid(paths.size() / 4);
+
+  {
+    auto destination = buildTree(destinationPaths);
+    auto source      = buildTree(sourcePaths);
+    measure("merge", [&] {
+      destination->merge(source);
+    });
+  }
+
+  {
+    auto destination = buildTree(destinationPaths);
+    auto source      = buildTree(sourcePaths);
+    measure("mergeParallel", [&] {
+      destination->mergeParallel(source);
+    });
+  }
+}
+
+UIBASE_BENCHMARK(ifiletree, clone_300k)
+{
+  auto source = buildTree(modArchivePaths(300'000));
+  auto target = HeapFileTree::create();
+
+  // Copies are lazy clones, copied when they are populated, or when their source is
+  // modified:
+  std::shared_ptr<IFileTree> copy;
+  measure("copy", [&] {
+    copy = target->copy(source, "copy/")->astree();
+  });
+  measure("populate copy", [&] {
+    copy->populateAll(1);
+  });
+  measure("destroy copy", [&] {
+    target.reset();
+    copy.reset();
+  });
+
+  target = HeapFileTree::create();
+  copy   = target->copy(source, "copy/")->astree();
+  measure("modify source", [&] {
+    source->walkEntries([](IFileTree::WalkPath const&, FileTreeEntry const&) {});
+    source->addFile("meshes/armor/set0/item0/new.nif");
+  });
+}
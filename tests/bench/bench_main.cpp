@@ -0,0 +1,137 @@
+#include "bench.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace MOBase::Bench;
+
+#if defined(__GLIBC__)
+
+// The GNU C library supports replacing malloc(), and exports its implementation
+// under these names; the replacements are used by the whole process, including
+// operator new, Qt and uibase:
+extern "C"
+{
+  void* __libc_malloc(std::size_t size);
+  void* __libc_calloc(std::size_t count, std::size_t size);
+  void* __libc_realloc(void* p, std::size_t size);
+  void* __libc_memalign(std::size_t alignment, std::size_t size);
+}
+
+namespace
+{
+std::atomic<std::size_t> g_AllocationCount{0};
+std::atomic<std::size_t> g_AllocationBytes{0};
+
+void count(std::size_t size)
+{
+  g_AllocationCount.fetch_add(1, std::memory_order_relaxed);
+  g_AllocationBytes.fetch_add(size, std::memory_order_relaxed);
+}
+}  // namespace
+
+// free() is not replaced, the blocks are still allocated by the C library:
+extern "C" void* malloc(std::size_t size) noexcept
+{
+  count(size);
+  return __libc_malloc(size);
+}
+
+extern "C" void* calloc(std::size_t n, std::size_t size) noexcept
+{
+  count(n * size);
+  return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void* p, std::size_t size) noexcept
+{
+  count(size);
+  return __libc_realloc(p, size);
+}
+
+// Used by the aligned versions of operator new:
+extern "C" void* aligned_alloc(std::size_t alignment, std::size_t size) noexcept
+{
+  count(size);
+  return __libc_memalign(alignment, size);
+}
+
+extern "C" void* memalign(std::size_t alignment, std::size_t size) noexcept
+{
+  count(size);
+  return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void** p, std::size_t alignment,
+                              std::size_t size) noexcept
+{
+  if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) {
+    return EINVAL;
+  }
+
+  count(size);
+  void* block = __libc_memalign(alignment, size);
+  if (block == nullptr) {
+    return ENOMEM;
+  }
+  *p = block;
+  return 0;
+}
+
+namespace MOBase::Bench
+{
+std::optional<Allocations> allocations()
+{
+  return Allocations{g_AllocationCount.load(std::memory_order_relaxed),
+                     g_AllocationBytes.load(std::memory_order_relaxed)};
+}
+}  // namespace MOBase::Bench
+
+#else
+
+namespace MOBase::Bench
+{
+std::optional<Allocations> allocations()
+{
+  return {};
+}
+}  // namespace MOBase::Bench
+
+#endif
+
+int main(int argc, char* argv[])
+{
+  std::size_t ran = 0;
+  for (const auto& benchmark : benchmarks()) {
+    bool selected = argc < 2;
+    for (int i = 1; i < argc && !selected; ++i) {
+      selected = benchmark.name.find(argv[i]) != std::string::npos;
+    }
+
+    if (!selected) {
+      continue;
+    }
+
+    std::printf("%s\n", benchmark.name.c_str());
+    Stopwatch watch;
+    benchmark.function();
+    report("total", watch.elapsedMs(), "ms");
+
+    // The peak is over the whole process, so it is only meaningful for the first
+    // benchmark that is run, e.g., `uibase-bench ifiletree.merge`:
+    reportBytes("peak rss", peakRss());
+    std::fflush(stdout);
+
+    ++ran;
+  }
+
+  if (ran == 0) {
+    std::fprintf(stderr, "no benchmark matched\n");
+    return 1;
+  }
+
+  return 0;
+}
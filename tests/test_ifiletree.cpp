@@ -4,9 +4,19 @@
 #pragma warning(pop)
 
 #include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
 #include <string>
+#include <thread>
 #include <variant>
 
+#include "arenafiletree.h"
+#include "directoryfiletree.h"
+#include "filetreemetadata.h"
+#include "filetreesnapshot.h"
 #include "ifiletree.h"
 
 std::ostream& operator<<(std::ostream& os, const QString& str)
@@ -352,6 +362,9 @@ TEST(IFileTreeTest, TreeIsPopulatedCorrectly)
     EXPECT_EQ(e_q_p->path("/"), "e/q/p");
     EXPECT_EQ(e_q_p->pathFrom(e->astree()), "q\\p");
     EXPECT_EQ(e_q_p->pathFrom(e_q->astree()), "p");
+    EXPECT_EQ(e_q_p->pathFrom(e_q->astree(), "::"), "p");
+    EXPECT_EQ(e_q_p->path("::"), "e::q::p");
+    EXPECT_EQ(e->astree()->pathTo(e_q_ct, "/"), "q/c.t");
 
     EXPECT_EQ(a->pathFrom(b->astree()), "");
     EXPECT_EQ(b->pathFrom(a->astree()), "");
@@ -803,6 +816,113 @@ TEST(IFileTreeTest, TreeMergeOperations)
   }
 }
 
+TEST(IFileTreeTest, ParallelMergeOperations)
+{
+  std::vector<std::pair<QString, bool>> dstFiles, srcFiles;
+  for (int i = 0; i < 6; ++i) {
+    for (int j = 0; j < 6; ++j) {
+      for (int k = 0; k < 3; ++k) {
+        dstFiles.push_back({QString("d%1/s%2/f%3.txt").arg(i).arg(j).arg(k), false});
+        srcFiles.push_back(
+            {QString("d%1/s%2/f%3.txt").arg(i + 3).arg(j).arg(k + 2), false});
+      }
+    }
+  }
+
+  // Conflicts between files and directories:
+  dstFiles.push_back({"d4/s0/f4.txt/", true});
+  srcFiles.push_back({"d0/s1", false});
+
+  auto toPaths = [](auto const& tree) {
+    std::vector<QString> paths;
+    tree->walk([&paths](QString const& path, auto const& entry) {
+      paths.push_back(path + entry->name() + (entry->isDir() ? "/" : ""));
+      return IFileTree::WalkReturn::CONTINUE;
+    });
+    return paths;
+  };
+
+  // Merge with both methods, recording the notifications and the overwrites:
+  struct Result
+  {
+    std::shared_ptr<IFileTree> tree;
+    std::size_t count;
+    std::vector<QString> changes, overwrites;
+  };
+  auto mergeWith = [&](bool parallel) {
+    Result result{FileListTree::makeTree(std::vector(dstFiles))};
+    auto source = FileListTree::makeTree(std::vector(srcFiles));
+
+    result.tree->subscribe([&result](IFileTree::Change const& change) {
+      result.changes.push_back(QString::number(static_cast<int>(change.kind)) + " " +
+                               change.path + " " + change.previousPath);
+    });
+
+    IFileTree::OverwritesType overwrites;
+    result.count = parallel ? result.tree->mergeParallel(source, &overwrites, 4)
+                            : result.tree->merge(source, &overwrites);
+    for (auto& [replaced, entry] : overwrites) {
+      result.overwrites.push_back(replaced->name() + " " + entry->path("/"));
+    }
+    std::sort(result.overwrites.begin(), result.overwrites.end());
+
+    EXPECT_TRUE(source->empty());
+    return result;
+  };
+
+  const auto expected = mergeWith(false);
+  const auto result   = mergeWith(true);
+  EXPECT_EQ(result.count, expected.count);
+  EXPECT_EQ(result.count, std::size_t{3 * 6 + 2});
+  EXPECT_EQ(toPaths(result.tree), toPaths(expected.tree));
+  EXPECT_EQ(result.changes, expected.changes);
+  EXPECT_EQ(result.overwrites, expected.overwrites);
+  EXPECT_TRUE(result.tree->exists("d0/s1", FileTreeEntry::FILE));
+  EXPECT_TRUE(result.tree->exists("d4/s0/f4.txt", FileTreeEntry::FILE));
+
+  // Merged directories come from the destination:
+  auto destination = FileListTree::makeTree(std::vector(dstFiles));
+  auto directory   = destination->findDirectory("d3/s3");
+  EXPECT_NE(destination->mergeParallel(FileListTree::makeTree(std::vector(srcFiles))),
+            IFileTree::MERGE_FAILED);
+  EXPECT_EQ(destination->findDirectory("d3/s3"), directory);
+  EXPECT_EQ(directory->size(), 5);
+  EXPECT_EQ(destination->find("d3/s3/f4.txt")->parent(), directory);
+
+  // Failed merges do not modify the trees:
+  auto source   = FileListTree::makeTree(std::vector(srcFiles));
+  auto readOnly = SnapshotFileTree::create(FileTreeSnapshot::fromData(
+      FileTreeSnapshot::serialize(FileListTree::makeTree(std::vector(dstFiles)))));
+  EXPECT_EQ(readOnly->mergeParallel(source), IFileTree::MERGE_FAILED);
+  EXPECT_EQ(toPaths(source), toPaths(FileListTree::makeTree(std::vector(srcFiles))));
+  EXPECT_EQ(toPaths(readOnly), toPaths(FileListTree::makeTree(std::vector(dstFiles))));
+  EXPECT_EQ(destination->findDirectory("d0")->mergeParallel(destination),
+            IFileTree::MERGE_FAILED);
+
+  // Sources under the destination are fine, unless they would be merged into or
+  // replaced by one of their own entries:
+  auto nested = FileListTree::makeTree({{"Data/a.esp", false},
+                                        {"Data/textures/b.dds", false},
+                                        {"textures/c.dds", false}});
+  EXPECT_EQ(nested->mergeParallel(nested->findDirectory("Data"), nullptr, 4),
+            std::size_t{0});
+  EXPECT_TRUE(nested->exists("a.esp", FileTreeEntry::FILE));
+  EXPECT_TRUE(nested->exists("textures/b.dds", FileTreeEntry::FILE));
+  EXPECT_TRUE(nested->findDirectory("Data")->empty());
+
+  for (auto const& overlapping :
+       {std::vector<std::pair<QString, bool>>{{"Data/Data/a.esp", false},
+                                              {"Data/b.esp", false}},
+        std::vector<std::pair<QString, bool>>{{"Data/Data", false},
+                                              {"Data/b.esp", false}}}) {
+    auto tree        = FileListTree::makeTree(std::vector(overlapping));
+    const auto paths = toPaths(tree);
+    EXPECT_EQ(tree->mergeParallel(tree->findDirectory("Data"), nullptr, 4),
+              IFileTree::MERGE_FAILED);
+    EXPECT_EQ(toPaths(tree), paths);
+  }
+}
+
 TEST(IFileTreeTest, TreeWalkOperations)
 {
 
@@ -874,3 +994,1062 @@ TEST(IFileTreeTest, TreeWalkOperations)
     EXPECT_EQ(entries, expected);
   }
 }
+
+TEST(IFileTreeTest, TreeWalkEntriesOperations)
+{
+  auto fileTree = FileListTree::makeTree({{"a/", true},
+                                          {"b", true},
+                                          {"b/u", false},
+                                          {"b/v", false},
+                                          {"c.x", false},
+                                          {"d.y", false},
+                                          {"e/q/c.t", false},
+                                          {"e/q/p", true}});
+
+  // walkEntries() visits the same entries with the same paths as walk():
+  std::vector<std::pair<QString, FileTreeEntry const*>> expected, entries;
+  fileTree->walk(
+      [&expected](auto path, auto entry) {
+        expected.push_back({path, entry.get()});
+        return IFileTree::WalkReturn::CONTINUE;
+      },
+      "/");
+  fileTree->walkEntries(
+      [&entries](IFileTree::WalkPath const& path, FileTreeEntry const& entry) {
+        entries.push_back({path.str(), &entry});
+      },
+      '/');
+  EXPECT_EQ(entries, expected);
+
+  // Paths are only built on demand, and depth/parent are always available:
+  std::vector<std::pair<QString, std::size_t>> paths;
+  fileTree->walkEntries([&paths](auto const& path, FileTreeEntry const& entry) {
+    EXPECT_EQ(path.parent().find(entry.name()).get(), &entry);
+    if (entry.name() == "c.t" || entry.name() == "v") {
+      paths.push_back({path.str(), path.depth()});
+    }
+  });
+  decltype(paths) expectedPaths{{"b\\", 1}, {"e\\q\\", 2}};
+  EXPECT_EQ(paths, expectedPaths);
+
+  // SKIP and STOP work as for walk():
+  std::vector<QString> names;
+  fileTree->walkEntries([&names](auto const&, FileTreeEntry const& entry) {
+    if (entry.name() == "b") {
+      return IFileTree::WalkReturn::SKIP;
+    }
+    if (entry.name() == "c.t") {
+      return IFileTree::WalkReturn::STOP;
+    }
+    names.push_back(entry.name());
+    return IFileTree::WalkReturn::CONTINUE;
+  });
+  EXPECT_EQ(names, (std::vector<QString>{"a", "e", "q", "p"}));
+}
+
+TEST(IFileTreeTest, ParallelPopulation)
+{
+  std::vector<std::pair<QString, bool>> files;
+  for (int i = 0; i < 8; ++i) {
+    for (int j = 0; j < 8; ++j) {
+      for (int k = 0; k < 4; ++k) {
+        files.push_back({QString("d%1/s%2/f%3").arg(i).arg(j).arg(k), false});
+      }
+    }
+  }
+
+  // Check that the trees at the given depth are populated, without populating the
+  // ones that are not:
+  auto populatedAt = [](std::shared_ptr<const IFileTree> tree, int depth) {
+    std::vector<std::shared_ptr<const IFileTree>> trees{tree};
+    for (int i = 0; i < depth; ++i) {
+      std::vector<std::shared_ptr<const IFileTree>> next;
+      for (auto& tree : trees) {
+        for (auto entry : *tree) {
+          next.push_back(entry->astree());
+        }
+      }
+      trees = std::move(next);
+    }
+    return std::all_of(trees.begin(), trees.end(), [](auto const& tree) {
+      return populated(tree);
+    });
+  };
+
+  {
+    auto fileTree = FileListTree::makeTree(std::vector(files));
+    fileTree->prefetch(0);
+    EXPECT_TRUE(populated(fileTree));
+    EXPECT_FALSE(populatedAt(fileTree, 1));
+  }
+
+  {
+    auto fileTree = FileListTree::makeTree(std::vector(files));
+    fileTree->prefetch(1, 4);
+    EXPECT_TRUE(populatedAt(fileTree, 1));
+    EXPECT_FALSE(populatedAt(fileTree, 2));
+  }
+
+  {
+    // Population can also be triggered from other threads meanwhile:
+    auto fileTree = FileListTree::makeTree(std::vector(files));
+    std::thread reader([&fileTree] {
+      EXPECT_EQ(fileTree->find("d7/s7/f3")->name(), "f3");
+    });
+    fileTree->populateAll();
+    reader.join();
+
+    EXPECT_TRUE(populatedAt(fileTree, 2));
+    EXPECT_EQ(getAllEntries(fileTree).size(), std::size_t{8 + 8 * 8 + 8 * 8 * 4});
+  }
+}
+
+TEST(IFileTreeTest, FrozenTrees)
+{
+  // Directories are large enough to be indexed:
+  std::vector<std::pair<QString, bool>> files;
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 32; ++j) {
+      files.push_back({QString("d%1/f%2.%3").arg(i).arg(j).arg(j % 2 ? "nif" : "dds"),
+                       false});
+    }
+  }
+
+  auto fileTree = FileListTree::makeTree(std::vector(files));
+  auto subtree  = fileTree->findDirectory("d1");
+  EXPECT_FALSE(fileTree->isFrozen());
+  fileTree->freeze();
+  EXPECT_TRUE(fileTree->isFrozen());
+  EXPECT_TRUE(subtree->isFrozen());
+  EXPECT_TRUE(populated(subtree));
+
+  // Modifications fail without modifying the tree:
+  const auto count = getAllEntries(fileTree).size();
+  EXPECT_THROW(fileTree->addFile("a.txt"), UnsupportedOperationException);
+  EXPECT_THROW(fileTree->addDirectory("d1/e"), UnsupportedOperationException);
+  EXPECT_THROW(fileTree->erase("d0"), UnsupportedOperationException);
+  EXPECT_THROW(subtree->clear(), UnsupportedOperationException);
+  EXPECT_THROW(fileTree->move(subtree->find("f0.dds"), "d2/"),
+               UnsupportedOperationException);
+  EXPECT_THROW(fileTree->merge(subtree), UnsupportedOperationException);
+  EXPECT_EQ(getAllEntries(fileTree).size(), count);
+  EXPECT_EQ(subtree->find("f0.dds")->parent(), subtree);
+
+  // Entries cannot be moved out of, or into, frozen trees:
+  auto other = FileListTree::makeTree({{"g.txt", false}});
+  EXPECT_THROW(other->move(subtree->find("f0.dds"), ""), UnsupportedOperationException);
+  EXPECT_THROW(subtree->insert(other->find("g.txt")), UnsupportedOperationException);
+  EXPECT_EQ(other->size(), 1);
+
+  // Clones are not frozen:
+  auto copy = other->copy(subtree, "copy/");
+  ASSERT_NE(copy, nullptr);
+  EXPECT_FALSE(copy->astree()->isFrozen());
+  EXPECT_NE(copy->astree()->addFile("h.txt"), nullptr);
+  EXPECT_EQ(subtree->size(), 32);
+
+  // Concurrent readers:
+  std::shared_ptr<const IFileTree> shared = fileTree;
+  std::vector<std::thread> readers;
+  std::atomic<int> failures{0};
+  for (int t = 0; t < 8; ++t) {
+    readers.emplace_back([&shared, &failures, t] {
+      for (int n = 0; n < 200; ++n) {
+        const int i = (t + n) % 4, j = n % 32;
+        const QString path =
+            QString("D%1/F%2.%3").arg(i).arg(j).arg(j % 2 ? "nif" : "dds");
+        auto entry = shared->find(path);
+        if (entry == nullptr || !entry->isFile() || !shared->exists(path) ||
+            shared->findDirectory(QString("d%1").arg(i))->find(entry->name()) !=
+                entry) {
+          ++failures;
+        }
+
+        std::size_t visited = 0;
+        shared->walk([&visited](QString const&, std::shared_ptr<const FileTreeEntry>) {
+          ++visited;
+          return IFileTree::WalkReturn::CONTINUE;
+        });
+        // The index of the tree is built by freeze(), the ones of its subtrees on
+        // the first lookup:
+        if (visited != 4 + 4 * 32 || shared->findBySuffix("nif").size() != 4 * 16 ||
+            shared->findDirectory(QString("d%1").arg(i))->findBySuffix("dds").size() !=
+                16) {
+          ++failures;
+        }
+      }
+    });
+  }
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(failures, 0);
+}
+
+TEST(IFileTreeTest, CopyOnWriteClones)
+{
+  const std::vector<std::pair<QString, bool>> content{{"a.txt", false},
+                                                      {"x", true},
+                                                      {"x/y", true},
+                                                      {"x/y/z.txt", false},
+                                                      {"x/y/w.txt", false},
+                                                      {"x/v.txt", false}};
+
+  auto fileTree = ArenaFileTree::create();
+  for (auto& [path, isDir] : content) {
+    if (isDir) {
+      fileTree->addDirectory("src/" + path);
+    } else {
+      fileTree->addFile("src/" + path);
+    }
+  }
+
+  // Modifying the source after a copy does not modify the copy:
+  {
+    auto dst = fileTree->copy(fileTree->find("src"), "dst/");
+    ASSERT_NE(dst, nullptr);
+
+    fileTree->addFile("src/x/y/new.txt");
+    fileTree->findDirectory("src/x/y")->erase("z.txt");
+    fileTree->move(fileTree->find("src/a.txt"), "src/x/b.txt");
+    fileTree->move(fileTree->find("src/x/v.txt"), "src/x/u.txt");
+
+    assertTreeEquals(fileTree->findDirectory("dst/src"), content);
+    assertTreeEquals(fileTree->findDirectory("src"), {{"x", true},
+                                                      {"x/b.txt", false},
+                                                      {"x/u.txt", false},
+                                                      {"x/y", true},
+                                                      {"x/y/w.txt", false},
+                                                      {"x/y/new.txt", false}});
+    fileTree->erase("dst");
+  }
+
+  // Modifying the copy does not modify the source:
+  {
+    auto src     = fileTree->findDirectory("src");
+    auto dst     = fileTree->copy(src, "dst/")->astree();
+    auto srcDump = getAllEntries(src).size();
+
+    dst->erase("x");
+    dst->addFile("c.txt");
+    EXPECT_EQ(getAllEntries(src).size(), srcDump);
+    EXPECT_EQ(getAllEntries(dst).size(), std::size_t{1});
+    fileTree->erase("dst");
+  }
+
+  // Copies of copies:
+  {
+    auto dst1 = fileTree->copy(fileTree->find("src"), "dst1/")->astree();
+    auto dst2 = fileTree->copy(dst1, "dst2/")->astree();
+    dst1->findDirectory("x/y")->clear();
+    fileTree->findDirectory("src/x")->erase("b.txt");
+
+    EXPECT_TRUE(dst2->exists("x/y/w.txt"));
+    EXPECT_TRUE(dst2->exists("x/b.txt"));
+    EXPECT_FALSE(dst1->exists("x/y/w.txt"));
+    EXPECT_TRUE(dst1->exists("x/b.txt"));
+    EXPECT_FALSE(fileTree->exists("src/x/b.txt"));
+  }
+}
+
+TEST(IFileTreeTest, TreeDiffOperations)
+{
+  using Kind = IFileTree::Difference::Kind;
+
+  const auto toStrings = [](std::vector<IFileTree::Difference> const& differences) {
+    std::vector<QString> result;
+    for (auto& difference : differences) {
+      auto& entry = difference.before ? difference.before : difference.after;
+      QString prefix;
+      switch (difference.kind) {
+      case Kind::ADDED:
+        prefix = "+";
+        break;
+      case Kind::REMOVED:
+        prefix = "-";
+        break;
+      case Kind::TYPE_CHANGED:
+        prefix = "~";
+        break;
+      }
+      result.push_back(prefix + entry->path("/"));
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+  };
+
+  auto tree1 = FileListTree::makeTree({{"a/", true},
+                                       {"a/b.txt", false},
+                                       {"a/c/", true},
+                                       {"a/c/d.txt", false},
+                                       {"e.txt", false},
+                                       {"f/", true},
+                                       {"f/g.txt", false},
+                                       {"h.txt", false},
+                                       {"i/", true}});
+  auto tree2 = FileListTree::makeTree({{"a/", true},
+                                       {"a/B.txt", false},
+                                       {"a/c/", true},
+                                       {"a/c/x.txt", false},
+                                       {"e.txt/", true},
+                                       {"f/", true},
+                                       {"f/g.txt", false},
+                                       {"i", false},
+                                       {"j.txt", false}});
+
+  EXPECT_EQ(toStrings(tree1->diff(tree2)),
+            (std::vector<QString>{"+a/c/x.txt", "+j.txt", "-a/c/d.txt", "-h.txt",
+                                  "~e.txt", "~i"}));
+
+  for (auto& difference : tree1->diff(tree2)) {
+    if (difference.kind == Kind::TYPE_CHANGED) {
+      EXPECT_NE(difference.before->isDir(), difference.after->isDir());
+    }
+  }
+
+  // Reversed and identical trees:
+  EXPECT_EQ(toStrings(tree2->diff(tree1)),
+            (std::vector<QString>{"+a/c/d.txt", "+h.txt", "-a/c/x.txt", "-j.txt",
+                                  "~e.txt", "~i"}));
+  EXPECT_TRUE(tree1->diff(tree1).empty());
+
+  // Copies are identical to their source until they are modified:
+  auto source = tree1->findDirectory("a");
+  auto copy   = tree1->copy(source, "copy/")->astree();
+  EXPECT_TRUE(source->diff(copy).empty());
+  EXPECT_TRUE(copy->diff(source).empty());
+
+  copy->findDirectory("c")->addFile("y.txt");
+  copy->erase("b.txt");
+  EXPECT_EQ(toStrings(source->diff(copy)),
+            (std::vector<QString>{"+copy/a/c/y.txt", "-a/b.txt"}));
+}
+
+TEST(IFileTreeTest, TreeSnapshots)
+{
+  auto fileTree = FileListTree::makeTree({{"a/", true},
+                                          {"a/b.txt", false},
+                                          {"a/c/", true},
+                                          {"a/c/readme.txt", false},
+                                          {"a/c/d/", true},
+                                          {"e/", true},
+                                          {"e/readme.txt", false},
+                                          {"f.txt", false},
+                                          {"g/", true}});
+
+  auto snapshot = FileTreeSnapshot::fromData(FileTreeSnapshot::serialize(fileTree));
+  ASSERT_NE(snapshot, nullptr);
+  EXPECT_EQ(snapshot->size(), std::size_t{10});
+
+  // In place queries:
+  auto root = snapshot->root();
+  EXPECT_TRUE(root.isDir());
+  EXPECT_EQ(root.size(), std::size_t{4});
+  EXPECT_EQ(root.at(0).name().toString(), "a");
+  EXPECT_EQ(root.at(3).name().toString(), "f.txt");
+
+  EXPECT_EQ(root.find(u"A/C\\README.TXT").name().toString(), "readme.txt");
+  EXPECT_TRUE(root.find(u"a/c/d").isDir());
+  EXPECT_TRUE(root.find(u"a").find(u"b.txt").isFile());
+  EXPECT_FALSE(root.find(u"a/b.txt", IFileTree::DIRECTORY));
+  EXPECT_FALSE(root.find(u"f.txt/x"));
+  EXPECT_FALSE(root.find(u"x"));
+
+  // Snapshot trees have the same content as the original tree:
+  auto snapshotTree = SnapshotFileTree::create(snapshot);
+  EXPECT_TRUE(fileTree->diff(snapshotTree).empty());
+  EXPECT_TRUE(snapshotTree->diff(fileTree).empty());
+  EXPECT_EQ(snapshotTree->find("a/c/readme.txt")->path("/"), "a/c/readme.txt");
+  EXPECT_EQ(snapshotTree->findDirectory("a/c")->size(), std::size_t{2});
+
+  // ...and are read-only:
+  EXPECT_THROW(snapshotTree->addFile("h.txt"), UnsupportedOperationException);
+  EXPECT_FALSE(snapshotTree->erase("f.txt").second);
+  EXPECT_EQ(snapshotTree->merge(fileTree->findDirectory("e")), IFileTree::MERGE_FAILED);
+  EXPECT_TRUE(snapshotTree->exists("f.txt"));
+
+  // Invalid snapshots are rejected:
+  QByteArray data = FileTreeSnapshot::serialize(fileTree);
+  EXPECT_EQ(FileTreeSnapshot::fromData(QByteArray()), nullptr);
+  EXPECT_EQ(FileTreeSnapshot::fromData(QByteArray(data.constData(), data.size() - 4)),
+            nullptr);
+  data.data()[0] = 'x';
+  EXPECT_EQ(FileTreeSnapshot::fromData(data), nullptr);
+  EXPECT_EQ(FileTreeSnapshot::open("this/file/does/not/exist"), nullptr);
+}
+
+TEST(IFileTreeTest, ChangeNotifications)
+{
+  using Kind = IFileTree::Change::Kind;
+
+  auto fileTree = FileListTree::makeTree({{"a/", true},
+                                          {"a/b.txt", false},
+                                          {"c/", true},
+                                          {"c/d.txt", false},
+                                          {"e.txt", false}});
+
+  const auto recorder = [](std::vector<QString>& changes) {
+    return [&changes](IFileTree::Change const& change) {
+      static const std::map<Kind, QString> kinds{{Kind::INSERTED, "+"},
+                                                 {Kind::REMOVED, "-"},
+                                                 {Kind::MOVED, "M "},
+                                                 {Kind::MERGED, "U "}};
+      QString s = kinds.at(change.kind) + change.path;
+      if (!change.previousPath.isEmpty()) {
+        s += " <- " + change.previousPath;
+      }
+      changes.push_back(s);
+    };
+  };
+
+  std::vector<QString> changes;
+  const auto subscription = fileTree->subscribe(recorder(changes));
+
+  // Insertions, removals and moves:
+  fileTree->addFile("x/y.txt");
+  fileTree->erase("e.txt");
+  fileTree->move(fileTree->find("a/b.txt"), "c/");
+  fileTree->move(fileTree->find("c/d.txt"), "f.txt");
+  fileTree->addFile("f.txt", true);
+  fileTree->copy(fileTree->find("a"), "h/");
+  EXPECT_EQ(changes, (std::vector<QString>{"+x", "+x\\y.txt", "-e.txt",
+                                           "M c\\b.txt <- a\\b.txt",
+                                           "M f.txt <- c\\d.txt", "-f.txt", "+f.txt",
+                                           "+h", "+h\\a"}));
+
+  // Merges:
+  fileTree->addFile("z/c/new.txt");
+  fileTree->addFile("z/c/b.txt");
+  changes.clear();
+  EXPECT_EQ(fileTree->merge(fileTree->findDirectory("z")), std::size_t{1});
+  EXPECT_EQ(changes, (std::vector<QString>{"-c\\b.txt", "M c\\b.txt <- z\\c\\b.txt",
+                                           "M c\\new.txt <- z\\c\\new.txt",
+                                           "U c <- z\\c"}));
+
+  // Subscriptions on subtrees only see their own changes:
+  std::vector<QString> subChanges;
+  auto subTree = fileTree->findDirectory("c");
+  const auto subSubscription = subTree->subscribe(recorder(subChanges));
+  changes.clear();
+
+  fileTree->move(fileTree->find("f.txt"), "c/");
+  fileTree->move(fileTree->find("c/f.txt"), "g.txt");
+  fileTree->addFile("x/w.txt");
+  EXPECT_EQ(changes,
+            (std::vector<QString>{"M c\\f.txt <- f.txt", "M g.txt <- c\\f.txt",
+                                  "+x\\w.txt"}));
+  EXPECT_EQ(subChanges, (std::vector<QString>{"+f.txt", "-f.txt"}));
+
+  // Batch insertions, entries given to insertMany() are moved:
+  changes.clear();
+  subChanges.clear();
+  EXPECT_EQ(fileTree->addFiles({"c/j.txt", "k.txt"}), std::size_t{2});
+  EXPECT_EQ(
+      fileTree->insertMany({fileTree->find("x/w.txt"), fileTree->find("c/new.txt")}),
+      std::size_t{2});
+  EXPECT_EQ(changes, (std::vector<QString>{"+c\\j.txt", "+k.txt",
+                                           "M new.txt <- c\\new.txt",
+                                           "M w.txt <- x\\w.txt"}));
+  EXPECT_EQ(subChanges, (std::vector<QString>{"+j.txt", "-new.txt"}));
+
+  // Unsubscribing:
+  EXPECT_TRUE(subTree->unsubscribe(subSubscription));
+  EXPECT_FALSE(subTree->unsubscribe(subSubscription));
+  EXPECT_FALSE(subTree->unsubscribe(subscription));
+  EXPECT_TRUE(fileTree->unsubscribe(subscription));
+
+  changes.clear();
+  subChanges.clear();
+  fileTree->addFile("c/i.txt");
+  EXPECT_TRUE(changes.empty());
+  EXPECT_TRUE(subChanges.empty());
+}
+
+TEST(IFileTreeTest, DirectoryTrees)
+{
+  namespace fs = std::filesystem;
+
+  const fs::path root = fs::temp_directory_path() / "uibase-tests-directoryfiletree";
+  fs::remove_all(root);
+  fs::create_directories(root / "meshes" / "armor");
+  fs::create_directories(root / "textures");
+  std::ofstream(root / "plugin.esp") << "plugin";
+  std::ofstream(root / "meshes" / "armor" / "a.nif");
+  std::ofstream(root / "textures" / "b.dds");
+
+  std::vector<std::pair<QString, bool>> expected{{"meshes", true},
+                                                 {"meshes/armor", true},
+                                                 {"meshes/armor/a.nif", false},
+                                                 {"plugin.esp", false},
+                                                 {"textures", true},
+                                                 {"textures/b.dds", false}};
+
+  // Symbolic links are followed, but may not be supported:
+  std::error_code ec;
+  fs::create_directory_symlink(root / "textures", root / "link", ec);
+  if (!ec) {
+    expected.push_back({"link", true});
+    expected.push_back({"link/b.dds", false});
+  }
+
+  const QString rootPath = QString::fromStdString(root.string());
+  auto fileTree          = DirectoryFileTree::create(rootPath);
+  ASSERT_NE(fileTree, nullptr);
+  EXPECT_EQ(fileTree->rootPath(), rootPath);
+
+  fileTree->populateAll(4);
+  assertTreeEquals(fileTree, expected);
+
+  // Lazy population:
+  assertTreeEquals(DirectoryFileTree::create(rootPath), expected);
+
+  // Metadata are read on demand, and only for entries on the disk:
+  auto metadata = DirectoryFileTree::metadata(*fileTree->find("plugin.esp"));
+  ASSERT_TRUE(metadata.has_value());
+  EXPECT_EQ(metadata->size, 6);
+  EXPECT_TRUE(DirectoryFileTree::metadata(*fileTree->find("meshes/armor")).has_value());
+  EXPECT_TRUE(DirectoryFileTree::metadata(*fileTree).has_value());
+
+  fileTree->addFile("textures/c.dds");
+  fileTree->addDirectory("scripts");
+  fileTree->move(fileTree->find("meshes/armor/a.nif"), "meshes/armor/b.nif");
+  EXPECT_FALSE(DirectoryFileTree::metadata(*fileTree->find("textures/c.dds")));
+  EXPECT_FALSE(DirectoryFileTree::metadata(*fileTree->find("scripts")));
+  EXPECT_FALSE(DirectoryFileTree::metadata(*fileTree->find("meshes/armor/b.nif")));
+
+  // Entries moved to the place of another entry on the disk are not confused with it:
+  fileTree->erase("plugin.esp");
+  fileTree->move(fileTree->find("textures/b.dds"), "plugin.esp");
+  fileTree->move(fileTree->find("meshes"), "textures/meshes");
+  EXPECT_FALSE(DirectoryFileTree::metadata(*fileTree->find("plugin.esp")));
+  EXPECT_FALSE(DirectoryFileTree::metadata(*fileTree->find("textures/meshes")));
+  EXPECT_FALSE(DirectoryFileTree::metadata(*fileTree->find("textures/meshes/armor")));
+  EXPECT_TRUE(DirectoryFileTree::metadata(*fileTree->find("textures")).has_value());
+
+  // Links to a parent directory are ignored:
+  fs::create_directory_symlink(root / "meshes", root / "meshes" / "armor" / "up", ec);
+  if (!ec) {
+    auto linked = DirectoryFileTree::create(rootPath);
+    linked->populateAll(4);
+    EXPECT_NE(linked->find("meshes/armor/a.nif"), nullptr);
+    EXPECT_EQ(linked->find("meshes/armor/up"), nullptr);
+    fs::remove(root / "meshes" / "armor" / "up");
+  }
+
+  // Names that only differ by case, on case-sensitive file systems, give a single
+  // entry, preferring directories:
+  fs::create_directories(root / "collisions");
+  std::ofstream(root / "collisions" / "foo.esp");
+  std::ofstream(root / "collisions" / "Foo.esp");
+  fs::create_directory(root / "collisions" / "FOO.ESP", ec);
+  std::ofstream(root / "collisions" / "bar.esp");
+  std::ofstream(root / "collisions" / "Bar.esp");
+
+  auto collisions = DirectoryFileTree::create(rootPath + "/collisions");
+  ASSERT_NE(collisions, nullptr);
+  ASSERT_EQ(collisions->size(), 2);
+  if (std::distance(fs::directory_iterator(root / "collisions"),
+                    fs::directory_iterator{}) == 5) {
+    EXPECT_EQ(collisions->at(0)->name(), "FOO.ESP");
+    EXPECT_TRUE(collisions->at(0)->isDir());
+    EXPECT_EQ(collisions->at(1)->name(), "Bar.esp");
+    EXPECT_TRUE(collisions->at(1)->isFile());
+  }
+  collisions.reset();
+
+  EXPECT_EQ(DirectoryFileTree::create(rootPath + "/missing"), nullptr);
+
+  fileTree.reset();
+  fs::remove_all(root);
+}
+
+TEST(IFileTreeTest, TreeMetadata)
+{
+  auto fileTree = FileListTree::makeTree({{"a/", true},
+                                          {"a/b.txt", false},
+                                          {"a/c/", true},
+                                          {"a/c/d.txt", false},
+                                          {"a/c/e.txt", false},
+                                          {"f/", true},
+                                          {"f/g.txt", false},
+                                          {"h.txt", false}});
+
+  FileTreeMetadata metadata;
+  metadata.set({{fileTree->find("a/b.txt"), {10, QDateTime::fromMSecsSinceEpoch(1000)}},
+                {fileTree->find("a/c/d.txt"), {20}},
+                {fileTree->find("f/g.txt"), {40}},
+                {fileTree->find("h.txt"), {80, {}, "hash"}}});
+
+  EXPECT_EQ(metadata.count(), 4);
+  EXPECT_EQ(metadata.size(*fileTree->find("a/c/d.txt")), 20);
+  EXPECT_EQ(metadata.size(*fileTree->find("a/c/e.txt")), -1);
+  EXPECT_EQ(metadata.lastModified(*fileTree->find("a/b.txt")).toMSecsSinceEpoch(),
+            1000);
+  EXPECT_FALSE(metadata.lastModified(*fileTree->find("h.txt")).isValid());
+  EXPECT_EQ(metadata.hash(*fileTree->find("h.txt")), QByteArray("hash"));
+  EXPECT_FALSE(metadata.get(*fileTree->find("a/c/e.txt")).has_value());
+
+  EXPECT_EQ(metadata.totalSize(fileTree), 150);
+  EXPECT_EQ(metadata.totalSize(fileTree->findDirectory("a")), 30);
+
+  // Cached totals are updated when metadata or trees change:
+  metadata.set(fileTree->find("a/c/e.txt"), {5});
+  EXPECT_EQ(metadata.totalSize(fileTree->findDirectory("a")), 35);
+  EXPECT_EQ(metadata.totalSize(fileTree), 155);
+
+  fileTree->move(fileTree->find("f/g.txt"), "a/c/");
+  EXPECT_EQ(metadata.totalSize(fileTree->findDirectory("a")), 75);
+  EXPECT_EQ(metadata.totalSize(fileTree->findDirectory("f")), 0);
+  EXPECT_EQ(metadata.totalSize(fileTree), 155);
+
+  auto toNames = [](auto const& entries) {
+    std::vector<QString> names;
+    for (auto& entry : entries) {
+      names.push_back(entry->name());
+    }
+    return names;
+  };
+  EXPECT_EQ(toNames(metadata.largestFiles(fileTree, 3)),
+            (std::vector<QString>{"h.txt", "g.txt", "d.txt"}));
+  EXPECT_EQ(toNames(metadata.largestFiles(fileTree->findDirectory("a/c"), 10)),
+            (std::vector<QString>{"g.txt", "d.txt", "e.txt"}));
+
+  // Metadata of removed entries are ignored, and released by prune():
+  EXPECT_TRUE(metadata.erase(*fileTree->find("a/b.txt")));
+  EXPECT_FALSE(metadata.erase(*fileTree->find("a/b.txt")));
+  fileTree->erase("h.txt");
+  EXPECT_EQ(metadata.totalSize(fileTree), 65);
+  EXPECT_EQ(metadata.count(), 4);
+  EXPECT_EQ(metadata.prune(), 1);
+  EXPECT_EQ(metadata.count(), 3);
+}
+
+TEST(IFileTreeTest, BatchInsertions)
+{
+  // addFiles() gives the same tree as addFile():
+  {
+    QStringList paths;
+    for (int i = 0; i < 50; ++i) {
+      paths.push_back(QString("dir%1/file%2.txt").arg(i % 7).arg(i));
+      paths.push_back(QString("file%1.txt").arg(i));
+    }
+    paths.push_back("DIR1/FILE1.TXT");
+    paths.push_back("dir1/sub/a.txt");
+
+    auto expected = ArenaFileTree::create();
+    std::size_t added = 0;
+    for (auto& path : paths) {
+      added += expected->addFile(path) != nullptr;
+    }
+
+    auto fileTree = ArenaFileTree::create();
+    fileTree->addFile("dir2/file2.txt");
+    EXPECT_EQ(fileTree->addFiles(paths), added - 1);
+
+    std::vector<std::pair<QString, bool>> content;
+    for (auto& entry : getAllEntries(expected)) {
+      content.push_back({entry->pathFrom(expected, "/"), entry->isDir()});
+    }
+    assertTreeEquals(fileTree, content);
+    EXPECT_EQ(fileTree->find("dir1/file1.txt")->name(), "file1.txt");
+
+    // Duplicates are replaced by the last one:
+    EXPECT_EQ(fileTree->addFiles({"dir1/file1.txt", "DIR1/File1.txt"}, true),
+              std::size_t{1});
+    EXPECT_EQ(fileTree->find("dir1/file1.txt")->name(), "File1.txt");
+    EXPECT_EQ(fileTree->findDirectory("dir1")->size(), std::size_t{8});
+  }
+
+  // insertMany() applies the policies like insert():
+  {
+    auto fileTree = ArenaFileTree::create();
+    fileTree->addFile("a.txt");
+    fileTree->addFile("c/x.txt");
+    auto b = fileTree->addFile("b.txt");
+
+    auto other = ArenaFileTree::create();
+    other->addFile("A.TXT");
+    other->addFile("c/y.txt");
+    other->addFile("d.txt");
+
+    std::vector<std::shared_ptr<FileTreeEntry>> entries(other->begin(), other->end());
+    entries.push_back(b);
+
+    EXPECT_EQ(fileTree->insertMany(entries), std::size_t{1});
+    assertTreeEquals(fileTree, {{"a.txt", false},
+                                {"b.txt", false},
+                                {"c", true},
+                                {"c/x.txt", false},
+                                {"d.txt", false}});
+    EXPECT_EQ(fileTree->find("a.txt")->name(), "a.txt");
+    EXPECT_EQ(other->size(), std::size_t{2});
+
+    entries.assign(other->begin(), other->end());
+    EXPECT_EQ(fileTree->insertMany(entries, IFileTree::InsertPolicy::MERGE),
+              std::size_t{2});
+    assertTreeEquals(fileTree, {{"a.txt", false},
+                                {"b.txt", false},
+                                {"c", true},
+                                {"c/x.txt", false},
+                                {"c/y.txt", false},
+                                {"d.txt", false}});
+    EXPECT_EQ(fileTree->find("a.txt")->name(), "A.TXT");
+    EXPECT_TRUE(other->empty());
+
+    // Entries with the same name in the vector replace each other:
+    auto first  = other->addFile("e.txt");
+    auto second = other->addFile("f/e.txt");
+    EXPECT_EQ(fileTree->insertMany({first, second}, IFileTree::InsertPolicy::REPLACE),
+              std::size_t{2});
+    EXPECT_EQ(fileTree->find("e.txt"), second);
+    EXPECT_EQ(first->parent(), nullptr);
+    EXPECT_EQ(second->parent(), fileTree);
+    EXPECT_FALSE(other->exists("e.txt"));
+    EXPECT_FALSE(other->exists("f/e.txt"));
+  }
+}
+
+TEST(FileGlobTest, PatternMatching)
+{
+  EXPECT_TRUE(FileGlob("*.esp").matches(u"Plugin.ESP"));
+  EXPECT_FALSE(FileGlob("*.esp").matches(u"data/plugin.esp"));
+  EXPECT_TRUE(FileGlob("**/*.esp").matches(u"plugin.esp"));
+  EXPECT_TRUE(FileGlob("**/*.esp").matches(u"data\\sub/plugin.esp"));
+  EXPECT_TRUE(FileGlob("meshes/**/*.nif").matches(u"Meshes/a/b/c.nif"));
+  EXPECT_TRUE(FileGlob("meshes/**/*.nif").matches(u"meshes/c.nif"));
+  EXPECT_FALSE(FileGlob("meshes/**/*.nif").matches(u"textures/c.nif"));
+  EXPECT_TRUE(FileGlob("textures/*_?.dds").matches(u"textures/a_n.dds"));
+  EXPECT_FALSE(FileGlob("textures/*_?.dds").matches(u"textures/a_nn.dds"));
+  EXPECT_TRUE(FileGlob("a*b*c").matches(u"aXbYbZc"));
+  EXPECT_TRUE(FileGlob("**").matches(u"a/b"));
+
+  EXPECT_TRUE(FileGlob("**/*.esp").isSuffixOnly());
+  EXPECT_FALSE(FileGlob("*.esp").isSuffixOnly());
+  EXPECT_EQ(FileGlob("meshes/**/*.nif").suffix(), ".nif");
+}
+
+TEST(IFileTreeTest, GlobQueries)
+{
+  auto fileTree = FileListTree::makeTree({{"a.esp", false},
+                                          {"meshes/a.nif", false},
+                                          {"meshes/b/c.NIF", false},
+                                          {"meshes/b/d/e.nif", false},
+                                          {"meshes/b/d/f.dds", false},
+                                          {"textures/a_n.dds", false},
+                                          {"textures/b/c_n.dds", false},
+                                          {"textures/b/c.dds", false},
+                                          {"data/x.esp", false},
+                                          {"data/y.esm", false}});
+
+  auto paths = [&fileTree](auto const& entries) {
+    std::vector<QString> result;
+    for (auto& entry : entries) {
+      result.push_back(entry->pathFrom(fileTree, "/"));
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+  };
+
+  using Paths = std::vector<QString>;
+  EXPECT_EQ(paths(fileTree->findAll("**/*.esp")), (Paths{"a.esp", "data/x.esp"}));
+  EXPECT_EQ(paths(fileTree->findAll("*.esp")), (Paths{"a.esp"}));
+  EXPECT_EQ(paths(fileTree->findAll("meshes/**/*.nif")),
+            (Paths{"meshes/a.nif", "meshes/b/c.NIF", "meshes/b/d/e.nif"}));
+  EXPECT_EQ(paths(fileTree->findAll("textures/**/*_n.dds")),
+            (Paths{"textures/a_n.dds", "textures/b/c_n.dds"}));
+  EXPECT_EQ(paths(fileTree->findAll("MESHES/B/D/E.NIF")), (Paths{"meshes/b/d/e.nif"}));
+  EXPECT_EQ(paths(fileTree->findAll("data/*.es?")),
+            (Paths{"data/x.esp", "data/y.esm"}));
+  EXPECT_EQ(paths(fileTree->findAll("*/b", IFileTree::DIRECTORY)),
+            (Paths{"meshes/b", "textures/b"}));
+  EXPECT_EQ(paths(fileTree->findAll("meshes/b/**")),
+            (Paths{"meshes/b/c.NIF", "meshes/b/d", "meshes/b/d/e.nif",
+                   "meshes/b/d/f.dds"}));
+  EXPECT_EQ(paths(fileTree->findAll("**", IFileTree::DIRECTORY)),
+            (Paths{"data", "meshes", "meshes/b", "meshes/b/d", "textures",
+                   "textures/b"}));
+  EXPECT_TRUE(fileTree->findAll("nothing/**").empty());
+
+  // Subtrees that cannot match are not visited, i.e., not populated:
+  auto lazyTree = FileListTree::makeTree({{"meshes/a.nif", false},
+                                          {"textures/a.dds", false}});
+  EXPECT_EQ(lazyTree->findAll("meshes/*.nif").size(), std::size_t{1});
+  EXPECT_FALSE(populated(std::as_const(*lazyTree).at(1)->astree()));
+
+  // Regular expressions are matched against the full path:
+  const QRegularExpression regex("^meshes/.*\\.nif$",
+                                 QRegularExpression::CaseInsensitiveOption);
+  EXPECT_EQ(paths(std::as_const(*fileTree).findAll(regex, IFileTree::FILE)),
+            (Paths{"meshes/a.nif", "meshes/b/c.NIF", "meshes/b/d/e.nif"}));
+}
+
+TEST(IFileTreeTest, SuffixQueries)
+{
+  auto fileTree = FileListTree::makeTree({{"a.esp", false},
+                                          {"b.ESP", false},
+                                          {"c.esm", false},
+                                          {"data/d.esp", false},
+                                          {"data/e.bsa", false},
+                                          {"data/sub.esp", true},
+                                          {"data/f", false}});
+
+  EXPECT_TRUE(fileTree->find("a.esp")->hasSuffix("ESP"));
+  EXPECT_TRUE(fileTree->find("data/f")->hasSuffix(""));
+  EXPECT_FALSE(fileTree->find("data/sub.esp")->hasSuffix("esp"));
+  EXPECT_TRUE(fileTree->find("c.esm")->hasSuffix(QStringList{"esp", "esm"}));
+  EXPECT_FALSE(fileTree->find("c.esm")->hasSuffix(QStringList{"esp", "bsa"}));
+
+  // Results are not ordered:
+  auto names = [](auto const& entries) {
+    std::vector<QString> result;
+    for (auto& entry : entries) {
+      result.push_back(entry->name());
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+  };
+
+  using Names = std::vector<QString>;
+  EXPECT_EQ(names(fileTree->findBySuffix("esp")), (Names{"a.esp", "b.ESP", "d.esp"}));
+  EXPECT_EQ(names(fileTree->findBySuffix(QStringList{"bsa", "ESM"})),
+            (Names{"c.esm", "e.bsa"}));
+  EXPECT_TRUE(fileTree->findBySuffix("dds").empty());
+
+  // The index is updated after modifications, including in subtrees:
+  fileTree->findDirectory("data")->addFile("g.esp");
+  fileTree->erase("a.esp");
+  fileTree->move(fileTree->find("b.ESP"), "b.esl");
+  EXPECT_EQ(names(std::as_const(*fileTree).findBySuffix("esp")),
+            (Names{"d.esp", "g.esp"}));
+  EXPECT_EQ(names(fileTree->findBySuffix("esl")), (Names{"b.esl"}));
+  EXPECT_EQ(names(fileTree->findDirectory("data")->findBySuffix("esp")),
+            (Names{"d.esp", "g.esp"}));
+
+  // Moves between indexed trees, and directories:
+  fileTree->move(fileTree->find("data/g.esp"), "h.esp");
+  fileTree->addFile("x/y/z.esp");
+  fileTree->move(fileTree->find("x"), "data/");
+  EXPECT_EQ(names(fileTree->findBySuffix("esp")), (Names{"d.esp", "h.esp", "z.esp"}));
+  EXPECT_EQ(names(fileTree->findDirectory("data")->findBySuffix("esp")),
+            (Names{"d.esp", "z.esp"}));
+
+  fileTree->erase("data");
+  EXPECT_EQ(names(fileTree->findBySuffix("esp")), (Names{"h.esp"}));
+
+  // Only modifications change the revision:
+  const auto revision = fileTree->revision();
+  fileTree->find("h.esp");
+  fileTree->findBySuffix("esp");
+  EXPECT_EQ(fileTree->revision(), revision);
+  fileTree->addFile("i.esp");
+  EXPECT_NE(fileTree->revision(), revision);
+}
+
+TEST(IFileTreeTest, PathViewLookups)
+{
+  auto fileTree = FileListTree::makeTree(
+      {{"a/", true}, {"a/b/", true}, {"a/b/c.txt", false}, {"d.txt", false}});
+
+  // Views, with any separator and empty components:
+  const std::u16string_view path = u"a\\b//C.txt";
+  EXPECT_EQ(fileTree->find(QStringView(path)), fileTree->find("a/b/c.txt"));
+  EXPECT_EQ(fileTree->find(path.substr(0, 3)), fileTree->find("a/b"));
+  EXPECT_TRUE(fileTree->exists(std::u16string_view(u"/a/./b/../b/c.txt/")));
+  EXPECT_FALSE(
+      fileTree->exists(std::u16string_view(u"a/b/c.txt"), IFileTree::DIRECTORY));
+  EXPECT_EQ(fileTree->findDirectory(std::u16string_view(u"a\\b")),
+            fileTree->find("a/b")->astree());
+  EXPECT_EQ(fileTree->find(QStringView()), nullptr);
+  EXPECT_EQ(fileTree->find(std::u16string_view(u"//")), nullptr);
+  EXPECT_EQ(fileTree->find(std::u16string_view(u"a/*")), nullptr);
+
+  // Modifications split paths the same way:
+  EXPECT_EQ(fileTree->addFile("x\\\\y/z.txt")->path("/"), "x/y/z.txt");
+  EXPECT_EQ(fileTree->addFile("/a/b/e.txt")->parent(), fileTree->findDirectory("a/b"));
+  EXPECT_EQ(fileTree->addFile(""), nullptr);
+  EXPECT_EQ(fileTree->addFile("a/b/"), nullptr);
+  EXPECT_EQ(fileTree->addDirectory("f\\g/")->path("/"), "f/g");
+  EXPECT_EQ(fileTree->addFiles({"h/i.txt", "h\\j.txt", "h//k.txt", "l.txt", "/"}), 4);
+  EXPECT_EQ(fileTree->findDirectory("h")->size(), 3);
+
+  EXPECT_TRUE(fileTree->move(fileTree->find("d.txt"), "f\\g/m.txt"));
+  EXPECT_EQ(fileTree->find("f/g/m.txt")->name(), "m.txt");
+  EXPECT_TRUE(fileTree->move(fileTree->find("f/g/m.txt"), "\\n\\"));
+  EXPECT_EQ(fileTree->find("n/m.txt")->name(), "m.txt");
+}
+
+TEST(IFileTreeTest, WideTreeLookups)
+{
+  // Large enough to use the name index:
+  std::vector<std::pair<QString, bool>> strTree;
+  for (int i = 0; i < 100; ++i) {
+    strTree.push_back({QString("meshes/m%1.nif").arg(i), false});
+    strTree.push_back({QString("meshes/d%1/").arg(i), true});
+  }
+
+  auto fileTree = FileListTree::makeTree(std::move(strTree));
+  auto meshes   = fileTree->findDirectory("meshes");
+
+  EXPECT_EQ(meshes->size(), std::size_t{200});
+  EXPECT_TRUE(fileTree->exists("meshes/m42.nif", FileTreeEntry::FILE));
+  EXPECT_TRUE(fileTree->exists("MESHES/M42.NIF", FileTreeEntry::FILE));
+  EXPECT_FALSE(fileTree->exists("meshes/m42.nif", FileTreeEntry::DIRECTORY));
+  EXPECT_TRUE(fileTree->exists("meshes/D17", FileTreeEntry::DIRECTORY));
+  EXPECT_FALSE(fileTree->exists("meshes/m200.nif"));
+
+  // The index must follow insertions, removals and renames:
+  auto added = fileTree->addFile("meshes/new.nif");
+  EXPECT_EQ(fileTree->find("meshes/NEW.nif"), added);
+  EXPECT_EQ(fileTree->addFile("meshes/New.nif"), nullptr);
+
+  auto [it, erased] = meshes->erase("M3.nif");
+  EXPECT_NE(erased, nullptr);
+  EXPECT_FALSE(fileTree->exists("meshes/m3.nif"));
+
+  EXPECT_TRUE(meshes->move(added, "renamed.nif"));
+  EXPECT_FALSE(fileTree->exists("meshes/new.nif"));
+  EXPECT_EQ(fileTree->find("meshes/renamed.nif"), added);
+
+  EXPECT_TRUE(added->detach());
+  EXPECT_FALSE(fileTree->exists("meshes/renamed.nif"));
+
+  // Merging into an indexed directory:
+  auto other = fileTree->addDirectory("other");
+  other->addFile("m5.nif");
+  other->addFile("extra.nif");
+  other->addDirectory("m7.nif");
+
+  auto m5 = other->find("m5.nif");
+  EXPECT_EQ(meshes->merge(other), std::size_t{2});
+  EXPECT_EQ(fileTree->find("meshes/m5.nif"), m5);
+  EXPECT_TRUE(fileTree->exists("meshes/extra.nif", FileTreeEntry::FILE));
+  EXPECT_TRUE(fileTree->exists("meshes/m7.nif", FileTreeEntry::DIRECTORY));
+  EXPECT_FALSE(fileTree->exists("meshes/m7.nif", FileTreeEntry::FILE));
+  EXPECT_TRUE(other->empty());
+  EXPECT_FALSE(other->exists("m5.nif"));
+}
+
+TEST(IFileTreeTest, EntriesAreComparedCaseInsensitively)
+{
+  auto fileTree = FileListTree::makeTree(
+      {{"Textures/", true}, {"b.esp", false}, {"A.esp", false}, {"meshes/", true}});
+
+  // Directories first, then files, both sorted regardless of the case:
+  std::vector<QString> names;
+  for (auto entry : *fileTree) {
+    names.push_back(entry->name());
+  }
+  EXPECT_EQ(names, (std::vector<QString>{"meshes", "Textures", "A.esp", "b.esp"}));
+
+  EXPECT_EQ(fileTree->find("TEXTURES"), fileTree->find("textures"));
+  EXPECT_EQ(fileTree->find("a.ESP")->name(), "A.esp");
+
+  // The comparison key follows renames:
+  auto a = fileTree->find("a.esp");
+  EXPECT_TRUE(fileTree->move(a, "C.ESP"));
+  EXPECT_EQ(fileTree->find("c.esp"), a);
+  EXPECT_EQ(fileTree->find("a.esp"), nullptr);
+  EXPECT_EQ(a->compare("c.Esp"), 0);
+
+  // Merging uses the same keys to detect conflicts:
+  auto other = fileTree->createOrphanTree();
+  other->addFile("B.ESP");
+  other->addDirectory("MESHES/X");
+  EXPECT_EQ(fileTree->merge(other), std::size_t{1});
+  EXPECT_EQ(fileTree->find("b.esp")->name(), "B.ESP");
+  EXPECT_TRUE(fileTree->exists("meshes/x", FileTreeEntry::DIRECTORY));
+  EXPECT_EQ(fileTree->size(), std::size_t{4});
+}
+
+TEST(IFileTreeTest, ArenaTreeOperations)
+{
+  auto tree = ArenaFileTree::create();
+
+  EXPECT_NE(tree->addFile("textures/a/diffuse.dds"), nullptr);
+  EXPECT_NE(tree->addFile("textures/b/diffuse.dds"), nullptr);
+  EXPECT_NE(tree->addFile("meshes/a/body.nif"), nullptr);
+  EXPECT_NE(tree->addDirectory("scripts"), nullptr);
+
+  assertTreeEquals(tree, {{"textures", true},
+                          {"textures/a", true},
+                          {"textures/a/diffuse.dds", false},
+                          {"textures/b", true},
+                          {"textures/b/diffuse.dds", false},
+                          {"meshes", true},
+                          {"meshes/a", true},
+                          {"meshes/a/body.nif", false},
+                          {"scripts", true}});
+
+  auto arena = tree->arena();
+  EXPECT_GT(arena->bytesUsed(), std::size_t{0});
+  EXPECT_GE(arena->bytesReserved(), arena->bytesUsed());
+
+  // Copies are allocated in the same arena:
+  auto copy = tree->copy(tree->find("textures"), "textures2");
+  EXPECT_NE(copy, nullptr);
+  EXPECT_TRUE(tree->exists("textures2/b/diffuse.dds", FileTreeEntry::FILE));
+  EXPECT_EQ(std::dynamic_pointer_cast<ArenaFileTree>(copy)->arena(), arena);
+
+  // The memory of erased entries is reused:
+  copy.reset();
+  const std::size_t used = arena->bytesUsed();
+  tree->erase("textures2");
+  EXPECT_NE(tree->addFile("textures3/b/diffuse.dds"), nullptr);
+  EXPECT_EQ(arena->bytesUsed(), used);
+
+  // Entries can outlive their tree:
+  std::shared_ptr<FileTreeEntry> body = tree->find("meshes/a/body.nif");
+  std::weak_ptr<IFileTree> weakTree   = tree;
+  tree.reset();
+  EXPECT_TRUE(weakTree.expired());
+  EXPECT_EQ(body->name(), "body.nif");
+  EXPECT_EQ(body->parent(), nullptr);
+
+  // And keep the arena alive:
+  arena.reset();
+  EXPECT_EQ(body->name(), "body.nif");
+}
+
+TEST(IFileTreeTest, EntryNamesAreInterned)
+{
+  auto& pool        = FileNamePool::instance();
+  const auto before = pool.statistics();
+
+  {
+    auto fileTree = ArenaFileTree::create();
+    fileTree->addFile("pool/one/Interned.dds");
+    fileTree->addFile("pool/two/interned.DDS");
+    fileTree->addFile("pool/three/Interned.dds");
+
+    // "", pool, one, two, three, Interned.dds and interned.DDS, the last two sharing
+    // the same key:
+    const auto during = pool.statistics();
+    EXPECT_EQ(during.names, before.names + 7);
+    EXPECT_EQ(during.keys, before.keys + 6);
+    EXPECT_EQ(during.references, before.references + 8);
+    EXPECT_LT(during.bytes - before.bytes,
+              during.bytesUninterned - before.bytesUninterned);
+
+    // Renaming an entry releases its old name once it is not used anymore:
+    auto a = fileTree->find("pool/one/interned.dds");
+    auto b = fileTree->find("pool/three/interned.dds");
+    fileTree->move(b, "pool/two/renamed.dds");
+    EXPECT_EQ(pool.statistics().names, before.names + 8);
+    fileTree->move(a, "pool/two/other.dds");
+    EXPECT_EQ(pool.statistics().names, before.names + 8);
+    EXPECT_EQ(pool.statistics().keys, before.keys + 8);
+
+    // Moving a name does not add a reference:
+    FileNamePool::Name name(QString("moved.dds"));
+    const auto references = pool.statistics().references;
+    FileNamePool::Name moved(std::move(name));
+    EXPECT_EQ(pool.statistics().references, references);
+    EXPECT_EQ(moved.str(), "moved.dds");
+  }
+
+  // Names are released when their entries are destroyed:
+  const auto after = pool.statistics();
+  EXPECT_EQ(after.names, before.names);
+  EXPECT_EQ(after.keys, before.keys);
+  EXPECT_EQ(after.references, before.references);
+}
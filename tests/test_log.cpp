@@ -0,0 +1,455 @@
+#pragma warning(push)
+#pragma warning(disable : 4668)
+#include <gtest/gtest.h>
+#pragma warning(pop)
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "log.h"
+
+using namespace MOBase;
+
+namespace
+{
+
+// messages received by the callback of the logger under test
+std::mutex g_Mutex;
+std::vector<std::string> g_Messages;
+
+// when set, the callback waits until it is cleared, to fill the queue of an
+// asynchronous logger
+std::atomic<bool> g_Hold{false};
+std::atomic<bool> g_Holding{false};
+
+void collect(log::Entry e)
+{
+  while (g_Hold) {
+    g_Holding = true;
+    std::this_thread::yield();
+  }
+  g_Holding = false;
+
+  std::scoped_lock lock(g_Mutex);
+  g_Messages.push_back(e.message);
+}
+
+log::LoggerConfiguration asyncConfiguration(std::size_t queueSize,
+                                            log::OverflowPolicy overflow)
+{
+  log::LoggerConfiguration conf;
+  conf.name      = "test";
+  conf.maxLevel  = log::Debug;
+  conf.pattern   = "%v";
+  conf.async     = true;
+  conf.queueSize = queueSize;
+  conf.overflow  = overflow;
+  return conf;
+}
+
+}  // namespace
+
+TEST(LogTest, AsyncLoggerWritesAllMessages)
+{
+  g_Messages.clear();
+
+  constexpr int threads = 4, messages = 1000;
+
+  {
+    log::Logger logger(asyncConfiguration(16, log::OverflowPolicy::Block));
+    logger.setCallback(&collect);
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+      workers.emplace_back([&logger, t] {
+        for (int i = 0; i < messages; ++i) {
+          logger.debug("{} {}", t, i);
+        }
+      });
+    }
+    for (auto& worker : workers) {
+      worker.join();
+    }
+
+    logger.flush();
+    EXPECT_EQ(threads * messages, g_Messages.size());
+    EXPECT_EQ(0, logger.droppedCount());
+  }
+
+  // messages of each thread are written in order
+  std::vector<int> next(threads, 0);
+  for (auto& message : g_Messages) {
+    const auto space = message.find(' ');
+    const int t      = std::stoi(message.substr(0, space));
+    const int i      = std::stoi(message.substr(space + 1));
+    EXPECT_EQ(next[t], i);
+    next[t] = i + 1;
+  }
+}
+
+TEST(LogTest, AsyncLoggerFlushesOnDestruction)
+{
+  g_Messages.clear();
+
+  {
+    log::Logger logger(asyncConfiguration(1024, log::OverflowPolicy::Block));
+    logger.setCallback(&collect);
+    for (int i = 0; i < 500; ++i) {
+      logger.info("message {}", i);
+    }
+  }
+
+  EXPECT_EQ(500, g_Messages.size());
+}
+
+TEST(LogTest, AsyncLoggerCountsDroppedMessages)
+{
+  g_Messages.clear();
+
+  log::Logger logger(asyncConfiguration(16, log::OverflowPolicy::DropAndCount));
+  logger.setCallback(&collect);
+
+  // the background thread holds the slot of the first message while it is in the
+  // callback, so 15 of the next messages fit in the queue
+  g_Hold = true;
+  logger.info("first");
+  while (!g_Holding) {
+    std::this_thread::yield();
+  }
+
+  for (int i = 0; i < 20; ++i) {
+    logger.info("message {}", i);
+  }
+  EXPECT_EQ(5, logger.droppedCount());
+
+  g_Hold = false;
+  logger.flush();
+
+  // the first message, the ones that were queued, and the warning about the
+  // dropped ones
+  EXPECT_EQ(1 + 15 + 1, g_Messages.size());
+}
+
+TEST(LogTest, AsyncLoggerFlushDoesNotWaitForever)
+{
+  g_Messages.clear();
+
+  log::Logger logger(asyncConfiguration(2, log::OverflowPolicy::Block));
+  logger.setCallback(&collect);
+
+  // the background thread is held in the callback with the first message, the
+  // second one fills the queue and the producer of the third one waits for room
+  g_Hold = true;
+  logger.info("first");
+  while (!g_Holding) {
+    std::this_thread::yield();
+  }
+  logger.info("second");
+
+  std::atomic<bool> logged{false};
+  std::thread producer([&] {
+    logger.info("third");
+    logged = true;
+  });
+
+  // gives up on the queue instead of hanging
+  const auto start = std::chrono::steady_clock::now();
+  logger.flush();
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+  EXPECT_FALSE(logged);
+  EXPECT_TRUE(g_Messages.empty());
+
+  g_Hold = false;
+  producer.join();
+  logger.flush();
+
+  EXPECT_EQ(3, g_Messages.size());
+
+  // the queue still works after a flush gave up, for more than one lap
+  for (int i = 0; i < 10; ++i) {
+    logger.info("message {}", i);
+  }
+  logger.flush();
+
+  EXPECT_EQ(13, g_Messages.size());
+}
+
+namespace
+{
+
+// counts how many times it has been formatted
+struct Counted
+{};
+
+int g_Formatted = 0;
+
+}  // namespace
+
+template <>
+struct std::formatter<Counted> : std::formatter<std::string_view>
+{
+  template <class FmtContext>
+  FmtContext::iterator format(Counted, FmtContext& ctx) const
+  {
+    ++g_Formatted;
+    return std::formatter<std::string_view>::format("counted", ctx);
+  }
+};
+
+TEST(LogTest, DisabledLevelsAreNotFormatted)
+{
+  g_Messages.clear();
+  g_Formatted = 0;
+
+  log::LoggerConfiguration conf;
+  conf.name     = "test";
+  conf.maxLevel = log::Info;
+  conf.pattern  = "%v";
+
+  log::Logger logger(conf);
+  logger.setCallback(&collect);
+
+  logger.debug("{}", Counted{});
+  EXPECT_EQ(0, g_Formatted);
+  EXPECT_TRUE(g_Messages.empty());
+
+  logger.info("{}", Counted{});
+  EXPECT_EQ(1, g_Formatted);
+  ASSERT_EQ(1, g_Messages.size());
+  EXPECT_EQ("counted", g_Messages[0]);
+
+  logger.setLevel(log::Debug);
+  EXPECT_TRUE(logger.shouldLog(log::Debug));
+  logger.debug("{}", Counted{});
+  EXPECT_EQ(2, g_Formatted);
+}
+
+TEST(LogTest, CategoriesHaveTheirOwnLevel)
+{
+  g_Messages.clear();
+  g_Formatted = 0;
+
+  log::LoggerConfiguration conf;
+  conf.name     = "test";
+  conf.maxLevel = log::Info;
+  conf.pattern  = "%v";
+
+  log::createDefault(conf);
+  log::getDefault().setCallback(&collect);
+
+  // follows the default logger
+  log::Category vfs("vfs");
+  EXPECT_EQ(log::Info, vfs.level());
+  vfs.debug("{}", Counted{});
+  EXPECT_EQ(0, g_Formatted);
+
+  // enabled below the level of the logger
+  vfs.setLevel(log::Debug);
+  vfs.debug("{}", Counted{});
+  EXPECT_EQ(1, g_Formatted);
+  ASSERT_EQ(1, g_Messages.size());
+  EXPECT_EQ("[vfs] counted", g_Messages[0]);
+
+  // disabled above the level of the logger
+  log::setCategoryLevel("vfs", log::Error);
+  vfs.warn("{}", Counted{});
+  EXPECT_EQ(1, g_Formatted);
+
+  // levels given by name apply to categories created later
+  log::Category other("vfs");
+  EXPECT_EQ(log::Error, other.level());
+
+  vfs.resetLevel();
+  EXPECT_EQ(log::Info, vfs.level());
+}
+
+TEST(LogTest, ScrubberReplacesAllFiltersInOnePass)
+{
+  const log::details::Scrubber scrubber({{"user", "<user>"},
+                                         {"secret", "***"},
+                                         {"secret-key", "<key>"},
+                                         {"cret", "<not used>"}});
+
+  std::string s = "C:/Users/USER/x: secret-KEY=Secret, ***";
+  scrubber.scrub(s);
+
+  // case-insensitive, leftmost and then longest match wins
+  EXPECT_EQ("C:/<user>s/<user>/x: <key>=***, ***", s);
+
+  s = "nothing to see here";
+  scrubber.scrub(s);
+  EXPECT_EQ("nothing to see here", s);
+
+  s = "";
+  scrubber.scrub(s);
+  EXPECT_EQ("", s);
+
+  // replacements are not scanned again
+  const log::details::Scrubber recursive({{"a", "aa"}, {"b", "a"}});
+  s = "ab";
+  recursive.scrub(s);
+  EXPECT_EQ("aaa", s);
+}
+
+TEST(LogTest, LoggerScrubsBlacklist)
+{
+  g_Messages.clear();
+
+  log::LoggerConfiguration conf;
+  conf.name      = "test";
+  conf.maxLevel  = log::Info;
+  conf.pattern   = "%v";
+  conf.blacklist = {{"user", "<user>"}};
+
+  log::Logger logger(conf);
+  logger.setCallback(&collect);
+
+  logger.addToBlacklist("apikey123", "<apikey>");
+  logger.info("{} uses {}", "User", "APIKEY123");
+
+  logger.removeFromBlacklist("USER");
+  logger.info("{} uses {}", "User", "APIKEY123");
+
+  logger.resetBlacklist();
+  logger.info("{} uses {}", "User", "APIKEY123");
+
+  ASSERT_EQ(3, g_Messages.size());
+  EXPECT_EQ("<user> uses <apikey>", g_Messages[0]);
+  EXPECT_EQ("User uses <apikey>", g_Messages[1]);
+  EXPECT_EQ("User uses APIKEY123", g_Messages[2]);
+}
+
+TEST(LogTest, MessageBuffersAreNested)
+{
+  log::details::MessageBuffer outer;
+  outer.str() = "outer";
+
+  {
+    log::details::MessageBuffer inner;
+    EXPECT_TRUE(inner.str().empty());
+    inner.str() = "inner";
+
+    // more than the buffers of the thread
+    std::vector<std::unique_ptr<log::details::MessageBuffer>> more;
+    for (int i = 0; i < 8; ++i) {
+      more.push_back(std::make_unique<log::details::MessageBuffer>());
+      EXPECT_TRUE(more.back()->str().empty());
+      more.back()->str() = "more";
+    }
+
+    EXPECT_EQ("inner", inner.str());
+  }
+
+  EXPECT_EQ("outer", outer.str());
+}
+
+TEST(LogTest, FormatsQStrings)
+{
+  g_Messages.clear();
+
+  log::LoggerConfiguration conf;
+  conf.name     = "test";
+  conf.maxLevel = log::Info;
+  conf.pattern  = "%v";
+
+  log::Logger logger(conf);
+  logger.setCallback(&collect);
+
+  logger.info(QString("{} and {:>3}"), QString::fromUtf8("\xc3\xa9t\xc3\xa9"),
+              QStringView(u"x"));
+  logger.info("{}", QString::fromUtf8("\xc3\xbc"));
+
+  ASSERT_EQ(2, g_Messages.size());
+  EXPECT_EQ("\xc3\xa9t\xc3\xa9 and   x", g_Messages[0]);
+  EXPECT_EQ("\xc3\xbc", g_Messages[1]);
+}
+
+TEST(LogTest, CrashBufferKeepsLastMessages)
+{
+  g_Messages.clear();
+
+  log::LoggerConfiguration conf;
+  conf.name             = "test";
+  conf.maxLevel         = log::Info;
+  conf.pattern          = "%v";
+  conf.crashBufferSize  = 4;
+  conf.crashBufferLevel = log::Debug;
+
+  log::Logger logger(conf);
+  logger.setCallback(&collect);
+
+  // debug messages are only kept in the crash buffer
+  EXPECT_EQ(log::Info, logger.level());
+  EXPECT_TRUE(logger.shouldLog(log::Debug));
+
+  for (int i = 0; i < 10; ++i) {
+    logger.debug("message {}", i);
+  }
+  logger.info("last");
+
+  ASSERT_EQ(1, g_Messages.size());
+  EXPECT_EQ("last", g_Messages[0]);
+
+  const auto file = std::filesystem::temp_directory_path() / "uibase-crash-buffer.log";
+  ASSERT_TRUE(logger.dumpCrashBuffer(file));
+
+  std::ifstream in(file);
+  std::vector<std::string> lines;
+  for (std::string line; std::getline(in, line);) {
+    lines.push_back(line);
+  }
+  in.close();
+  std::filesystem::remove(file);
+
+  ASSERT_EQ(4, lines.size());
+  EXPECT_TRUE(lines[0].ends_with("[debug] message 7"));
+  EXPECT_TRUE(lines[1].ends_with("[debug] message 8"));
+  EXPECT_TRUE(lines[2].ends_with("[debug] message 9"));
+  EXPECT_TRUE(lines[3].ends_with("[info] last"));
+}
+
+TEST(LogTest, CrashBufferFiltersCategories)
+{
+  g_Messages.clear();
+
+  log::LoggerConfiguration conf;
+  conf.name             = "test";
+  conf.maxLevel         = log::Info;
+  conf.pattern          = "%v";
+  conf.crashBufferSize  = 4;
+  conf.crashBufferLevel = log::Info;
+
+  log::createDefault(conf);
+  log::getDefault().setCallback(&collect);
+
+  // enabled below the level of the logger, but not of the crash buffer
+  log::Category vfs("vfs");
+  vfs.setLevel(log::Debug);
+  vfs.debug("hidden");
+  vfs.info("kept");
+
+  ASSERT_EQ(2, g_Messages.size());
+  EXPECT_EQ("[vfs] hidden", g_Messages[0]);
+
+  const auto file =
+      std::filesystem::temp_directory_path() / "uibase-crash-buffer-categories.log";
+  ASSERT_TRUE(log::getDefault().dumpCrashBuffer(file));
+
+  std::ifstream in(file);
+  std::vector<std::string> lines;
+  for (std::string line; std::getline(in, line);) {
+    lines.push_back(line);
+  }
+  in.close();
+  std::filesystem::remove(file);
+
+  ASSERT_EQ(1, lines.size());
+  EXPECT_TRUE(lines[0].ends_with("[info] [vfs] kept"));
+}